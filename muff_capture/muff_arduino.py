@@ -8,8 +8,24 @@ import os, sys, serial, time
 from sys import stderr 
 
 num_LEDs = 24     # Number of LEDs; named 'A', 'B', etc.
+num_LED_patterns = 16 # Number of entries in the Arduino's LED pattern table.
+max_Z_steps = 98  # Max number of entries in the Arduino's Z schedule (see {upload_Z_schedule}).
 verbose = False   # If true, prints lots of debugging info.
 
+use_binary = True # If true, {connect} switches the Arduino to the binary protocol.
+binary = False    # True when the Arduino is in the binary protocol.
+seqnum = 0        # Sequence number of the last binary frame sent.
+pending = set()   # Sequence numbers of accepted frames whose completion event has not arrived yet.
+completed = set() # Sequence numbers of frames whose completion event arrived but was not waited for.
+telemetry = None  # Last telemetry frame received (see {note_telemetry}), or {None}.
+events = []       # Plan, sweep and homing events received but not waited for yet, oldest first (see {note_activity_event}).
+unit = None       # Address of the unit that gets the commands on a shared line (see {select_unit}), or {None}.
+
+baud_rate = 115200     # Speed of the serial port when the Arduino starts.
+fast_baud_rate = None  # If not {None}, {connect} switches the port to this speed (see {set_baud_rate}).
+ready_timeout = 5.0    # Max seconds to wait for the Arduino's ready line after opening the port.
+firmware_version = None # Firmware version reported in the ready line (see {wait_ready}).
+
 # GENERAL OBSERVATIONS
 
 # Most functions in this module take a {sport} argument
@@ -20,14 +36,44 @@ verbose = False   # If true, prints lots of debugging info.
 # This is useful when debugging this module and the 
 # Arduino is not available.
 
-def connect(arduino_present,verb):
+# The high-level functions compose each command in the ASCII
+# syntax of the firmware (e.g. b"4+025").  If the Arduino has been
+# switched to the binary protocol (see {enter_binary_mode}), 
+# {send_command_and_wait} converts the command to a binary frame
+# and waits for the one-byte ACK instead of the '0'.
+
+# In the binary protocol the ACK only means that the command was 
+# accepted; each command also gets a completion event when it ends,
+# which for moves comes when the motor stops.  So the functions that
+# start a move return while it runs, and the next command can be sent
+# right away.  Use {wait_command_done} or {wait_all_done} to wait for
+# the end.  In the ASCII protocol the '0' comes when the command is 
+# done, except that moves return while they run, as before; only the
+# '0' of the Z step moves ('5' and '>') waits for the motor to stop.  In either
+# protocol the Arduino keeps reading commands during a move, so 
+# {read_motor_status} and the stop commands can be sent at any time.
+
+# Several Arduinos with distinct addresses can share one serial line
+# (e.g. a 4-wire RS-485 bus), so that one computer drives several
+# capture stations; see {connect}, {select_unit} and {broadcast}.
+# Units on a shared line send no completion events, so there
+# {wait_command_done} polls the selected unit with {read_motor_status}.
+
+def connect(arduino_present,verb,bus=False):
   """Open a serial port to the Arduino and returns it.
   
   However, if {arduino_present} is false, skips and returns {None}
   instead.
   
   If {verb} is true, turns on verbose mode for all functions in
-  this module."""
+  this module.
+  
+  If {bus} is true, the port is a line shared by several Arduinos
+  with addresses (see {select_unit}).  They start in the binary protocol
+  and send no ready line, so this function does not wait for it nor
+  change the speed of the port."""
+  
+  global binary
   
   global verbose
   verbose = verb
@@ -36,14 +82,67 @@ def connect(arduino_present,verb):
     return None
   else:
     sport = serial.Serial \
-      ( "/dev/ttyUSB0", 9600,
+      ( "/dev/ttyUSB0", baud_rate,
         bytesize=serial.EIGHTBITS,
         parity=serial.PARITY_NONE,
         stopbits=serial.STOPBITS_ONE )
-    time.sleep(2)
+    if bus:
+      binary = True
+      return sport
+    wait_ready(sport, ready_timeout)
+    if fast_baud_rate != None and fast_baud_rate != baud_rate: set_baud_rate(sport, fast_baud_rate)
+    if use_binary: enter_binary_mode(sport)
     return sport
 # ----------------------------------------------------------------------
 
+def wait_ready(sport, timeout):
+  """Waits for the line "!MUFF {version} {baud}" that the Arduino sends
+  when it finishes starting up (after the reset caused by opening the
+  port), skipping everything before it.  Saves {version} in 
+  {firmware_version} and returns it.  Aborts with error if the line 
+  does not come within {timeout} seconds."""
+  
+  global firmware_version
+  
+  if sport == None: return None
+  deadline = time.time() + timeout
+  sport.timeout = 0.1
+  line = b''
+  try:
+    while time.time() < deadline:
+      c = sport.read()
+      if len(c) == 0: continue
+      if c == b'\r' or c == b'\n':
+        fields = line.split()
+        if len(fields) == 3 and fields[0] == ready_sync + b'MUFF':
+          firmware_version = fields[1].decode('ascii')
+          if verbose: stderr.write("[muff_arduino:] Arduino ready, firmware version %s\n" % firmware_version)
+          return firmware_version
+        line = b''
+      else:
+        line = line + c
+  finally:
+    sport.timeout = None
+  stderr.write("** [muff_arduino:] Arduino not ready after %.1f seconds\n" % timeout)
+  sys.exit(1)
+# ----------------------------------------------------------------------
+
+def set_baud_rate(sport, baud):
+  """Sends a single command to the Arduino to change the speed of the
+  serial port to {baud} bits per second (9600, 19200, 38400, 57600,
+  115200, 230400, 250000, 500000, or 1000000), waits for its reply,
+  which still comes at the old speed, and then changes the speed of
+  {sport} too."""
+  
+  assert baud in (9600, 19200, 38400, 57600, 115200, 230400, 250000, 500000, 1000000)
+  if verbose: stderr.write("[muff_arduino:] switching the serial port to %d bits/s\n" % baud)
+  seq = send_command_in_protocol(sport, ("D%07d" % baud).encode('ascii'))
+  wait_command_reply(sport, seq)
+  # The completion event too comes at the old speed:
+  if unit == None: wait_command_done(sport, seq)
+  if sport != None: sport.baudrate = baud
+# ----------------------------------------------------------------------
+
 # COMMANDS FOR THE MUFF POSITIONER FIRMWARE
   
 def start_motor(sport,dir,fast):
@@ -81,8 +180,8 @@ def start_motor(sport,dir,fast):
   
 def stop_motor(sport):
   """Send command to the Arduino to stop the motor, in case it is moving
-  because of a previous {start_motor}.  Waits for the 
-  Arduino to respond with '0'."""
+  because of a previous {start_motor}.  The motor decelerates to a stop;
+  waits until it has stopped."""
   
   global verbose
   
@@ -90,7 +189,23 @@ def stop_motor(sport):
 
   # Choose and send the Arduino command:
   command = b"3"
-  send_command_and_wait(sport, command)
+  seq = send_command_in_protocol(sport, command)
+  wait_command_reply(sport, seq)
+  if seq != None:
+    wait_command_done(sport, seq)
+  else:
+    wait_motor_stopped(sport)
+# ----------------------------------------------------------------------
+
+def emergency_stop(sport):
+  """Send command to the Arduino to stop the motor at once, without 
+  decelerating, and abort any plan, sweep or homing in progress.
+  The motor may lose steps if it was moving fast."""
+  
+  global verbose
+  
+  if verbose: stderr.write("[muff_arduino:] emergency stop\n")
+  send_command_and_wait(sport, b'X')
 # ----------------------------------------------------------------------
   
 def set_Z_step(sport,Z_step):
@@ -110,11 +225,36 @@ def set_Z_step(sport,Z_step):
   command = ("4%+03d" % istep).encode('ascii');
   send_command_and_wait(sport, command)
 # ----------------------------------------------------------------------
+
+def upload_Z_schedule(sport,Z_steps):
+  """Sends to the Arduino a list {Z_steps} of Z increments, in 
+  millimeters, to be used one at a time by {move_microscope_next}
+  instead of the fixed step of {set_Z_step}, e.g. dense near the focus
+  and sparse elsewhere.  Replaces any capture plan uploaded with
+  {upload_plan}; to run the schedule on the Arduino's sequencer, 
+  pass it to {upload_plan} instead.  Waits for the Arduino to 
+  acknowledge each command."""
+  
+  assert len(Z_steps) > 0 and len(Z_steps) <= max_Z_steps
+  if verbose: stderr.write("[muff_arduino:] uploading a schedule of %d Z steps\n" % len(Z_steps))
+  send_command_and_wait(sport, ("P%02d00000" % (len(Z_steps) + 1)).encode('ascii'))
+  send_Z_steps(sport, Z_steps)
+# ----------------------------------------------------------------------
+
+def send_Z_steps(sport,Z_steps):
+  """Appends the Z increments {Z_steps} (in millimeters, rounded to 
+  microns) to the Arduino's current plan."""
+  
+  for Z_step in Z_steps:
+    istep = int(round(Z_step*1000)) # Step size in microns.
+    assert (istep >= -9999) and (istep <= +9999) # Arduino expects sign and 4 digits.
+    send_command_and_wait(sport, ("N%+05d" % istep).encode('ascii'))
+# ----------------------------------------------------------------------
   
 def move_microscope(sport):
   """Sends commands to the Arduino to raises the microscope 
   holder by the predefined Z step amount. Waits for
-  the Arduino to respond with '0'."""
+  the motion to end."""
   
   global verbose
   
@@ -122,7 +262,161 @@ def move_microscope(sport):
   
   # Construct and send the Arduino command:
   command = b'5'
-  send_command_and_wait(sport, command)
+  seq = send_command_in_protocol(sport, command)
+  wait_command_reply(sport, seq)
+  wait_command_done(sport, seq)
+# ----------------------------------------------------------------------
+
+def move_microscope_next(sport):
+  """Sends a command to the Arduino to raise the microscope holder by
+  the next Z increment of the schedule uploaded by {upload_Z_schedule}.
+  Waits for the motion to end."""
+  
+  if verbose: stderr.write("[muff_arduino:] raising microscope by the next scheduled step\n")
+  seq = send_command_in_protocol(sport, b'>')
+  wait_command_reply(sport, seq)
+  wait_command_done(sport, seq)
+# ----------------------------------------------------------------------
+
+def move_microscope_to(sport,Z):
+  """Sends a single command to the Arduino to start moving the microscope 
+  to the absolute position {Z} (in millimeters, relative to the 
+  position defined as zero by {zero_position}).  Does not 
+  wait for the motion to end."""
+  
+  nm = int(round(Z*1000000))
+  assert abs(nm) <= 999999999
+  if verbose: stderr.write("[muff_arduino:] moving microscope to Z = %.6f mm\n" % Z)
+  send_command_and_wait(sport, ("GN%+010d" % nm).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def queue_move_to(sport,Z,speed=0):
+  """Sends a single command to the Arduino to append a move to the absolute
+  position {Z} (in millimeters) at the end of its motion queue, with max
+  speed {speed} (steps per second, or the firmware default if zero).
+  The move starts when the previous one reaches its target; if both go the
+  same way, the microscope does not stop in between.  Does not wait for
+  the motion to end.  Fails if the queue is full."""
+  
+  nm = int(round(Z*1000000))
+  assert abs(nm) <= 999999999
+  assert 0 <= speed <= 9999
+  if verbose: stderr.write("[muff_arduino:] queueing move to Z = %.6f mm\n" % Z)
+  send_command_and_wait(sport, ("UN%+010d%04d" % (nm, speed)).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def move_microscope_by(sport,dZ):
+  """Sends a single command to the Arduino to start moving the microscope 
+  by {dZ} millimeters from its current position.  Does not 
+  wait for the motion to end."""
+  
+  nm = int(round(dZ*1000000))
+  assert abs(nm) <= 999999999
+  if verbose: stderr.write("[muff_arduino:] moving microscope by %+.6f mm\n" % dZ)
+  send_command_and_wait(sport, ("JN%+010d" % nm).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def predict_move_secs(sport,dZ,speed=0):
+  """Asks the Arduino how long a move of the microscope by {dZ} 
+  millimeters from rest would take, from the first step to the last,
+  with the current acceleration and jerk and a max speed of {speed} 
+  steps per second ({speed = 0} means the speed of {move_microscope_by}).
+  The motor is not moved.  Returns the time in seconds, or 0 if 
+  {sport} is {None}."""
+  
+  nm = int(round(dZ*1000000))
+  assert abs(nm) <= 999999999
+  assert type(speed) is int and speed >= 0 and speed <= 9999
+  if sport == None: return 0.0
+  seq = send_command_in_protocol(sport, ("tN%+010d%04d" % (nm, speed)).encode('ascii'))
+  if seq != None:
+    # The data comes after the ACK:
+    wait_command_reply(sport, seq)
+    b = b''
+    for k in range(4): b = b + readchar(sport)
+    us = int.from_bytes(b, 'little', signed=True)
+  else:
+    us = int(read_data_line(sport))
+    wait_command_reply(sport, seq)
+  return us/1000000.0
+# ----------------------------------------------------------------------
+
+def zero_position(sport):
+  """Stops the motor and tells the Arduino that the current position
+  is {Z = 0}."""
+  
+  if verbose: stderr.write("[muff_arduino:] defining current position as Z = 0\n")
+  send_command_and_wait(sport, b'Z')
+# ----------------------------------------------------------------------
+
+def home_microscope(sport,Z):
+  """Sends a single command to the Arduino to find the end-stop switch at 
+  the top of the microscope's travel, first fast and then slowly, define
+  the switch position as {Z = 0}, and move to the absolute position {Z}
+  (in millimeters, must be zero or negative).  Waits for the Arduino to 
+  report the end of the homing ('H')."""
+  
+  nm = int(round(Z*1000000))
+  assert -999999999 <= nm <= 0
+  if verbose: stderr.write("[muff_arduino:] homing the microscope, then moving to Z = %.6f mm\n" % Z)
+  del events[:]
+  send_command_and_wait(sport, ("ON%+010d" % nm).encode('ascii'))
+  if sport == None: return
+  c = wait_activity_event(sport)
+  if c != b'H':
+    stderr.write("** [muff_arduino:] Invalid homing event from Arduino: '%s'\n" % show_bytes(c,True))
+    sys.exit(1)
+# ----------------------------------------------------------------------
+
+def read_position(sport):
+  """Returns the absolute position of the motor, in steps, as 
+  kept by the Arduino.  Returns 0 if {sport} is {None}."""
+  
+  if sport == None: return 0
+  seq = send_command_in_protocol(sport, b'?')
+  if seq != None:
+    # The data comes after the ACK:
+    wait_command_reply(sport, seq)
+    b = b''
+    for k in range(4): b = b + readchar(sport)
+    pos = int.from_bytes(b, 'little', signed=True)
+  else:
+    pos = int(read_data_line(sport))
+    wait_command_reply(sport, seq)
+  return pos
+# ----------------------------------------------------------------------
+
+def read_motor_status(sport):
+  """Returns a triple {(pos,target,state)} with the current absolute 
+  position of the motor and the target of its current move, both in 
+  steps, and its state: 'P' if stopped, 'G' if moving, 'A' if 
+  decelerating to start another move.  Returns {(0,0,'P')} if 
+  {sport} is {None}."""
+  
+  if sport == None: return (0, 0, 'P')
+  seq = send_command_in_protocol(sport, b'K')
+  if seq != None:
+    # The data comes after the ACK:
+    wait_command_reply(sport, seq)
+    b = b''
+    for k in range(9): b = b + readchar(sport)
+    pos = int.from_bytes(b[0:4], 'little', signed=True)
+    target = int.from_bytes(b[4:8], 'little', signed=True)
+    state = chr(b[8])
+  else:
+    fields = read_data_line(sport).split()
+    pos = int(fields[0]); target = int(fields[1]); state = fields[2].decode('ascii')
+    wait_command_reply(sport, seq)
+  return (pos, target, state)
+# ----------------------------------------------------------------------
+
+def wait_motor_stopped(sport):
+  """Polls the Arduino with {read_motor_status} until the motor 
+  is stopped."""
+  
+  if sport == None: return
+  while read_motor_status(sport)[2] != 'P':
+    time.sleep(0.05)
 # ----------------------------------------------------------------------
 
 def test_lights(sport):
@@ -199,6 +493,479 @@ def switch_all_LEDs(sport,pwr):
   send_command_and_wait(sport, command)
 # ----------------------------------------------------------------------
 
+def enter_binary_mode(sport):
+  """Sends the command 'B1' to the Arduino, so that all subsequent commands
+  are sent as binary frames, without the '#' diagnostic messages."""
+  
+  global binary
+  
+  if verbose: stderr.write("[muff_arduino:] switching to the binary protocol\n")
+  send_command_and_wait(sport, b'B1')
+  binary = True
+# ----------------------------------------------------------------------
+
+def leave_binary_mode(sport):
+  """Sends the command 'B0' to the Arduino, returning to the 
+  ASCII protocol."""
+  
+  global binary
+  
+  if verbose: stderr.write("[muff_arduino:] switching to the ASCII protocol\n")
+  send_command_and_wait(sport, b'B0')
+  binary = False
+# ----------------------------------------------------------------------
+
+def set_jerk(sport,jerk):
+  """Sends a single command to the Arduino to set the max rate of change
+  of the acceleration of the motor to {jerk} full steps/second^3, so that it
+  follows an S-shaped speed profile and stops without a jolt; {jerk = 0}
+  restores the trapezoidal profile.  Stops the motor if it is moving.
+  Waits for the Arduino to respond with '0'."""
+  
+  assert type(jerk) is int and jerk >= 0 and jerk <= 99999
+  if verbose: stderr.write("[muff_arduino:] setting max jerk to %d full steps/s^3\n" % jerk)
+  send_command_and_wait(sport, ("9%05d" % jerk).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def set_hold_policy(sport,hold_ms):
+  """Sends a single command to the Arduino to define how long the motor
+  stays energized, holding the microscope in place, after each move:
+  {hold_ms} milliseconds, or forever if {hold_ms} is {None}.  With 
+  {hold_ms = 0} the motor is released as soon as it stops, but then it
+  may jump by a microstep when the next move starts.  Waits for the 
+  Arduino to respond with '0'."""
+  
+  if hold_ms is None:
+    command = "HS00000"
+  else:
+    assert type(hold_ms) is int and hold_ms >= 0 and hold_ms <= 99999
+    command = "HT%05d" % hold_ms
+  if verbose: stderr.write("[muff_arduino:] setting motor hold time to %s\n" % str(hold_ms))
+  send_command_and_wait(sport, command.encode('ascii'))
+# ----------------------------------------------------------------------
+
+def set_telemetry(sport,period_ms):
+  """Sends a single command to the Arduino to send a telemetry frame
+  every {period_ms} milliseconds (at least 20), or to stop sending them
+  if {period_ms} is 0.  The frames are decoded by the functions that read
+  from the Arduino, and the last one is kept in {telemetry} (see 
+  {note_telemetry} and {read_telemetry}).  Waits for the Arduino to 
+  respond with '0'."""
+  
+  assert type(period_ms) is int and period_ms >= 0 and period_ms <= 9999
+  if verbose: stderr.write("[muff_arduino:] setting telemetry period to %d ms\n" % period_ms)
+  send_command_and_wait(sport, ("Y%04d" % period_ms).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def read_telemetry(sport):
+  """Waits for the next telemetry frame from the Arduino, which must 
+  have been enabled with {set_telemetry}, and returns it (see 
+  {note_telemetry}).  Completion events and events of the plan, the
+  sweep or the homing that arrive meanwhile are recorded as usual.  Returns {None} if {sport} is {None}."""
+  
+  if sport == None: return None
+  while True:
+    c = readchar(sport)
+    if note_telemetry(sport, c): return telemetry
+    if note_event(c) or note_activity_event(c): continue
+    if c == b'#': 
+      skip_to_eol(sport)
+    elif c != b' ' and c != b'\r' and c != b'\n':
+      stderr.write("** [muff_arduino:] Expected telemetry from Arduino, got '%s'\n" % show_bytes(c,True))
+      sys.exit(1)
+# ----------------------------------------------------------------------
+
+def set_LED_mask(sport,mask):
+  """Sends a single command to the Arduino to set the state of all LEDs
+  at once: LED {k} is turned on if bit {k} of the integer {mask} is 1,
+  off otherwise.  Waits for the Arduino to respond with '0'."""
+  
+  global verbose
+  
+  assert type(mask) is int and mask >= 0 and mask < (1 << num_LEDs)
+  
+  if verbose: stderr.write("[muff_arduino:] setting LED mask to %06X\n" % mask)
+  send_command_and_wait(sport, ("E%06X" % mask).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def define_LED_pattern(sport,k,mask):
+  """Stores {mask} (see {set_LED_mask}) as entry {k} of the 
+  Arduino's LED pattern table.  Waits for the Arduino to 
+  respond with '0'."""
+  
+  assert type(k) is int and k >= 0 and k < num_LED_patterns
+  assert type(mask) is int and mask >= 0 and mask < (1 << num_LEDs)
+
+  if verbose: stderr.write("[muff_arduino:] defining LED pattern %d as %06X\n" % (k,mask))
+  send_command_and_wait(sport, ("Q%X%06X" % (k,mask)).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def save_LED_patterns(sport):
+  """Tells the Arduino to save its LED pattern table to EEPROM, so that
+  it is still there after a reset."""
+  
+  if verbose: stderr.write("[muff_arduino:] saving LED patterns to EEPROM\n")
+  send_command_and_wait(sport, b'W')
+# ----------------------------------------------------------------------
+
+def select_LED_pattern(sport,k):
+  """Sets all LEDs to entry {k} of the Arduino's LED pattern table,
+  with a one-byte command.  Waits for the Arduino to respond with '0'."""
+  
+  assert type(k) is int and k >= 0 and k < num_LED_patterns
+  
+  if verbose: stderr.write("[muff_arduino:] selecting LED pattern %d\n" % k)
+  send_command_and_wait(sport, bytes([b'a'[0] + k]))
+# ----------------------------------------------------------------------
+
+# ON-DEVICE CAPTURE SEQUENCER
+
+def upload_plan(sport, nH, settle_secs, LED_masks, Z_steps=None):
+  """Sends to the Arduino a capture plan with {nH} heights, one
+  frame per LED mask in the list {LED_masks} at each height, and a settling 
+  time of {settle_secs} seconds before each frame.  Bit {k} of each
+  mask is 1 iff LED {k} is to be lit.  The Z step between heights 
+  is the one defined by {set_Z_step}, or, if {Z_steps} is not {None}, 
+  {Z_steps[H-1]} millimeters from height {H-1} to height {H} (see
+  {upload_Z_schedule}).  Waits for the Arduino to acknowledge each 
+  command."""
+  
+  assert type(nH) is int and nH > 0 and nH <= 99
+  ms = int(round(settle_secs*1000))
+  assert ms >= 0 and ms <= 99999
+  assert len(LED_masks) > 0 and len(LED_masks) <= num_LEDs
+  assert Z_steps is None or len(Z_steps) == nH - 1
+  
+  if verbose: stderr.write("[muff_arduino:] uploading plan: %d heights, %d lights\n" % (nH, len(LED_masks)))
+
+  send_command_and_wait(sport, ("P%02d%05d" % (nH, ms)).encode('ascii'))
+  for mask in LED_masks:
+    assert mask >= 0 and mask < (1 << num_LEDs)
+    send_command_and_wait(sport, ("M%06X" % mask).encode('ascii'))
+  if Z_steps is not None: send_Z_steps(sport, Z_steps)
+# ----------------------------------------------------------------------
+
+def start_plan(sport):
+  """Tells the Arduino to start executing the uploaded capture plan.
+  The Arduino then lights the LEDs for the first frame and, after 
+  the settling time, sends an 'R' (see {wait_frame_ready})."""
+  
+  if verbose: stderr.write("[muff_arduino:] starting plan\n")
+  del events[:]
+  send_command_and_wait(sport, b'S')
+# ----------------------------------------------------------------------
+
+def wait_frame_ready(sport):
+  """Waits for the Arduino to report that the next frame of the plan
+  is ready to be taken ('R'), or that the plan ended ('F').  Returns 
+  {True} in the first case, {False} in the second.  The event may
+  have arrived already, while waiting for the reply to another
+  command (see {note_activity_event}).
+  
+  If {sport} is {None} (debugging mode), pretends that the frame is ready."""
+  
+  if sport == None:
+    stderr.write("[muff_arduino:] pretending that the Arduino reported frame ready\n")
+    return True
+  c = wait_activity_event(sport)
+  if c == b'R':
+    return True
+  elif c == b'F':
+    return False
+  else:
+    stderr.write("** [muff_arduino:] Invalid plan event from Arduino: '%s'\n" % show_bytes(c,True))
+    sys.exit(1)
+# ----------------------------------------------------------------------
+
+def configure_trigger(sport, pulse_us, use_exposure):
+  """Configures the hardware camera trigger output of the Arduino:
+  a pulse of {pulse_us} microseconds whenever a frame of the plan is
+  ready ({pulse_us = 0} disables it).  If {use_exposure} is true, 
+  the end of the exposure reported by the camera's strobe output 
+  also advances the plan, as if {frame_taken} had been called."""
+  
+  assert type(pulse_us) is int and pulse_us >= 0 and pulse_us <= 99999
+  
+  if verbose: stderr.write("[muff_arduino:] camera trigger pulse = %d us\n" % pulse_us)
+  send_command_and_wait(sport, ("C%05d%d" % (pulse_us, 1 if use_exposure else 0)).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def frame_taken(sport):
+  """Tells the Arduino that the frame reported by {wait_frame_ready}
+  has been taken, so that the plan may advance to the next one."""
+  
+  send_command_and_wait(sport, b'T')
+# ----------------------------------------------------------------------
+
+def start_sweep(sport, nH, speed):
+  """Tells the Arduino to sweep the microscope through {nH} frame
+  heights, spaced by the Z step defined by {set_Z_step}, at 
+  the constant speed of {speed} motor steps per second, firing the
+  camera trigger at each height (see {configure_trigger}).
+  Returns as soon as the motion starts; use {wait_sweep_end}
+  to wait for it to end."""
+  
+  assert type(nH) is int and nH > 0 and nH <= 99
+  assert type(speed) is int and speed > 0 and speed <= 9999
+  
+  if verbose: stderr.write("[muff_arduino:] sweeping %d frames at %d steps/s\n" % (nH, speed))
+  del events[:]
+  send_command_and_wait(sport, ("V%02d%04d" % (nH, speed)).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def wait_sweep_end(sport):
+  """Waits for the Arduino to report the end of the sweep ('V'),
+  which may have arrived already (see {wait_activity_event})."""
+  
+  if sport == None: return
+  c = wait_activity_event(sport)
+  if c != b'V':
+    stderr.write("** [muff_arduino:] Invalid sweep event from Arduino: '%s'\n" % show_bytes(c,True))
+    sys.exit(1)
+# ----------------------------------------------------------------------
+
+def read_sweep_log(sport):
+  """Reads from the Arduino the log of the last sweep.  Returns a 
+  list with the displacement of the motor (in steps, from the
+  start of the sweep) at the instant of each camera trigger."""
+  
+  if sport == None: return []
+  seq = send_command_in_protocol(sport, b'L')
+  if seq != None:
+    # The data comes after the ACK:
+    wait_command_reply(sport, seq)
+    n = readchar(sport)[0]
+    log = []
+    for k in range(n):
+      b = readchar(sport) + readchar(sport)
+      log.append(int.from_bytes(b, 'little'))
+  else:
+    fields = read_data_line(sport).split()
+    n = int(fields[0])
+    log = [ int(f) for f in fields[1:] ]
+    assert len(log) == n
+    wait_command_reply(sport, seq)
+  return log
+# ----------------------------------------------------------------------
+
+# Names of the timing measurements of the firmware, in the order it sends them.
+profile_names = ( "loop", "steps", "command", "LEDs", "step_delay" )
+profile_bins = 8  # Bins in the histogram of step delays.
+
+def read_profile(sport):
+  """Reads and resets the timing measurements of the Arduino, which 
+  must have been compiled with {muff_usa_perfil} set to 1.  Returns a
+  dictionary that maps each name in {profile_names} to a tuple
+  {(n,min,max,mean)} of integer microseconds ({n} being the sample
+  count), and "histogram" to a list with the counts of step delays
+  in 0-3, 4-7, 8-15, ... 128-255, and 256 or more microseconds."""
+  
+  if sport == None: return None
+  seq = send_command_in_protocol(sport, b'R')
+  if seq != None:
+    # The data comes after the ACK:
+    wait_command_reply(sport, seq)
+    def read_int():
+      b = b''
+      for k in range(4): b = b + readchar(sport)
+      return int.from_bytes(b, 'little')
+    rows = [ [ read_int() for k in range(4) ] for name in profile_names ]
+    hist = [ read_int() for k in range(profile_bins) ]
+  else:
+    rows = [ [ int(f) for f in read_data_line(sport).split() ] for name in profile_names ]
+    hist = [ int(f) for f in read_data_line(sport).split() ]
+    wait_command_reply(sport, seq)
+  prof = { name: tuple(row) for name, row in zip(profile_names, rows) }
+  prof["histogram"] = hist
+  return prof
+# ----------------------------------------------------------------------
+
+# PERSISTENT CONFIGURATION
+
+# Names of the motion parameters kept by the firmware (see {muff_config.h}),
+# in the order of their indices.  Distances are in steps, speeds in 
+# steps/second (at most 32767), the acceleration in steps/second^2, the
+# jerk in steps/second^3, and the hold time in milliseconds ({-1} = forever).
+# The address is only used after a reset (see {set_unit_address}).
+config_names = ( 
+    "max_accel", "max_speed_fine", "max_speed_coarse", "max_speed_frame",
+    "step_fine", "step_coarse", "step_frame", "jerk", "hold_ms",
+    "address"
+  )
+
+def set_config_param(sport,name,value):
+  """Sends a single command to the Arduino to set its motion parameter
+  {name} (one of {config_names}) to the integer {value}, and to apply it
+  to the motor at once; stops the motor if it is moving.  The change is
+  lost at reset unless followed by {save_config}.  Waits for the Arduino
+  to respond with '0'."""
+  
+  k = config_names.index(name)
+  assert type(value) is int and abs(value) <= 999999999
+  if verbose: stderr.write("[muff_arduino:] setting %s to %d\n" % (name,value))
+  send_command_and_wait(sport, ("A%02d%+010d" % (k,value)).encode('ascii'))
+# ----------------------------------------------------------------------
+
+def read_config_param(sport,name):
+  """Returns the current value of the motion parameter {name} (one of
+  {config_names}) of the Arduino.  Returns 0 if {sport} is {None}."""
+  
+  k = config_names.index(name)
+  if sport == None: return 0
+  seq = send_command_in_protocol(sport, ("I%02d" % k).encode('ascii'))
+  if seq != None:
+    # The data comes after the ACK:
+    wait_command_reply(sport, seq)
+    b = b''
+    for i in range(4): b = b + readchar(sport)
+    value = int.from_bytes(b, 'little', signed=True)
+  else:
+    value = int(read_data_line(sport))
+    wait_command_reply(sport, seq)
+  return value
+# ----------------------------------------------------------------------
+
+def read_config(sport):
+  """Returns a dictionary that maps each name in {config_names} to
+  the current value of that parameter in the Arduino (see 
+  {read_config_param})."""
+  
+  return { name: read_config_param(sport, name) for name in config_names }
+# ----------------------------------------------------------------------
+
+def save_config(sport):
+  """Tells the Arduino to save its motion parameters and its LED pattern
+  table to EEPROM, so that it starts with them after a reset."""
+  
+  if verbose: stderr.write("[muff_arduino:] saving configuration to EEPROM\n")
+  send_command_and_wait(sport, b'F1')
+# ----------------------------------------------------------------------
+
+def load_config(sport):
+  """Tells the Arduino to reload its motion parameters and its LED
+  pattern table from EEPROM, discarding unsaved changes.  The Arduino
+  reports an error if the EEPROM has no valid configuration."""
+  
+  if verbose: stderr.write("[muff_arduino:] loading configuration from EEPROM\n")
+  send_command_and_wait(sport, b'F0')
+# ----------------------------------------------------------------------
+
+def reset_config(sport):
+  """Tells the Arduino to restore the default motion parameters and to
+  clear its LED pattern table.  The EEPROM is not changed unless 
+  followed by {save_config}."""
+  
+  if verbose: stderr.write("[muff_arduino:] restoring default configuration\n")
+  send_command_and_wait(sport, b'F2')
+# ----------------------------------------------------------------------
+
+# SEVERAL UNITS ON A SHARED LINE
+
+def select_unit(addr):
+  """Makes all subsequent commands go to the Arduino with address 
+  {addr} (1 to {max_unit_address}) on a shared line (see {connect}).
+  If {addr} is {None}, they go without address, to an Arduino that
+  is alone on the port."""
+  
+  global unit
+  
+  assert addr == None or (type(addr) is int and addr >= 1 and addr <= max_unit_address)
+  unit = addr
+# ----------------------------------------------------------------------
+
+def set_unit_address(sport,addr):
+  """Gives the Arduino the address {addr} (1 to {max_unit_address}, or 0
+  for none) and saves it to EEPROM with the rest of the configuration
+  (see {save_config}).  The new address only applies after the Arduino
+  is reset; it then starts in the binary protocol, without a ready line,
+  and only obeys commands sent to its address or broadcast."""
+  
+  assert type(addr) is int and addr >= 0 and addr <= max_unit_address
+  set_config_param(sport, "address", addr)
+  save_config(sport)
+# ----------------------------------------------------------------------
+
+def find_units(sport, addrs, timeout=0.2):
+  """Returns the list of the addresses in {addrs} for which an Arduino
+  on the shared line answers within {timeout} seconds.  Leaves 
+  {unit} as it was."""
+  
+  global seqnum
+  
+  if sport == None: return list(addrs)
+  found = []
+  sport.timeout = timeout
+  try:
+    for addr in addrs:
+      seqnum = (seqnum + 1) % 64
+      send_command(sport, binary_frame(seqnum, b'K', addr))
+      # The ACK and the 9 data bytes of the 'K' command:
+      reply = sport.read(10)
+      if len(reply) > 0 and reply[0] == frame_ack | seqnum: found.append(addr)
+      if verbose: stderr.write("[muff_arduino:] unit %d %s\n" % (addr, "found" if addr in found else "absent"))
+  finally:
+    sport.timeout = None
+  return found
+# ----------------------------------------------------------------------
+
+def broadcast(sport, command):
+  """Sends the ASCII {command} to all Arduinos on the shared line at
+  once, as a binary frame.  They send no reply, so this function returns
+  right away.  Commands that send data (like '?' and 'K') are ignored
+  by the Arduinos."""
+  
+  global seqnum
+  
+  assert binary
+  seqnum = (seqnum + 1) % 64
+  send_command(sport, binary_frame(seqnum, command, broadcast_address))
+# ----------------------------------------------------------------------
+
+def broadcast_move_microscope(sport):
+  """Tells all Arduinos on the shared line to raise their microscope
+  holders by their predefined Z step, at the same time.  Does not
+  wait for the moves to end (see {wait_units_stopped})."""
+  
+  if verbose: stderr.write("[muff_arduino:] raising all microscopes by 1 step\n")
+  broadcast(sport, b'5')
+# ----------------------------------------------------------------------
+
+def broadcast_move_microscope_next(sport):
+  """Tells all Arduinos on the shared line to raise their microscope
+  holders by the next Z increment of their schedules (see 
+  {upload_Z_schedule}), at the same time.  Does not wait for the moves
+  to end (see {wait_units_stopped})."""
+  
+  if verbose: stderr.write("[muff_arduino:] raising all microscopes by the next scheduled step\n")
+  broadcast(sport, b'>')
+# ----------------------------------------------------------------------
+
+def broadcast_LED_pattern(sport,k):
+  """Sets the LEDs of all Arduinos on the shared line to entry {k} of
+  their LED pattern tables, at the same time."""
+  
+  assert type(k) is int and k >= 0 and k < num_LED_patterns
+  
+  if verbose: stderr.write("[muff_arduino:] selecting LED pattern %d on all units\n" % k)
+  broadcast(sport, bytes([b'a'[0] + k]))
+# ----------------------------------------------------------------------
+
+def wait_units_stopped(sport, addrs):
+  """Waits until the motors of all the Arduinos with addresses in
+  {addrs} are stopped (see {wait_motor_stopped}).  Leaves {unit} 
+  as it was."""
+  
+  global unit
+  
+  saved = unit
+  try:
+    for addr in addrs:
+      unit = addr
+      wait_motor_stopped(sport)
+  finally:
+    unit = saved
+# ----------------------------------------------------------------------
+
 # LOW_LEVEL FUNCTIONS
 
 def send_command_and_wait(sport, command):
@@ -210,8 +977,218 @@ def send_command_and_wait(sport, command):
   However, if {sport} is {None}, writes the bytes to {stderr} 
   instead, and returns without waiting."""
   
-  send_command(sport, command)
-  wait_arduino_OK(sport)
+  seq = send_command_in_protocol(sport, command)
+  wait_command_reply(sport, seq)
+# ----------------------------------------------------------------------
+
+def send_command_in_protocol(sport, command):
+  """Sends the ASCII {command} as is, or as a binary frame if
+  the Arduino is in the binary protocol.  Returns the frame's
+  sequence number, or {None} if sent in ASCII."""
+  
+  global binary, seqnum
+  
+  if binary:
+    seqnum = (seqnum + 1) % 64
+    frame = binary_frame(seqnum, command, unit)
+    if command == b'B0': binary = False # Reply still comes in binary.
+    send_command(sport, frame)
+    return seqnum
+  else:
+    send_command(sport, command)
+    return None
+# ----------------------------------------------------------------------
+
+def wait_command_reply(sport, seq):
+  """Waits for the reply to a command sent by {send_command_in_protocol}
+  that returned {seq}."""
+  
+  if seq != None:
+    wait_arduino_ACK(sport, seq)
+  else:
+    wait_arduino_OK(sport)
+# ----------------------------------------------------------------------
+
+def wait_command_done(sport, seq):
+  """Waits for the completion event of the command sent with
+  sequence number {seq}, whose ACK has already been received.
+  Returns immediately if {seq} is {None} (ASCII protocol) 
+  or {sport} is {None}.  On a shared line, where there are no
+  completion events, waits for the motor of the selected unit
+  to stop instead."""
+  
+  if seq == None or sport == None: return
+  if unit != None:
+    wait_motor_stopped(sport)
+    return
+  while seq not in completed:
+    c = readchar(sport)
+    if not (note_event(c) or note_telemetry(sport, c) or note_activity_event(c)):
+      stderr.write("** [muff_arduino:] Invalid completion event from Arduino: '%s'\n" % show_bytes(c,True))
+      sys.exit(1)
+  completed.discard(seq)
+# ----------------------------------------------------------------------
+
+def wait_all_done(sport):
+  """Waits for the completion events of all commands sent 
+  so far in the binary protocol."""
+  
+  if sport == None: return
+  while len(pending) > 0:
+    c = readchar(sport)
+    if not (note_event(c) or note_telemetry(sport, c) or note_activity_event(c)):
+      stderr.write("** [muff_arduino:] Invalid completion event from Arduino: '%s'\n" % show_bytes(c,True))
+      sys.exit(1)
+  completed.clear()
+# ----------------------------------------------------------------------
+
+def note_event(c):
+  """If the byte {c} (a {bytes} object) is a completion event of the
+  binary protocol, records it and returns {True}; else returns {False}."""
+  
+  if not binary or (c[0] & 0xC0) != frame_done: return False
+  seq = c[0] & 63
+  if verbose: stderr.write("[muff_arduino:] frame %d completed\n" % seq)
+  pending.discard(seq)
+  completed.add(seq)
+  return True
+# ----------------------------------------------------------------------
+
+activity_events = (b'R', b'F', b'H', b'V')
+  # Event bytes of the plan ('R','F'), the sweep ('V') and the homing ('H').
+
+def note_activity_event(c):
+  """If the byte {c} (a {bytes} object) is an event of the plan, the 
+  sweep or the homing, appends it to {events} and returns {True}; else
+  returns {False}.  Such events may arrive while waiting for the reply
+  to some other command, and are later consumed by {wait_activity_event}."""
+  
+  if c not in activity_events: return False
+  if verbose: stderr.write("[muff_arduino:] saved event '%s'\n" % show_bytes(c,True))
+  events.append(c)
+  return True
+# ----------------------------------------------------------------------
+
+def wait_activity_event(sport):
+  """Returns the oldest event of the plan, the sweep or the homing that 
+  was saved by {note_activity_event}, or, if there is none, the next
+  significant character from {sport} (see {read_signif})."""
+  
+  if len(events) > 0: return events.pop(0)
+  return read_signif(sport, True)
+# ----------------------------------------------------------------------
+
+def note_telemetry(sport, c):
+  """If the byte {c} (a {bytes} object) starts a telemetry frame, reads
+  the rest of the frame from {sport}, saves it in {telemetry}, and 
+  returns {True}; else returns {False}.  The saved frame is a tuple
+  {(pos,speed,to_go,leds,switch,state)}: the motor position, speed
+  and distance to the target of the current move, in steps and steps 
+  per second; the LED state bytes as an integer, with the first byte
+  in the lowest 8 bits; {True} if the end-stop switch is pressed; and
+  the motor state as in {read_motor_status} (only 'P' or 'G' in the
+  ASCII protocol)."""
+  
+  global telemetry
+  
+  if c != telemetry_sync: return False
+  if binary:
+    b = b''
+    for k in range(telemetry_size - 1): b = b + readchar(sport)
+    if crc8(b[0:-1]) != b[-1]:
+      stderr.write("** [muff_arduino:] Telemetry frame with bad CRC: '%s'\n" % show_bytes(b,True))
+      return True
+    pos = int.from_bytes(b[0:4], 'little', signed=True)
+    speed = int.from_bytes(b[4:6], 'little', signed=True)
+    to_go = int.from_bytes(b[6:10], 'little', signed=True)
+    leds = int.from_bytes(b[10:13], 'little', signed=False)
+    switch = (b[13] & 1) != 0
+    state = "PGA"[(b[13] >> 1) & 3]
+  else:
+    line = b''
+    while True:
+      d = readchar(sport)
+      if d == b'\r' or d == b'\n': break
+      line = line + d
+    fields = line.split()
+    pos = int(fields[0]); speed = int(fields[1]); to_go = int(fields[2])
+    leds = int(fields[3], 16); switch = (fields[4] == b'1')
+    state = 'P' if (speed == 0 and to_go == 0) else 'G'
+  telemetry = (pos, speed, to_go, leds, switch, state)
+  if verbose: stderr.write("[muff_arduino:] telemetry %s\n" % str(telemetry))
+  return True
+# ----------------------------------------------------------------------
+
+# Format of the argument bytes of each ASCII command, as in the 
+# firmware's {formato_args}: 's' sign, 'd' decimal digit, 'x' hex digit,
+# 'c' any char; ',' separates arguments.
+arg_formats = { 
+    b'4'[0]: "sddd", b'8'[0]: "ddd", b'9'[0]: "ddddd", b'H'[0]: "c,ddddd", b'+'[0]: "c", b'-'[0]: "c", b'B'[0]: "d",
+    b'P'[0]: "dd,ddddd", b'M'[0]: "xxxxxx", b'C'[0]: "ddddd,d",
+    b'V'[0]: "dd,dddd", b'E'[0]: "xxxxxx", b'Q'[0]: "x,xxxxxx",
+    b'G'[0]: "c,sddddddddd", b'J'[0]: "c,sddddddddd",
+    b'U'[0]: "c,sddddddddd,dddd", b'O'[0]: "c,sddddddddd", b'Y'[0]: "dddd",
+    b'D'[0]: "ddddddd", b'A'[0]: "dd,sddddddddd", b'I'[0]: "dd", b'F'[0]: "d",
+    b'N'[0]: "sdddd", b't'[0]: "c,sddddddddd,dddd"
+  }
+
+frame_sync = 0xA5  # First byte of a binary frame.
+frame_sync_addressed = 0xA6 # First byte of a binary frame with address.
+broadcast_address = 0  # Address of a frame for all units on a shared line.
+max_unit_address = 127 # Max address of a unit on a shared line.
+frame_ack = 0x80   # ACK reply code, or'ed with the sequence number.
+frame_nak = 0xC0   # NAK reply code, or'ed with the sequence number.
+frame_done = 0x00  # Completion event code, or'ed with the sequence number.
+telemetry_sync = b'@' # First byte of a telemetry frame.
+telemetry_size = 16   # Bytes in a binary telemetry frame.
+ready_sync = b'!'     # First byte of the Arduino's ready line.
+
+def binary_frame(seq, command, addr=None):
+  """Converts the ASCII {command} (opcode followed by argument bytes)
+  to a binary frame with sequence number {seq}, as described in
+  the firmware's {muff_protocolo.h}.  If {addr} is not {None}, the
+  frame is for the unit with that address on a shared line, or for all
+  of them if it is {broadcast_address}.  Returns the frame as a {bytes} object."""
+
+  opcode = command[0]
+  fmt = arg_formats.get(opcode, "")
+  args = []
+  k = 1 # Next byte of {command}.
+  for field in fmt.split(","):
+    if field == "": continue
+    if field.startswith("c"):
+      val = command[k]; k = k + 1
+    else:
+      sign = +1
+      if field.startswith("s"):
+        if command[k] == b'-'[0]: sign = -1
+        k = k + 1; field = field[1:]
+      digits = command[k:k+len(field)].decode('ascii'); k = k + len(field)
+      val = sign*int(digits, 16 if 'x' in field else 10)
+    args.append(val)
+  assert k == len(command)
+  body = bytes([seq, opcode, 4*len(args)])
+  for val in args:
+    body = body + val.to_bytes(4, 'little', signed=True)
+  if addr == None:
+    return bytes([frame_sync]) + body + bytes([crc8(body)])
+  else:
+    body = bytes([addr]) + body
+    return bytes([frame_sync_addressed]) + body + bytes([crc8(body)])
+# ----------------------------------------------------------------------
+
+def crc8(data):
+  """The CRC-8 (polynomial 0x07, initial value 0) of the {bytes} object {data}."""
+
+  crc = 0
+  for b in data:
+    crc = crc ^ b
+    for i in range(8):
+      if crc & 0x80:
+        crc = ((crc << 1) ^ 0x07) & 0xFF
+      else:
+        crc = (crc << 1) & 0xFF
+  return crc
 # ----------------------------------------------------------------------
 
 def send_command(sport, command):
@@ -252,10 +1229,37 @@ def wait_arduino_OK(sport):
       sys.exit(1)
 # ----------------------------------------------------------------------
 
-def read_signif(sport):
+def wait_arduino_ACK(sport, seq):
+  """Waits for the one-byte reply to the binary frame with 
+  sequence number {seq} from the serial port {sport}.  Aborts 
+  with error if the reply is a NAK or for a different frame.
+  
+  If {sport} is {None} (debugging mode), does not try to read, 
+  and returns immediately."""
+  
+  if sport == None: 
+    stderr.write("[muff_arduino:] pretending that the Arduino replied ACK\n")
+    return
+  else:
+    # Completion events of earlier commands may come first:
+    c = readchar(sport)
+    while note_event(c) or note_telemetry(sport, c) or note_activity_event(c): c = readchar(sport)
+    if verbose: stderr.write("[muff_arduino:] received from Arduino: '%s'\n" % show_bytes(c,True))
+    if c[0] != frame_ack | seq:
+      stderr.write("** [muff_arduino:] Invalid ACK for frame %d from Arduino: '%s'\n" % (seq, show_bytes(c,True)))
+      sys.exit(1)
+    completed.discard(seq)
+    # On a shared line there will be no completion event:
+    if unit == None: pending.add(seq)
+# ----------------------------------------------------------------------
+
+def read_signif(sport, activity = False):
   """Reads one character from the serial port object {sport} (which
-  should not be {None}), skipping blanks, end-of-lines (CR, NL)
-  and comments (from '#' to end-of-line).  
+  should not be {None}), skipping blanks, end-of-lines (CR, NL),
+  comments (from '#' to end-of-line), completion events of the
+  binary protocol (see {note_event}), telemetry frames (see
+  {note_telemetry}), and, unless {activity} is true, the events
+  of the plan, the sweep and the homing (see {note_activity_event}).  
   If {verbose} is true, echoes the character on {stderr}. 
   Returns the character as a {bytes} object.  
   
@@ -269,7 +1273,10 @@ def read_signif(sport):
   # Read until non-blank and non-comment, or error:
   while True:
     c = readchar(sport)
-    if c == b'#':
+    if note_event(c) or note_telemetry(sport, c) or ((not activity) and note_activity_event(c)):
+      # Completion event of the binary protocol, telemetry, or an event saved for later:
+      pass
+    elif c == b'#':
       if verbose: stderr.write("[muff_arduino:] received from Arduino: '%s" % show_bytes(c,False));
       # Skip all data to end-of-line, echo on {stderr}:
       skip_to_eol(sport)
@@ -284,6 +1291,23 @@ def read_signif(sport):
   return c
 # ----------------------------------------------------------------------
 
+def read_data_line(sport):
+  """Reads a data line "= {data}" sent by the Arduino in the ASCII
+  protocol, skipping blanks and comments before it.  Returns
+  {data} as a {bytes} object, without the EOL."""
+  
+  c = read_signif(sport)
+  if c != b'=':
+    stderr.write("** [muff_arduino:] Expected data line from Arduino, got '%s'\n" % show_bytes(c,True))
+    sys.exit(1)
+  line = b''
+  while True:
+    c = readchar(sport)
+    if c == b'\r' or c == b'\n': break
+    line = line + c
+  return line
+# ----------------------------------------------------------------------
+
 def skip_to_eol(sport):
   """Reads characters from the serial port {sport} (which must not
   be {None}) until the first end-of-line (CR or NL), echoing 
@@ -2,13 +2,15 @@
 # Last edited on 2018-09-04 18:49:15 by stolfilocal
 
 HELP = \
-  "  muff_mainloop.py {nL} {nV} {nH} {Z_step}\n"
+  "  muff_mainloop.py {nL} {nV} {nH} {Z_step} [ {Z_start} ]\n"
 
 INFO = \
   "  This is the core process in the MUFF 2.0 microscope positioner software suite.  Its task is to loop through the various light settings, view directions, and camera positions. It interacts with the user (through {stderr} and {stdin}), with the Arduino firmware (through a serial port), and with the camera monitoring and grabbing process {muff_camview.py} (through named Linux pipes \"muff_pipe_m2c\" and \"muff_pipe_c2m\").\n" \
   "\n" \
   "  The command line arguments are the number {nL} of distinct lighting conditions, the number of {nV} viewing directions, the number {nH} of microscope Z positions (frames per stack), and the distance {Z_step} between consecutive positions (float, in millimeters).  Currently the number of views must be 1.\n" \
   "\n" \
+  "  If the optional argument {Z_start} (float, in millimeters) is given, the microscope is positioned automatically: it is raised until it hits the end-stop switch, and then lowered by {Z_start} to the first frame position.  Otherwise the user is asked to position it manually.\n" \
+  "\n" \
   "  In normal operation, this process should be started with its {stdout} connected to the {stdin} of the process {muff_camview.py}.  It can be started alone for debugging, but then no frames will be grabbed or displayed.\n" \
   "\n" \
   "  The Arduino development environment is needed only to download the firmware to the Arduino.  Positioning of the microscope at the starting Z coordinate is done through this process, too.\n" \
@@ -30,6 +32,9 @@ nV_max = 1           # Max viewing directions.
 nH_max = 99          # Max number of frames in each stack.
 
 use_uvc = False # Grabbing module: {True = uvccapture}, {False = muff_camview.py}.
+use_sequencer = True # If true and {nV = 1}, the Arduino runs the capture loops itself.
+settle_secs = 0.2    # Settling time before each frame when {use_sequencer} is true (s).
+Z_schedule = None    # If not {None}, list of the {nH-1} Z increments (mm) to use instead of a fixed {Z_step}.
 
 arduino_present = False   # Set to false if debugging without the Arduino.
 camera_present = True     # Set to false if debigging without the frame grabbing software.
@@ -52,7 +57,7 @@ def main():
   (sport,m2cPipe, c2mPipe) = (None, None, None)
   
   # Parse arguments from the command line:
-  (ok,nL,nV,nH,Z_step) = parse_command_line_args()
+  (ok,nL,nV,nH,Z_step,Z_start) = parse_command_line_args()
   if not ok: terminate_process(sport,ok)
   
   # Create pipes to the frame grabber program:
@@ -67,9 +72,13 @@ def main():
   # Define the vertical displacement between frames in each stack:
   muff_arduino.set_Z_step(sport,Z_step)
 
-  # Ask user to manually position the microscope at first height:
-  ok = place_camera_for_first_image(sport)
-  if not ok: terminate_process(sport,m2cPipe,c2mPipe,ok)
+  if Z_start != None:
+    # Position the microscope at first height relative to the end-stop:
+    home_camera_for_first_image(sport,Z_start)
+  else:
+    # Ask user to manually position the microscope at first height:
+    ok = place_camera_for_first_image(sport)
+    if not ok: terminate_process(sport,m2cPipe,c2mPipe,ok)
 
     
   # Capture the images:
@@ -86,7 +95,10 @@ def capture_image_set(sport, m2cPipe, c2mPipe, nL,nV,nH, Z_step):
   multi-focus image stack for each of {nL} lighting conditions and {nV}
   view directions.  Each stack will have {nH} images, at equally
   spaced microscope heights, starting at the current position and
-  rising by {Z_step} millimeters at every turn.  
+  rising by {Z_step} millimeters at every turn.  If {Z_schedule} is 
+  not {None}, the microscope rises instead by {Z_schedule[H-1]} 
+  millimeters before height {H}, so that the heights can be denser
+  near the focus and sparser elsewhere.
   
   Interacts with the Arduino through the serial port {sport}.
   
@@ -96,9 +108,10 @@ def capture_image_set(sport, m2cPipe, c2mPipe, nL,nV,nH, Z_step):
   completion replies through {c2mPipe}.
   
   Returns {True} if finished successfully, {False} if aborted.
-  Also increments the assumed current position {Z_curr} by {Zstep}."""
+  Also increments the assumed current position {Z_curr} by the total
+  rise."""
   
-  global Z_curr
+  global Z_curr, LED_status
   
   # Parameter checks:
   assert type(nL) is int and nL > 0 and nL <= nL_max     
@@ -106,6 +119,12 @@ def capture_image_set(sport, m2cPipe, c2mPipe, nL,nV,nH, Z_step):
   assert type(nH) is int and nH > 0 and nH <= nH_max   
   assert type(Z_step) is float and Z_step >= Z_step_min and Z_step <= Z_step_max
   assert nH*Z_step <= Z_range_max + 0.0001 # Fudged for rounding.
+  if Z_schedule is None:
+    Z_steps = [ Z_step ] * (nH - 1)
+  else:
+    Z_steps = list(Z_schedule)
+    assert len(Z_steps) == nH - 1
+    assert abs(sum(Z_steps)) <= Z_range_max + 0.0001
   
   # Compute number of images and estimated time:
   nI = nL*nV*nH;
@@ -119,12 +138,33 @@ def capture_image_set(sport, m2cPipe, c2mPipe, nL,nV,nH, Z_step):
   
   # Capture all images: 
   tstart = time.time()
+  if use_sequencer and nV == 1:
+    ok = capture_image_set_on_device(sport,m2cPipe,c2mPipe,topdir,nL,nH)
+    if not ok: return False
+    Z_curr = Z_curr + sum(Z_steps)
+    tstop = time.time();
+    stderr.write("[muff_mainloop:] captured %d images in %.1f minutes\n" % (nI, (tstop - tstart)/60))
+    return True
+  
+  # Upload the lighting conditions to the Arduino's pattern table, if they fit:
+  use_patterns = (nL <= muff_arduino.num_LED_patterns)
+  if use_patterns:
+    for L in range(nL):
+      muff_arduino.define_LED_pattern(sport, L, LED_mask(define_LED_vals(L, nL)))
+  
+  # Upload the Z schedule to the Arduino, if any:
+  if Z_schedule is not None and nH > 1:
+    muff_arduino.upload_Z_schedule(sport, Z_steps)
+  
   for H in range(nH):
   
     if H > 0:
       # Move the microscope to the next Z position:
-      muff_arduino.move_microscope(sport)
-      Z_curr = Z_curr + Z_step
+      if Z_schedule is None:
+        muff_arduino.move_microscope(sport)
+      else:
+        muff_arduino.move_microscope_next(sport)
+      Z_curr = Z_curr + Z_steps[H-1]
     
     # Capture all frames for this Z position:
     for V in range(nV):
@@ -138,7 +178,11 @@ def capture_image_set(sport, m2cPipe, c2mPipe, nL,nV,nH, Z_step):
         
         # Choose the set of LEDs to use, and turn them on:
         LED_vals = define_LED_vals(L, nL) 
-        set_light_condition(sport,LED_vals)
+        if use_patterns:
+          muff_arduino.select_LED_pattern(sport, L)
+          LED_status = list(LED_vals)
+        else:
+          set_light_condition(sport,LED_vals)
         
         # Grab the frame and save it to disk:
         ok = capture_frame(m2cPipe,c2mPipe,topdir,L,V,H)
@@ -156,6 +200,58 @@ def capture_image_set(sport, m2cPipe, c2mPipe, nL,nV,nH, Z_step):
   return True
 # ----------------------------------------------------------------------
 
+def capture_image_set_on_device(sport, m2cPipe, c2mPipe, topdir, nL, nH):
+  """Same as the loops of {capture_image_set} with a single view, except 
+  that the plan is uploaded to the Arduino, which moves the microscope and 
+  switches the LEDs by itself, and only reports when each frame is ready.
+  Returns {True} if finished successfully, {False} if aborted."""
+
+  global LED_status
+
+  # Convert each lighting condition to a LED mask:
+  LED_masks = [ LED_mask(define_LED_vals(L, nL)) for L in range(nL) ]
+  
+  Z_steps = None if Z_schedule is None else list(Z_schedule)
+  muff_arduino.upload_plan(sport, nH, settle_secs, LED_masks, Z_steps)
+  muff_arduino.start_plan(sport)
+  
+  # The Arduino runs the plan in the same order as {capture_image_set}:
+  for H in range(nH):
+    for L in range(nL):
+      if not muff_arduino.wait_frame_ready(sport):
+        stderr.write("** [muff_mainloop:] plan ended prematurely\n")
+        return False
+      ok = capture_frame(m2cPipe,c2mPipe,topdir,L,0,H)
+      if not ok: 
+        stderr.write("** [muff_mainloop:] frame capture failed\n")
+        muff_arduino.stop_motor(sport) # Also aborts the plan.
+        return False
+      muff_arduino.frame_taken(sport)
+  
+  # Wait for the end-of-plan report; the Arduino then turns all LEDs off:
+  if sport != None and muff_arduino.wait_frame_ready(sport):
+    stderr.write("** [muff_mainloop:] Arduino reported more frames than planned\n")
+    return False
+  for lix in range(num_LEDs):
+    LED_status[lix] = 0.0
+  return True
+# ----------------------------------------------------------------------
+
+def home_camera_for_first_image(sport,Z_start):
+  """Raises the microscope camera until it hits the end-stop switch, 
+  then lowers it by {Z_start} millimeters to the lowest Z value of the stack.
+  
+  The function sets the global assumed position {Z_curr} to 0."""
+  
+  global Z_curr
+  
+  stderr.write("[muff_mainloop:] homing the camera, first image %.3f mm below the end-stop.\n" % Z_start)
+  muff_arduino.home_microscope(sport,-Z_start)
+  # Define this as the {Z = 0} position, here and in the Arduino:
+  muff_arduino.zero_position(sport)
+  Z_curr = 0.0
+# ----------------------------------------------------------------------
+
 def place_camera_for_first_image(sport):
   """Ask the user to position the microscope camera at the lowest Z value,
   using the buttons on the microscope stand, the commands '1'/'2'/'6'/'7'/'3' through the
@@ -212,7 +308,8 @@ def place_camera_for_first_image(sport):
     s = s.strip() # Remove leading and trailing whitespace, including EOL.
     if s.lower() == "ok":
       muff_arduino.stop_motor(sport)
-      # Define this as the {Z = 0} position:
+      # Define this as the {Z = 0} position, here and in the Arduino:
+      muff_arduino.zero_position(sport)
       Z_curr = 0.0
       return True
     elif s.lower() == "abort" or s.lower() == "q":
@@ -535,13 +632,23 @@ def set_light_condition(sport,LED_vals):
   global LED_status
   assert len(LED_vals) == num_LEDs
 
+  # Set all LEDs with a single command, if anything changed:
+  if LED_vals != LED_status:
+    muff_arduino.set_LED_mask(sport, LED_mask(LED_vals))
+    LED_status = list(LED_vals)
+# ----------------------------------------------------------------------
+
+def LED_mask(LED_vals):
+  """Converts a list {LED_vals} of {num_LEDs} intensities 
+  (currently either 0.0 or 1.0) to an integer whose bit {k}
+  is 1 iff LED {k} is on."""
+  
+  mask = 0
   for lix in range(num_LEDs):
     pwr = LED_vals[lix] # Desired intensity of LED {lix}:
     assert type(pwr) is float and pwr == 0.0 or pwr == 1.0
-    if pwr != LED_status[lix]:
-      # Must change state of LED {lix}:
-      muff_arduino.switch_LED(sport, lix, pwr)
-      LED_status[lix] = pwr
+    if pwr == 1.0: mask = mask | (1 << lix)
+  return mask
 # ----------------------------------------------------------------------
   
 def switch_all_lights_off(sport):
@@ -591,10 +698,11 @@ def show_chars(s, blanks):
 def parse_command_line_args():
   """Parses the command line arguments and 
   returns the scan set parametes.  If succeeds,
-  returns {(True,nL,nV,nH,Z_step)}.  If something goes wrong,
-  returns {(False,None,None,None,None)}."""
+  returns {(True,nL,nV,nH,Z_step,Z_start)}, where {Z_start} is {None}
+  if not given.  If something goes wrong,
+  returns {(False,None,None,None,None,None)}."""
   
-  if len(sys.argv) != 5 or sys.argv[1] == "-help":
+  if (len(sys.argv) != 5 and len(sys.argv) != 6) or sys.argv[1] == "-help":
     # Display the help text and exit:
     stderr.write("SYNOPSIS\n")
     stderr.write(HELP + "\n\n")
@@ -609,12 +717,16 @@ def parse_command_line_args():
     nV = int(sys.argv[2]) 
     nH = int(sys.argv[3])
     Z_step = float(sys.argv[4])
+    Z_start = float(sys.argv[5]) if len(sys.argv) == 6 else None
   except:
     stderr.write("** [muff_mainloop:] bad command line arguments '%s'\n" % ("' '".join(sys.argv)))
     stderr.write(HELP + "\n\n")
-    return (False,None,None,None,None)
+    return (False,None,None,None,None,None)
+  if Z_start != None and (Z_start < 0 or Z_start > Z_range_max):
+    stderr.write("** [muff_mainloop:] invalid {Z_start} = %.3f\n" % Z_start)
+    return (False,None,None,None,None,None)
   
-  return (True,nL,nV,nH,Z_step)
+  return (True,nL,nV,nH,Z_step,Z_start)
 # ----------------------------------------------------------------------  
   
 def terminate_process(sport,m2cPipe,c2mPipe,ok):
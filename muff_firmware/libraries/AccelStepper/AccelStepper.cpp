@@ -22,6 +22,22 @@ void dump(uint8_t* p, int l)
 
 void AccelStepper::moveTo(long absolute)
 {
+#if ACCELSTEPPER_QUEUE_SIZE
+    clearQueue();
+#endif
+#if ACCELSTEPPER_RAMP_TABLE
+    if (_ramp)
+    {
+	// Abandon the table, and carry on from the current speed with the computed profile
+	_ramp = NULL;
+	float speed = fabs(this->speed());
+	_n = (long)((speed * speed) / (2.0 * _acceleration)); // Equation 16
+#if ACCELSTEPPER_SCURVE
+	_sSpeed = speed;
+	_sAccel = 0.0;
+#endif
+    }
+#endif
     if (_targetPos != absolute)
     {
 	_targetPos = absolute;
@@ -35,11 +51,439 @@ void AccelStepper::move(long relative)
     moveTo(_currentPos + relative);
 }
 
+#if ACCELSTEPPER_RAMP_TABLE
+uint8_t AccelStepper::buildRampTable(long distance, float speed, uint16_t *table, uint8_t size)
+{
+    if (distance < 0)
+	distance = -distance;
+    if (distance == 0 || size == 0)
+	return 0;
+#if ACCELSTEPPER_SCURVE
+    float jerk = _jerk;
+#else
+    float jerk = 0.0;
+#endif
+    // Run the profile on local variables, as moveDuration() does, without stepping the motor
+    uint8_t length = 0;
+    replayMove(distance, speed, _acceleration, jerk, table, size, &length);
+    // Once cruising, the last entry stands for all the rest
+    while (length > 1 && table[length - 1] == table[length - 2])
+	length--;
+    return length;
+}
+
+// Stores the interval computed after step k of a move of distance steps, for buildRampTable().
+// Interval k - 1 of the table follows step k; only the first half of them is needed, or the
+// first one if there is only one step, and none past the start of the cruise.
+// Returns true once the table is complete, or as soon as it fails, with *length set to 0
+static bool storeRampInterval(unsigned long interval, long k, long distance, bool cruising,
+			      uint16_t *table, uint8_t size, uint8_t *length)
+{
+    if (distance > 1 && k == 0)
+	return false; // The interval before the first step
+    if (interval == 0 || interval > 0xffff)
+    {
+	*length = 0;
+	return true;
+    }
+    if (*length < size)
+	table[(*length)++] = interval;
+    else if (interval != table[size - 1])
+    {
+	*length = 0; // Still accelerating when the table is full
+	return true;
+    }
+    return cruising || k >= distance / 2;
+}
+
+#endif
+
+unsigned long AccelStepper::moveDuration(long distance, float speed, float acceleration, float jerk) const
+{
+    return replayMove(distance, speed, acceleration, jerk, NULL, 0, NULL);
+}
+
+unsigned long AccelStepper::replayMove(long distance, float speed, float acceleration, float jerk,
+				       uint16_t *table, uint8_t size, uint8_t *length) const
+{
+#if !ACCELSTEPPER_RAMP_TABLE
+    (void)table;
+    (void)size;
+    (void)length;
+#endif
+    if (distance < 0)
+	distance = -distance;
+    if (speed < 0.0)
+	speed = -speed;
+    if (acceleration < 0.0)
+	acceleration = -acceleration;
+    if (distance == 0 || speed == 0.0 || acceleration == 0.0)
+	return 0;
+    // Replays computeNewSpeed() on local copies of its state, stepping clockwise from rest.
+    // dist is distanceToGo() and cw is _direction; every interval but the first (before the
+    // first step) is added up
+    long dist = distance;
+    bool cw = true;
+    bool first = true;
+    long k = 0; // Steps taken
+    unsigned long interval;
+    unsigned long total = 0;
+#if ACCELSTEPPER_SCURVE
+    if (jerk < 0.0)
+	jerk = -jerk;
+    if (jerk > 0.0)
+    {
+	// As computeNewSpeedSCurve(), with the constants of setJerk()
+	float sMinSpeed = 0.5 * jerk * pow(6.0 / jerk, 2.0 / 3.0);
+	float v = 0.0;
+	float a = 0.0;
+	interval = 0;
+	for (;;)
+	{
+	    float dt = interval * 0.000001;
+	    if (dist == 0 && v <= 2.0 * sMinSpeed)
+		return total;
+	    long d = cw ? dist : -dist;
+	    if (v == 0.0)
+	    {
+		cw = (dist > 0);
+		v = sMinSpeed;
+		a = 0.0;
+	    }
+	    else
+	    {
+		float aTarget;
+		if (v + ((a > 0.0) ? (a * a) / (2.0 * jerk) : 0.0) >= speed)
+		    aTarget = 0.0;
+		else
+		    aTarget = acceleration;
+		float da = constrain(aTarget - a, -jerk * dt, jerk * dt);
+		if (d <= 0 || d - 1 < sCurveStopSteps(v + (a + 0.5 * da) * dt, a + da, jerk, acceleration))
+		{
+		    aTarget = (a < 0.0 && v <= (a * a) / (2.0 * jerk)) ? 0.0 : -acceleration;
+		    da = constrain(aTarget - a, -jerk * dt, jerk * dt);
+		}
+		v += (a + 0.5 * da) * dt;
+		a += da;
+		if (v >= speed)
+		{
+		    v = speed;
+		    if (a > 0.0)
+			a = 0.0;
+		}
+		if (v < sMinSpeed)
+		{
+		    if (d <= 0)
+			cw = (dist > 0);
+		    v = sMinSpeed;
+		    a = 0.0;
+		}
+	    }
+	    interval = 1000000.0 / v;
+	    if (!first)
+		total += interval;
+	    first = false;
+	    d = cw ? dist : -dist;
+	    bool cruising = (v == speed && a == 0.0 && d > 0);
+#if ACCELSTEPPER_RAMP_TABLE
+	    if (table && storeRampInterval(interval, k, distance, cruising, table, size, length))
+		return total;
+#endif
+	    if (cruising)
+	    {
+		// Cruising: the next steps keep this interval while d - 1 >= the steps to stop
+		long cruise = d - 1 - (long)ceil(sCurveStopSteps(v, 0.0, jerk, acceleration));
+		if (cruise > 0)
+		{
+		    total += cruise * interval;
+		    dist += cw ? -cruise : cruise;
+		}
+	    }
+	    dist += cw ? -1 : 1; // The step
+	    k++;
+	}
+    }
+#else
+    (void)jerk;
+#endif
+    // As computeNewSpeed(), with the constants of setAcceleration() and setMaxSpeed()
+    long n = 0;
+    float c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; // Equation 15
+#if ACCELSTEPPER_INTEGER_PROFILE
+    unsigned long c0Fixed = (c0 < 8388607.0) ? (unsigned long)(c0 * 256.0) : 0x7fffffff;
+    float cminFixed = 256000000.0 / speed;
+    unsigned long cmin = (cminFixed < 4294967295.0) ? (unsigned long)cminFixed : 0xffffffff;
+    unsigned long cn = 0;
+#else
+    float cmin = 1000000.0 / speed;
+    float cn = 0.0;
+    float v = 0.0;
+#endif
+    for (;;)
+    {
+#if ACCELSTEPPER_INTEGER_PROFILE
+	long stepsToStop = (n > 0) ? n - 1 : -n;
+#else
+	long stepsToStop = (long)((v * v) / (2.0 * acceleration)); // Equation 16
+#endif
+	if (dist == 0 && stepsToStop <= 1)
+	    return total;
+	if (dist > 0)
+	{
+	    if (n > 0)
+	    {
+		if ((stepsToStop >= dist) || !cw)
+		    n = -stepsToStop;
+	    }
+	    else if (n < 0)
+	    {
+		if ((stepsToStop < dist) && cw)
+		    n = -n;
+	    }
+	}
+	else if (dist < 0)
+	{
+	    if (n > 0)
+	    {
+		if ((stepsToStop >= -dist) || cw)
+		    n = -stepsToStop;
+	    }
+	    else if (n < 0)
+	    {
+		if ((stepsToStop < -dist) && !cw)
+		    n = -n;
+	    }
+	}
+	bool cruising;
+#if ACCELSTEPPER_INTEGER_PROFILE
+	cruising = (n > 0 && cn <= cmin);
+	if (n == 0)
+	{
+	    cn = c0Fixed;
+	    cw = (dist > 0);
+	    n++;
+	}
+	else if (cruising)
+	    cn = cmin;
+	else
+	{
+	    if (n > 0)
+		cn -= (2 * cn) / (unsigned long)((4 * n) + 1); // Equation 13
+	    else
+		cn += (2 * cn) / (unsigned long)((-4 * n) - 1); // Equation 13
+	    if (cn < cmin)
+		cn = cmin;
+	    n++;
+	}
+	interval = cn >> 8;
+#else
+	if (n == 0)
+	{
+	    cn = c0;
+	    cw = (dist > 0);
+	}
+	else
+	{
+	    cn = cn - ((2.0 * cn) / ((4.0 * n) + 1)); // Equation 13
+	    cn = max(cn, cmin);
+	}
+	n++;
+	cruising = (n > 1 && cn == cmin);
+	interval = cn;
+	v = 1000000.0 / cn;
+#endif
+	if (!first)
+	    total += interval;
+	first = false;
+	long d = cw ? dist : -dist;
+#if ACCELSTEPPER_RAMP_TABLE
+	if (table && storeRampInterval(interval, k, distance, cruising && d > 0, table, size, length))
+	    return total;
+#endif
+	if (cruising && d > 0)
+	{
+	    // The next steps keep this interval while the steps to stop stay fewer than d
+#if ACCELSTEPPER_INTEGER_PROFILE
+	    stepsToStop = n - 1;
+#else
+	    stepsToStop = (long)((v * v) / (2.0 * acceleration)); // Equation 16
+#endif
+	    long cruise = d - 1 - stepsToStop;
+	    if (cruise > 0)
+	    {
+		total += cruise * interval;
+		dist += cw ? -cruise : cruise;
+#if !ACCELSTEPPER_INTEGER_PROFILE
+		n += cruise;
+#endif
+	    }
+	}
+	dist += cw ? -1 : 1; // The step
+	k++;
+    }
+}
+
+#if ACCELSTEPPER_RAMP_TABLE
+void AccelStepper::moveWithRamp(long relative, const uint16_t *table, uint8_t length)
+{
+    move(relative); // Discards the queue, and any table being replayed
+    if (relative == 0 || length == 0)
+	return;
+    _ramp = table;
+    _rampLength = length;
+    _rampStart = _currentPos;
+    _rampSteps = (relative > 0) ? relative : -relative;
+    _direction = (relative > 0) ? DIRECTION_CW : DIRECTION_CCW;
+    computeNewSpeed();
+}
+
+void AccelStepper::computeNewSpeedRamp()
+{
+    long k = _currentPos - _rampStart; // Steps taken so far
+    if (k < 0)
+	k = -k;
+    if (k >= _rampSteps)
+    {
+	// At the target: stop, or go on with a queued move
+	_ramp = NULL;
+	_stepInterval = 0;
+	_speed = 0.0;
+	_n = 0;
+	computeNewSpeed();
+	return;
+    }
+    // Interval after step k; the second half of the move mirrors the first
+    long i = (k > 0) ? k - 1 : 0;
+    if (i > _rampSteps - 1 - k)
+	i = _rampSteps - 1 - k;
+    if (i >= _rampLength)
+	i = _rampLength - 1;
+    _stepInterval = _ramp[i];
+    _n = 0; // The step counter is not used
+#if ACCELSTEPPER_INTEGER_PROFILE
+    _cnFixed = _stepInterval << 8;
+#else
+    _cn = _stepInterval;
+#endif
+    _speed = 1000000.0 / _stepInterval;
+    if (_direction == DIRECTION_CCW)
+	_speed = -_speed;
+}
+#endif
+
+#if ACCELSTEPPER_QUEUE_SIZE
+boolean AccelStepper::queueMoveTo(long absolute, float speed)
+{
+    if (speed < 0.0)
+	speed = -speed;
+    if (_queueCount == 0 && !isRunning())
+    {
+	setMaxSpeed(speed);
+	moveTo(absolute);
+	return true;
+    }
+    if (_queueCount >= ACCELSTEPPER_QUEUE_SIZE)
+	return false;
+    long last = _queueCount ? _queue[(_queueHead + _queueCount - 1) % ACCELSTEPPER_QUEUE_SIZE].target : _targetPos;
+    if (absolute == last)
+	return true; // Nothing to do
+    QueuedMove *m = &_queue[(_queueHead + _queueCount) % ACCELSTEPPER_QUEUE_SIZE];
+    m->target = absolute;
+    m->maxSpeed = speed;
+    m->maxSteps = (long)((speed * speed) / (2.0 * _acceleration)); // Equation 16
+#if ACCELSTEPPER_INTEGER_PROFILE
+    float cminFixed = 256000000.0 / speed;
+    m->cminFixed = (cminFixed < 4294967295.0) ? (unsigned long)cminFixed : 0xffffffff;
+#else
+    m->cmin = 1000000.0 / speed;
+#endif
+    _queueCount++;
+    planJunctions();
+    return true;
+}
+
+uint8_t AccelStepper::queuedMoves()
+{
+    return _queueCount;
+}
+
+void AccelStepper::clearQueue()
+{
+    _queueCount = 0;
+    _junctionSteps = 0;
+}
+
+// Backward pass over the queue: the speed at each junction may not exceed the max speed of
+// either segment, and must be low enough to stop (or slow down for the next junction) within the
+// following segment. Speeds are held as the number of steps to stop from them (Equation 16),
+// which is what computeNewSpeed() compares against the remaining distance.
+void AccelStepper::planJunctions()
+{
+    // pos[0] is the current position, pos[1] the current target, pos[i+1] the target of queued move i
+    long pos[ACCELSTEPPER_QUEUE_SIZE + 2];
+    long maxSteps[ACCELSTEPPER_QUEUE_SIZE + 2];
+    pos[0] = _currentPos;
+    pos[1] = _targetPos;
+    maxSteps[1] = _maxSteps;
+    uint8_t i;
+    for (i = 0; i < _queueCount; i++)
+    {
+	QueuedMove *m = &_queue[(_queueHead + i) % ACCELSTEPPER_QUEUE_SIZE];
+	pos[i + 2] = m->target;
+	maxSteps[i + 2] = m->maxSteps;
+    }
+    long e = 0; // Steps to stop when reaching pos[i + 1]; 0 at the end of the queue
+    for (i = _queueCount; i > 0; i--)
+    {
+	long before = pos[i] - pos[i - 1];
+	long after = pos[i + 1] - pos[i];
+	if (before == 0 || (before > 0) != (after > 0))
+	    e = 0; // Reversal, or no known direction: stop at the junction
+	else
+	{
+	    e += (after > 0) ? after : -after;
+	    if (e > maxSteps[i + 1])
+		e = maxSteps[i + 1];
+	    if (e > maxSteps[i])
+		e = maxSteps[i];
+	}
+    }
+    _junctionSteps = e;
+}
+
+void AccelStepper::nextQueuedMove()
+{
+    QueuedMove *m = &_queue[_queueHead];
+    _queueHead = (_queueHead + 1) % ACCELSTEPPER_QUEUE_SIZE;
+    _queueCount--;
+    _targetPos = m->target;
+    _maxSpeed = m->maxSpeed;
+    _maxSteps = m->maxSteps;
+#if ACCELSTEPPER_INTEGER_PROFILE
+    _cminFixed = m->cminFixed;
+#else
+    _cmin = m->cmin;
+#endif
+    if (_junctionSteps == 0)
+	_n = 0; // Stopped at the junction: start the new move from rest
+    else if (_n < 0)
+	_n = -_n; // Was slowing down for the junction: accelerate again
+#if !ACCELSTEPPER_INTEGER_PROFILE
+    else
+	_n = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16, as in setMaxSpeed()
+#endif
+    planJunctions();
+}
+#endif
+
 // Implements steps according to the current step interval
 // You must call this at least once per step
 // returns true if a step occurred
 boolean AccelStepper::runSpeed()
 {
+#if ACCELSTEPPER_FAST_DRIVER
+    endStepPulse(false);
+#endif
     // Dont do anything unless we actually have a step interval
     if (!_stepInterval)
 	return false;
@@ -69,6 +513,33 @@ boolean AccelStepper::runSpeed()
     }
 }
 
+// Implements one step of the acceleration profile without checking the time
+// For use from a timer interrupt handler, which must call it again after the returned interval
+// returns 0 if the motor has stopped
+unsigned long AccelStepper::runStep()
+{
+    if (!_stepInterval)
+	return 0;
+
+    if (_direction == DIRECTION_CW)
+	_currentPos += 1;
+    else
+	_currentPos -= 1;
+    step(_currentPos);
+
+    _lastStepTime = micros();
+    computeNewSpeed();
+#if ACCELSTEPPER_FAST_DRIVER
+    endStepPulse(true);
+#endif
+    return _stepInterval;
+}
+
+unsigned long AccelStepper::stepInterval()
+{
+    return _stepInterval;
+}
+
 long AccelStepper::distanceToGo()
 {
     return _targetPos - _currentPos;
@@ -89,6 +560,12 @@ long AccelStepper::currentPosition()
 void AccelStepper::setCurrentPosition(long position)
 {
     _targetPos = _currentPos = position;
+#if ACCELSTEPPER_QUEUE_SIZE
+    clearQueue();
+#endif
+#if ACCELSTEPPER_RAMP_TABLE
+    _ramp = NULL;
+#endif
     _n = 0;
     _stepInterval = 0;
     _speed = 0.0;
@@ -96,9 +573,47 @@ void AccelStepper::setCurrentPosition(long position)
 
 void AccelStepper::computeNewSpeed()
 {
+#if ACCELSTEPPER_RAMP_TABLE
+    if (_ramp)
+    {
+	computeNewSpeedRamp();
+	return;
+    }
+#endif
+#if ACCELSTEPPER_SCURVE
+    if (_jerk > 0.0)
+    {
+	computeNewSpeedSCurve();
+	return;
+    }
+#endif
     long distanceTo = distanceToGo(); // +ve is clockwise from curent location
 
+#if ACCELSTEPPER_INTEGER_PROFILE
+    // _n is held constant while cruising, so it always gives the number of steps
+    // it takes to stop from the current speed (Equation 16). When accelerating, _n has
+    // already been incremented past the last step, and v^2/2a is about _n - 0.5
+    long stepsToStop = (_n > 0) ? _n - 1 : -_n;
+#else
     long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
+#endif
+
+#if ACCELSTEPPER_QUEUE_SIZE
+    // At the target with a queued move: go on at once through a junction in the same direction,
+    // or once stopped if the next move reverses
+    if (distanceTo == 0 && _queueCount && (_junctionSteps || stepsToStop <= 1))
+    {
+	nextQueuedMove();
+	distanceTo = distanceToGo();
+#if ACCELSTEPPER_INTEGER_PROFILE
+	stepsToStop = (_n > 0) ? _n - 1 : -_n;
+#endif
+    }
+    // Steps to stop from the speed allowed at the target
+    long junctionSteps = _junctionSteps;
+#else
+    long junctionSteps = 0;
+#endif
 
     if (distanceTo == 0 && stepsToStop <= 1)
     {
@@ -116,13 +631,13 @@ void AccelStepper::computeNewSpeed()
 	if (_n > 0)
 	{
 	    // Currently accelerating, need to decel now? Or maybe going the wrong way?
-	    if ((stepsToStop >= distanceTo) || _direction == DIRECTION_CCW)
+	    if ((stepsToStop >= distanceTo + junctionSteps) || _direction == DIRECTION_CCW)
 		_n = -stepsToStop; // Start deceleration
 	}
 	else if (_n < 0)
 	{
 	    // Currently decelerating, need to accel again?
-	    if ((stepsToStop < distanceTo) && _direction == DIRECTION_CW)
+	    if ((stepsToStop < distanceTo + junctionSteps) && _direction == DIRECTION_CW)
 		_n = -_n; // Start accceleration
 	}
     }
@@ -133,18 +648,44 @@ void AccelStepper::computeNewSpeed()
 	if (_n > 0)
 	{
 	    // Currently accelerating, need to decel now? Or maybe going the wrong way?
-	    if ((stepsToStop >= -distanceTo) || _direction == DIRECTION_CW)
+	    if ((stepsToStop >= -distanceTo + junctionSteps) || _direction == DIRECTION_CW)
 		_n = -stepsToStop; // Start deceleration
 	}
 	else if (_n < 0)
 	{
 	    // Currently decelerating, need to accel again?
-	    if ((stepsToStop < -distanceTo) && _direction == DIRECTION_CCW)
+	    if ((stepsToStop < -distanceTo + junctionSteps) && _direction == DIRECTION_CCW)
 		_n = -_n; // Start accceleration
 	}
     }
 
     // Need to accelerate or decelerate
+#if ACCELSTEPPER_INTEGER_PROFILE
+    if (_n == 0)
+    {
+	// First step from stopped
+	_cnFixed = _c0Fixed;
+	_direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
+	_n++;
+    }
+    else if (_n > 0 && _cnFixed <= _cminFixed)
+    {
+	// Cruising at max speed. Dont count the step, so _n still gives the steps to stop
+	_cnFixed = _cminFixed;
+    }
+    else
+    {
+	// Subsequent step. Works for accel (n is +_ve) and decel (n is -ve).
+	if (_n > 0)
+	    _cnFixed -= (2 * _cnFixed) / (unsigned long)((4 * _n) + 1); // Equation 13
+	else
+	    _cnFixed += (2 * _cnFixed) / (unsigned long)((-4 * _n) - 1); // Equation 13
+	if (_cnFixed < _cminFixed)
+	    _cnFixed = _cminFixed;
+	_n++;
+    }
+    _stepInterval = _cnFixed >> 8;
+#else
     if (_n == 0)
     {
 	// First step from stopped
@@ -162,6 +703,7 @@ void AccelStepper::computeNewSpeed()
     _speed = 1000000.0 / _cn;
     if (_direction == DIRECTION_CCW)
 	_speed = -_speed;
+#endif
 
 #if 0
     Serial.println(_speed);
@@ -176,6 +718,142 @@ void AccelStepper::computeNewSpeed()
 #endif
 }
 
+#if ACCELSTEPPER_SCURVE
+// Follows the same plan as the trapezoidal profile (speed up, cruise, slow down in time to stop at
+// the target), but the acceleration is moved towards +/- _acceleration or 0 at no more than _jerk,
+// and the speed is integrated from it over the interval of the step just taken
+void AccelStepper::computeNewSpeedSCurve()
+{
+    long distanceTo = distanceToGo(); // +ve is clockwise from curent location
+    float v = _sSpeed;
+    float a = _sAccel;
+    float dt = _stepInterval * 0.000001; // Time since the previous step, 0 if stopped
+    if (!_stepInterval)
+	v = a = 0.0;
+
+#if ACCELSTEPPER_QUEUE_SIZE
+    // At the target with a queued move: go on at once through a junction in the same direction,
+    // or once stopped if the next move reverses
+    if (distanceTo == 0 && _queueCount && (_junctionSteps || v <= 2.0 * _sMinSpeed))
+    {
+	nextQueuedMove();
+	distanceTo = distanceToGo();
+    }
+    long junctionSteps = _junctionSteps;
+#else
+    long junctionSteps = 0;
+#endif
+
+    if (distanceTo == 0 && v <= 2.0 * _sMinSpeed)
+    {
+	// We are at the target and its time to stop
+	_stepInterval = 0;
+	_speed = 0.0;
+	_sSpeed = _sAccel = 0.0;
+	_n = 0;
+	return;
+    }
+
+    if (v == 0.0)
+    {
+	// First step from stopped
+	_direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
+	v = _sMinSpeed;
+	a = 0.0;
+    }
+    else
+    {
+	// Steps left in the current direction, negative if going the wrong way
+	long d = (_direction == DIRECTION_CW) ? distanceTo : -distanceTo;
+	float aTarget;
+	if (v + ((a > 0.0) ? (a * a) / (2.0 * _jerk) : 0.0) >= _maxSpeed)
+	    // Ease off the acceleration to level off at max speed
+	    aTarget = 0.0;
+	else
+	    aTarget = _acceleration;
+	float da = constrain(aTarget - a, -_jerk * dt, _jerk * dt);
+	// The step intervals are long at low speeds, so look one step ahead: slow down now if
+	// the motor could no longer stop in time after another step without doing so
+	if (d <= 0 || d - 1 + junctionSteps < sCurveStopSteps(v + (a + 0.5 * da) * dt, a + da, _jerk, _acceleration))
+	{
+	    // Slow down, easing off the deceleration as the speed runs out
+	    aTarget = (a < 0.0 && v <= (a * a) / (2.0 * _jerk)) ? 0.0 : -_acceleration;
+	    da = constrain(aTarget - a, -_jerk * dt, _jerk * dt);
+	}
+	v += (a + 0.5 * da) * dt;
+	a += da;
+	if (v >= _maxSpeed)
+	{
+	    v = _maxSpeed;
+	    if (a > 0.0)
+		a = 0.0;
+	}
+	if (v < _sMinSpeed)
+	{
+	    // Going as slowly as it may. If going the wrong way, turn around here
+	    if (d <= 0)
+		_direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
+	    v = _sMinSpeed;
+	    a = 0.0;
+	}
+    }
+    _sSpeed = v;
+    _sAccel = a;
+    _n = 0; // The trapezoidal step counter is not used
+    _stepInterval = 1000000.0 / v;
+#if ACCELSTEPPER_INTEGER_PROFILE
+    _cnFixed = _stepInterval << 8;
+#else
+    _cn = _stepInterval;
+#endif
+    _speed = (_direction == DIRECTION_CW) ? v : -v;
+}
+
+// Steps to stop if the deceleration is brought up to acceleration (less if the speed
+// runs out first) and then eased off, each at no more than j
+float AccelStepper::sCurveStopSteps(float v, float a, float j, float acceleration)
+{
+    float d = 0.0;
+    float t;
+    if (a > 0.0)
+    {
+	// Still speeding up while the acceleration is brought down to 0
+	t = a / j;
+	d += v * t + a * t * t / 2.0 - j * t * t * t / 6.0;
+	v += (a * a) / (2.0 * j);
+	a = 0.0;
+    }
+    float b = -a; // Current deceleration
+    if (v <= (b * b) / (2.0 * j))
+    {
+	// Only the easing off is left
+	t = b / j;
+	return d + v * t - b * t * t / 2.0 + j * t * t * t / 6.0;
+    }
+    // Peak deceleration, such that easing off from it takes up the speed left
+    float p = sqrt(j * v + (b * b) / 2.0);
+    if (p > acceleration)
+	p = acceleration;
+    if (p < b)
+	p = b;
+    // Bring the deceleration up to p
+    t = (p - b) / j;
+    d += v * t - b * t * t / 2.0 - j * t * t * t / 6.0;
+    v -= b * t + j * t * t / 2.0;
+    // Hold it until the speed is what easing off takes up
+    float vEase = (p * p) / (2.0 * j);
+    if (v > vEase)
+    {
+	t = (v - vEase) / p;
+	d += v * t - p * t * t / 2.0;
+    }
+    // Ease off to 0
+    t = p / j;
+    d += vEase * t - p * t * t / 2.0 + j * t * t * t / 6.0;
+    return d;
+}
+#endif
+
 // Run the motor to implement speed and acceleration in order to proceed to the target position
 // You must call this at least once per step, preferably in your main loop
 // If the motor is in the desired position, the cost is very small
@@ -183,8 +861,17 @@ void AccelStepper::computeNewSpeed()
 boolean AccelStepper::run()
 {
     if (runSpeed())
+    {
 	computeNewSpeed();
+#if ACCELSTEPPER_FAST_DRIVER
+	endStepPulse(false);
+#endif
+    }
+#if ACCELSTEPPER_INTEGER_PROFILE
+    return _stepInterval != 0 || distanceToGo() != 0;
+#else
     return _speed != 0.0 || distanceToGo() != 0;
+#endif
 }
 
 AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_t pin3, uint8_t pin4, bool enable)
@@ -211,11 +898,51 @@ AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_
     _c0 = 0.0;
     _cn = 0.0;
     _cmin = 1.0;
+#if ACCELSTEPPER_INTEGER_PROFILE
+    _c0Fixed = 0;
+    _cnFixed = 0;
+    _cminFixed = 256;
+#endif
     _direction = DIRECTION_CCW;
+#if ACCELSTEPPER_SCURVE
+    _jerk = 0.0;
+    _sSpeed = 0.0;
+    _sAccel = 0.0;
+    _sMinSpeed = 1.0;
+#endif
+#if ACCELSTEPPER_RAMP_TABLE
+    _ramp = NULL;
+    _rampLength = 0;
+    _rampStart = 0;
+    _rampSteps = 0;
+#endif
+#if ACCELSTEPPER_QUEUE_SIZE
+    _queueHead = 0;
+    _queueCount = 0;
+    _junctionSteps = 0;
+    _maxSteps = 0;
+#endif
 
     int i;
     for (i = 0; i < 4; i++)
 	_pinInverted[i] = 0;
+#if ACCELSTEPPER_FAST_DRIVER
+    _stepPort = NULL;
+    _dirPort = NULL;
+    _stepMask = 0;
+    _dirMask = 0;
+    _pulsePending = false;
+    if (_interface == DRIVER
+	&& digitalPinToPort(pin1) != NOT_A_PIN
+	&& digitalPinToPort(pin2) != NOT_A_PIN)
+    {
+	// Resolve the pins once, so step1() need not call digitalWrite()
+	_stepPort = portOutputRegister(digitalPinToPort(pin1));
+	_stepMask = digitalPinToBitMask(pin1);
+	_dirPort = portOutputRegister(digitalPinToPort(pin2));
+	_dirMask = digitalPinToBitMask(pin2);
+    }
+#endif
     if (enable)
 	enableOutputs();
     // Some reasonable default
@@ -247,11 +974,41 @@ AccelStepper::AccelStepper(void (*forward)(), void (*backward)())
     _c0 = 0.0;
     _cn = 0.0;
     _cmin = 1.0;
+#if ACCELSTEPPER_INTEGER_PROFILE
+    _c0Fixed = 0;
+    _cnFixed = 0;
+    _cminFixed = 256;
+#endif
     _direction = DIRECTION_CCW;
+#if ACCELSTEPPER_SCURVE
+    _jerk = 0.0;
+    _sSpeed = 0.0;
+    _sAccel = 0.0;
+    _sMinSpeed = 1.0;
+#endif
+#if ACCELSTEPPER_RAMP_TABLE
+    _ramp = NULL;
+    _rampLength = 0;
+    _rampStart = 0;
+    _rampSteps = 0;
+#endif
+#if ACCELSTEPPER_QUEUE_SIZE
+    _queueHead = 0;
+    _queueCount = 0;
+    _junctionSteps = 0;
+    _maxSteps = 0;
+#endif
 
     int i;
     for (i = 0; i < 4; i++)
 	_pinInverted[i] = 0;
+#if ACCELSTEPPER_FAST_DRIVER
+    _stepPort = NULL;
+    _dirPort = NULL;
+    _stepMask = 0;
+    _dirMask = 0;
+    _pulsePending = false;
+#endif
     // Some reasonable default
     setAcceleration(1);
 }
@@ -264,12 +1021,29 @@ void AccelStepper::setMaxSpeed(float speed)
     {
 	_maxSpeed = speed;
 	_cmin = 1000000.0 / speed;
+#if ACCELSTEPPER_QUEUE_SIZE
+	_maxSteps = (long)((speed * speed) / (2.0 * _acceleration)); // Equation 16
+	if (_queueCount)
+	    planJunctions();
+#endif
+#if ACCELSTEPPER_INTEGER_PROFILE
+	float cminFixed = 256000000.0 / speed;
+	_cminFixed = (cminFixed < 4294967295.0) ? (unsigned long)cminFixed : 0xffffffff;
+	// Recompute _n from current speed and adjust speed if accelerating or cruising
+	if (_n > 0)
+	{
+	    float currentSpeed = this->speed();
+	    _n = (long)((currentSpeed * currentSpeed) / (2.0 * _acceleration)); // Equation 16
+	    computeNewSpeed();
+	}
+#else
 	// Recompute _n from current speed and adjust speed if accelerating or cruising
 	if (_n > 0)
 	{
 	    _n = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
 	    computeNewSpeed();
 	}
+#endif
     }
 }
 
@@ -290,15 +1064,60 @@ void AccelStepper::setAcceleration(float acceleration)
 	_n = _n * (_acceleration / acceleration);
 	// New c0 per Equation 7, with correction per Equation 15
 	_c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; // Equation 15
+#if ACCELSTEPPER_INTEGER_PROFILE
+	// Keep 2 * _c0Fixed within an unsigned long for Equation 13
+	_c0Fixed = (_c0 < 8388607.0) ? (unsigned long)(_c0 * 256.0) : 0x7fffffff;
+#endif
 	_acceleration = acceleration;
+#if ACCELSTEPPER_QUEUE_SIZE
+	_maxSteps = (long)((_maxSpeed * _maxSpeed) / (2.0 * acceleration)); // Equation 16
+#endif
 	computeNewSpeed();
     }
 }
 
+float   AccelStepper::acceleration()
+{
+    return _acceleration;
+}
+
+#if ACCELSTEPPER_SCURVE
+void AccelStepper::setJerk(float jerk)
+{
+    if (jerk < 0.0)
+	jerk = -jerk;
+    if (_jerk == jerk)
+	return;
+    float speed = fabs(this->speed());
+    if (jerk > 0.0)
+    {
+	// Carry on from the current speed
+	_sSpeed = speed;
+	_sAccel = 0.0;
+	// Speed after the first step from rest, which takes cbrt(6/jerk) seconds
+	_sMinSpeed = 0.5 * jerk * pow(6.0 / jerk, 2.0 / 3.0);
+    }
+    else if (_stepInterval)
+    {
+	// Back to the trapezoidal profile, as if cruising at the current speed
+	_n = (long)((speed * speed) / (2.0 * _acceleration)); // Equation 16
+    }
+    _jerk = jerk;
+}
+
+float   AccelStepper::jerk()
+{
+    return _jerk;
+}
+#endif
+
 void AccelStepper::setSpeed(float speed)
 {
+#if !ACCELSTEPPER_INTEGER_PROFILE
+    // With the integer profile _speed is not updated after each step, so cant skip
     if (speed == _speed)
         return;
+#endif
     speed = constrain(speed, -_maxSpeed, _maxSpeed);
     if (speed == 0.0)
 	_stepInterval = 0;
@@ -312,7 +1131,14 @@ void AccelStepper::setSpeed(float speed)
 
 float AccelStepper::speed()
 {
+#if ACCELSTEPPER_INTEGER_PROFILE
+    if (!_stepInterval)
+	return 0.0;
+    float speed = 1000000.0 / _stepInterval;
+    return (_direction == DIRECTION_CW) ? speed : -speed;
+#else
     return _speed;
+#endif
 }
 
 // Subclasses can override
@@ -370,7 +1196,11 @@ void AccelStepper::setOutputPins(uint8_t mask)
 void AccelStepper::step0(long step)
 {
     (void)(step); // Unused
+#if ACCELSTEPPER_INTEGER_PROFILE
+    if (_direction == DIRECTION_CW)
+#else
     if (_speed > 0)
+#endif
 	_forward();
     else
 	_backward();
@@ -383,6 +1213,41 @@ void AccelStepper::step1(long step)
 {
     (void)(step); // Unused
 
+#if ACCELSTEPPER_FAST_DRIVER
+    if (_stepPort)
+    {
+	// A previous pulse may still be active if nothing polled the stepper since
+	// it was started. End it, and keep the Step pin inactive for minPulseWidth too
+	if (_pulsePending)
+	{
+	    endStepPulse(true);
+	    delayMicroseconds(_minPulseWidth);
+	}
+	uint8_t dir = _direction ^ _pinInverted[1];
+	uint8_t oldSREG = SREG;
+	cli();
+	if (((*_dirPort & _dirMask) != 0) != dir)
+	{
+	    // Set direction first else get rogue pulses
+	    if (dir)
+		*_dirPort |= _dirMask;
+	    else
+		*_dirPort &= ~_dirMask;
+	    SREG = oldSREG;
+	    delayMicroseconds(1); // Caution 200ns (3967) or 650ns (DRV8825) setup time 
+	    cli();
+	}
+	// Step active. It is made inactive by endStepPulse() 
+	if (_pinInverted[0])
+	    *_stepPort &= ~_stepMask;
+	else
+	    *_stepPort |= _stepMask;
+	SREG = oldSREG;
+	_pulsePending = true;
+	return;
+    }
+#endif
+
     // _pin[0] is step, _pin[1] is direction
     setOutputPins(_direction ? 0b10 : 0b00); // Set direction first else get rogue pulses
     setOutputPins(_direction ? 0b11 : 0b01); // step HIGH
@@ -393,6 +1258,34 @@ void AccelStepper::step1(long step)
 }
 
 
+#if ACCELSTEPPER_FAST_DRIVER
+void AccelStepper::endStepPulse(bool wait)
+{
+    if (!_pulsePending)
+	return;
+    // _lastStepTime was taken just before the pulse started, and micros() has
+    // a resolution of 4 microseconds on 16MHz processors
+    while (micros() - _lastStepTime < (unsigned long)_minPulseWidth + 4)
+    {
+	if (!wait)
+	    return;
+    }
+    uint8_t oldSREG = SREG;
+    cli();
+    if (_pinInverted[0])
+	*_stepPort |= _stepMask;
+    else
+	*_stepPort &= ~_stepMask;
+    SREG = oldSREG;
+    _pulsePending = false;
+}
+#else
+void AccelStepper::endStepPulse(bool wait)
+{
+    (void)(wait); // Unused
+}
+#endif
+
 // 2 pin step function
 // This is passed the current step number (0 to 7)
 // Subclasses can override
@@ -545,6 +1438,9 @@ void    AccelStepper::disableOutputs()
     if (! _interface) return;
 
     setOutputPins(0); // Handles inversion automatically
+#if ACCELSTEPPER_FAST_DRIVER
+    _pulsePending = false;
+#endif
     if (_enablePin != 0xff)
     {
         pinMode(_enablePin, OUTPUT);
@@ -636,6 +1532,51 @@ void AccelStepper::runToNewPosition(long position)
 
 void AccelStepper::stop()
 {
+#if ACCELSTEPPER_QUEUE_SIZE
+    clearQueue();
+#endif
+#if ACCELSTEPPER_RAMP_TABLE
+    if (_ramp)
+    {
+	// End the table early, mirroring it from the current entry as if the move were only that long
+	long k = _currentPos - _rampStart;
+	if (k < 0)
+	    k = -k;
+	long i = min(k - 1, _rampSteps - 1 - k);
+	i = constrain(i, 0, _rampLength - 1);
+	long steps = k + i + 1;
+	if (steps < _rampSteps)
+	{
+	    _rampSteps = steps;
+	    _targetPos = (_direction == DIRECTION_CW) ? _rampStart + steps : _rampStart - steps;
+	}
+	return;
+    }
+#endif
+#if ACCELSTEPPER_SCURVE
+    if (_jerk > 0.0)
+    {
+	if (_stepInterval)
+	{
+	    long stepsToStop = (long)sCurveStopSteps(_sSpeed, _sAccel, _jerk, _acceleration) + 1; // (+integer rounding)
+	    if (_direction == DIRECTION_CW)
+		move(stepsToStop);
+	    else
+		move(-stepsToStop);
+	}
+	return;
+    }
+#endif
+#if ACCELSTEPPER_INTEGER_PROFILE
+    if (_stepInterval)
+    {
+	long stepsToStop = ((_n > 0) ? _n - 1 : -_n) + 1; // Equation 16 (+integer rounding)
+	if (_direction == DIRECTION_CW)
+	    move(stepsToStop);
+	else
+	    move(-stepsToStop);
+    }
+#else
     if (_speed != 0.0)
     {    
 	long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)) + 1; // Equation 16 (+integer rounding)
@@ -644,9 +1585,14 @@ void AccelStepper::stop()
 	else
 	    move(-stepsToStop);
     }
+#endif
 }
 
 bool AccelStepper::isRunning()
 {
+#if ACCELSTEPPER_INTEGER_PROFILE
+    return !(_stepInterval == 0 && _targetPos == _currentPos);
+#else
     return !(_speed == 0.0 && _targetPos == _currentPos);
+#endif
 }
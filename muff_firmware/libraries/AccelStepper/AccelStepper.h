@@ -261,6 +261,60 @@
 // These defs cause trouble on some versions of Arduino
 #undef round
 
+/// Selects the arithmetic used by computeNewSpeed() for the acceleration profile.
+/// If 1 (the default), the step interval is kept as an unsigned Q24.8 fixed-point number of microseconds,
+/// Equation 13 is evaluated with a single integer division, and the number of steps needed to stop
+/// (Equation 16) is tracked in the step counter instead of being computed from the speed.
+/// No floating point is used after each step, which on 8-bit processors cuts the cost of a step update
+/// from several hundred microseconds to a few tens, and to almost nothing while cruising at max speed.
+/// If 0, uses the original floating point implementation.
+#ifndef ACCELSTEPPER_INTEGER_PROFILE
+#define ACCELSTEPPER_INTEGER_PROFILE 1
+#endif
+
+/// Selects a fast path for AccelStepper::DRIVER steppers on AVR processors.
+/// If 1 (the default on AVR), the Step and Direction pins are resolved to their PORTx register
+/// and bit mask once at construction, and step1() writes the port registers directly instead of
+/// calling digitalWrite(). The Step pulse is not timed with delayMicroseconds(): it is ended by
+/// the following call to run(), runSpeed() or runStep(), once the speed for the next step has been
+/// computed and at least the minimum pulse width has elapsed.
+/// Subclasses that override setOutputPins() to drive a DRIVER stepper some other way
+/// must set this to 0.
+#ifndef ACCELSTEPPER_FAST_DRIVER
+#if defined(__AVR__)
+#define ACCELSTEPPER_FAST_DRIVER 1
+#else
+#define ACCELSTEPPER_FAST_DRIVER 0
+#endif
+#endif
+
+/// Number of moves that can be queued behind the current one with queueMoveTo().
+/// When the next queued move goes the same way as the current one, the motor is not brought to
+/// a stop at the junction: the deceleration is planned so that it arrives there at the highest
+/// speed from which it can still stop at the end of the queue (a look-ahead planner).
+/// Each entry costs 16 bytes of RAM. If 0, the queue is compiled out.
+#ifndef ACCELSTEPPER_QUEUE_SIZE
+#define ACCELSTEPPER_QUEUE_SIZE 4
+#endif
+
+/// If 1 (the default), setJerk() can select a jerk-limited (S-curve) acceleration profile instead
+/// of the trapezoidal one: the acceleration is ramped up and down at a limited rate instead of being
+/// switched on and off at the start and end of each ramp, so the load is not jolted and settles
+/// sooner when the motor stops. The S-curve profile uses floating point after each step (a few
+/// hundred microseconds on 8-bit processors), so it suits moderate step rates.
+/// Costs 16 bytes of RAM. If 0, only the trapezoidal profile is available.
+#ifndef ACCELSTEPPER_SCURVE
+#define ACCELSTEPPER_SCURVE 1
+#endif
+
+/// If 1 (the default), a move that is repeated many times can have its step intervals computed once
+/// into a table with buildRampTable(), and then replayed from it with moveWithRamp(): each step then
+/// costs a table lookup instead of a speed calculation, and every repetition has exactly the same timing.
+/// If 0, ramp tables are compiled out.
+#ifndef ACCELSTEPPER_RAMP_TABLE
+#define ACCELSTEPPER_RAMP_TABLE 1
+#endif
+
 /////////////////////////////////////////////////////////////////////
 /// \class AccelStepper AccelStepper.h <AccelStepper.h>
 /// \brief Support for stepper motors with acceleration etc.
@@ -302,6 +356,9 @@
 /// whenever required for the speed set.
 /// Calling setAcceleration() is expensive,
 /// since it requires a square root to be calculated.
+/// With ACCELSTEPPER_INTEGER_PROFILE (the default) the per-step speed calculations
+/// use only integer arithmetic; floating point is used only in setAcceleration(),
+/// setMaxSpeed(), setSpeed() and speed().
 ///
 /// Gregor Christandl reports that with an Arduino Due and a simple test program, 
 /// he measured 43163 steps per second using runSpeed(), 
@@ -378,6 +435,68 @@ public:
     /// anticlockwise from the current position.
     void    move(long relative);
 
+#if ACCELSTEPPER_QUEUE_SIZE
+    /// Queues a move to a new absolute position, to be started as soon as the current target
+    /// (and any moves queued before this one) has been reached, with the given max speed.
+    /// If the motor is stopped and nothing is queued, this is the same as setMaxSpeed() then moveTo().
+    /// If the new move goes the same way as the one before it, the motor passes through the
+    /// junction without stopping, at a speed no higher than either max speed allows and low enough to
+    /// stop at the end of the queue. If it reverses, the motor comes to a stop first.
+    /// The acceleration in effect when the move is queued is used to plan it.
+    /// moveTo(), move(), stop() and setCurrentPosition() discard the queue.
+    /// \param[in] absolute The desired absolute position.
+    /// \param[in] speed The max speed for this move, in steps per second.
+    /// \return false if the queue is full and the move was not queued.
+    boolean queueMoveTo(long absolute, float speed);
+
+    /// \return the number of moves waiting in the queue, not counting the current one.
+    uint8_t queuedMoves();
+
+    /// Discards all queued moves. The current target is kept, and the motor will decelerate to stop there.
+    void    clearQueue();
+#endif
+
+#if ACCELSTEPPER_RAMP_TABLE
+    /// Computes the step intervals of a move of distance steps from rest, with the given max speed
+    /// and the current acceleration and profile (see setJerk()), and stores them in table for moveWithRamp().
+    /// The deceleration is replayed as the mirror image of the acceleration, so only the first half
+    /// of the move (or up to the end of the acceleration, if it reaches max speed) is stored.
+    /// Does not change the state of the motor.
+    /// \param[in] distance The length of the move in steps. Only its absolute value matters.
+    /// \param[in] speed The max speed of the move, in steps per second.
+    /// \param[out] table Where to store the intervals, in microseconds.
+    /// \param[in] size The number of entries available in table.
+    /// \return The number of entries used, or 0 if the move does not fit in size entries or
+    /// has intervals too long for 16 bits.
+    uint8_t buildRampTable(long distance, float speed, uint16_t *table, uint8_t size);
+
+    /// Starts a move relative to the current position, like move(), but with the step intervals
+    /// taken from a table built by buildRampTable() for the same distance. The table must stay
+    /// valid until the move ends. stop() ends it early with the same (mirrored) deceleration;
+    /// moveTo(), move() and setCurrentPosition() abandon it.
+    /// The motor should be stopped when this is called.
+    /// \param[in] relative The distance and direction of the move, in steps.
+    /// \param[in] table The table filled by buildRampTable().
+    /// \param[in] length The number of entries returned by buildRampTable().
+    void    moveWithRamp(long relative, const uint16_t *table, uint8_t length);
+#endif
+
+    /// Computes how long a move of distance steps from rest to rest would take, from the first step
+    /// to the last, with the given max speed, acceleration and jerk, without running it. It adds up
+    /// the step intervals that computeNewSpeed() would give, by running the same recurrence
+    /// (Equation 13, or the S-curve if jerk is non-zero) on local variables, so the result is the
+    /// exact sum of the intervals the motor would be given, as long as they are not stretched by
+    /// late calls to run(). The cruise at max speed is added up in one go, so the cost is that of
+    /// the steps in the ramps. Ramp tables (see moveWithRamp()) and queued moves are not considered.
+    /// Does not change the state of the motor, and may be called while it runs.
+    /// \param[in] distance The length of the move in steps. Only its absolute value matters.
+    /// \param[in] speed The max speed of the move, in steps per second.
+    /// \param[in] acceleration The acceleration of the move, in steps per second per second.
+    /// \param[in] jerk The jerk of the move, in steps per second^3, or 0 for the trapezoidal profile.
+    /// Ignored unless ACCELSTEPPER_SCURVE is enabled.
+    /// \return The duration of the move in microseconds, or 0 if it has 1 step or none.
+    unsigned long moveDuration(long distance, float speed, float acceleration, float jerk = 0.0) const;
+
     /// Poll the motor and step it if a step is due, implementing
     /// accelerations and decelerations to acheive the target position. You must call this as
     /// frequently as possible, but at least once per minimum step time interval,
@@ -392,6 +511,22 @@ public:
     /// \return true if the motor was stepped.
     boolean runSpeed();
 
+    /// Steps the motor once, unconditionally, and computes the speed for the next step,
+    /// implementing accelerations and decelerations to acheive the target position.
+    /// This is intended to be called from a timer interrupt handler that is
+    /// reprogrammed after each step with the returned interval, instead of polling run()
+    /// from the main loop. Unlike run(), it does not check micros() to decide if a step is due:
+    /// the caller is responsible for calling it at the right time.
+    /// If the motor is stopped (step interval is 0) it does nothing.
+    /// \return the interval in microseconds until the next step is due,
+    /// or 0 if the motor has stopped at the target position.
+    unsigned long runStep();
+
+    /// The current interval between steps.
+    /// \return the interval in microseconds between the most recent step and the next one,
+    /// or 0 if the motor is stopped.
+    unsigned long stepInterval();
+
     /// Sets the maximum permitted speed. The run() function will accelerate
     /// up to the speed set by this function.
     /// Caution: the maximum speed achievable depends on your processor and clock speed.
@@ -411,6 +546,32 @@ public:
     /// root to be calculated. Dont call more ofthen than needed
     void    setAcceleration(float acceleration);
 
+    /// returns the acceleration/deceleration rate configured for this stepper
+    /// that was previously set by setAcceleration();
+    /// \return The currently configured acceleration/deceleration
+    float   acceleration();
+
+#if ACCELSTEPPER_SCURVE
+    /// Selects the acceleration profile used by run() and runStep().
+    /// If jerk is 0 (the default), the speed follows the usual trapezoidal profile. Otherwise
+    /// the acceleration itself changes at no more than jerk steps per second per second per second,
+    /// up to the limit set by setAcceleration(), and the speed follows an S-curve: it starts,
+    /// levels off at maxSpeed and comes to a stop smoothly. Moves take a little longer, roughly
+    /// acceleration()/jerk seconds per ramp, but end without a jolt.
+    /// Best called while the motor is stopped.
+    /// \param[in] jerk The max rate of change of the acceleration, in steps per second^3, or 0.
+    void    setJerk(float jerk);
+
+    /// \return The jerk set by setJerk(), or 0 if the trapezoidal profile is in use
+    float   jerk();
+
+    /// Returns the number of steps it takes to stop with the S-curve profile, from speed v
+    /// (steps per second, >= 0) and acceleration a (steps per second^2, positive if speeding up),
+    /// with jerk j and max acceleration acceleration. By symmetry, sCurveStopSteps(v, 0, j, acceleration)
+    /// is also the number of steps it takes to reach the speed v from a standstill.
+    static float   sCurveStopSteps(float v, float a, float j, float acceleration);
+#endif
+
     /// Sets the desired constant speed for use with runSpeed().
     /// \param[in] speed The desired constant speed in steps per
     /// second. Positive is clockwise. Speeds of more than 1000 steps per
@@ -420,6 +581,8 @@ public:
     void    setSpeed(float speed);
 
     /// The most recently set speed
+    /// With ACCELSTEPPER_INTEGER_PROFILE, the speed is derived from the current step interval,
+    /// so it is exact only to within the 1 microsecond resolution of the interval.
     /// \return the most recent speed in steps per second
     float   speed();
 
@@ -484,6 +647,8 @@ public:
     /// Sets the minimum pulse width allowed by the stepper driver. The minimum practical pulse width is 
     /// approximately 20 microseconds. Times less than 20 microseconds
     /// will usually result in 20 microseconds or so.
+    /// With ACCELSTEPPER_FAST_DRIVER, DRIVER Step pulses can be as short as a few microseconds,
+    /// and are held for at least minWidth plus the resolution of micros().
     /// \param[in] minWidth The minimum pulse width in microseconds. 
     void    setMinPulseWidth(unsigned int minWidth);
 
@@ -516,6 +681,9 @@ public:
 
 protected:
 
+    /// MultiStepper drives the following steppers of an accelerated move step by step
+    friend class MultiStepper;
+
     /// \brief Direction indicator
     /// Symbolic names for the direction the motor is turning
     typedef enum
@@ -534,6 +702,23 @@ protected:
     /// move() or moveTo()
     void           computeNewSpeed();
 
+#if ACCELSTEPPER_SCURVE
+    /// The S-curve version of computeNewSpeed(), used when setJerk() has set a non-zero jerk.
+    void           computeNewSpeedSCurve();
+#endif
+
+    /// Runs the recurrence of computeNewSpeed() for a move of distance steps from rest, on local
+    /// variables, and returns its duration (see moveDuration()). If table is not NULL, also stores
+    /// the intervals of the first half of the move in table, as buildRampTable() does, setting
+    /// *length to the number of entries used (0 if they do not fit in size), and stops there.
+    unsigned long replayMove(long distance, float speed, float acceleration, float jerk,
+			     uint16_t *table, uint8_t size, uint8_t *length) const;
+
+#if ACCELSTEPPER_RAMP_TABLE
+    /// The version of computeNewSpeed() used while replaying a table given to moveWithRamp().
+    void           computeNewSpeedRamp();
+#endif
+
     /// Low level function to set the motor output pins
     /// bit 0 of the mask corresponds to _pin[0]
     /// bit 1 of the mask corresponds to _pin[1]
@@ -561,6 +746,12 @@ protected:
     /// \param[in] step The current step phase number (0 to 7)
     virtual void   step1(long step);
 
+    /// Ends the Step pulse started by step1() on the ACCELSTEPPER_FAST_DRIVER path,
+    /// if there is one and it has lasted at least the minimum pulse width.
+    /// \param[in] wait If true, waits for the rest of the minimum pulse width
+    /// if it has not elapsed yet, so that the pulse is always ended on return.
+    void           endStepPulse(bool wait);
+
     /// Called to execute a step on a 2 pin motor. Only called when a new step is
     /// required. Subclasses may override to implement new stepping
     /// interfaces. The default sets or clears the outputs of pin1 and pin2
@@ -598,6 +789,21 @@ protected:
     /// Current direction motor is spinning in
     /// Protected because some peoples subclasses need it to be so
     boolean _direction; // 1 == CW
+
+    /// The current absolution position in steps.
+    /// Protected, with the step timing members below, so that subclasses
+    /// such as FastStepper can implement their own runSpeed()
+    long           _currentPos;    // Steps
+
+    /// The current interval between steps in microseconds.
+    /// 0 means the motor is currently stopped with _speed == 0
+    unsigned long  _stepInterval;
+
+    /// The last step time in microseconds
+    unsigned long  _lastStepTime;
+
+    /// The minimum allowed pulse width in microseconds
+    unsigned int   _minPulseWidth;
     
 private:
     /// Number of pins on the stepper motor. Permits 2 or 4. 2 pins is a
@@ -611,9 +817,6 @@ private:
     /// Whether the _pins is inverted or not
     uint8_t        _pinInverted[4];
 
-    /// The current absolution position in steps.
-    long           _currentPos;    // Steps
-
     /// The target position in steps. The AccelStepper library will move the
     /// motor from the _currentPos to the _targetPos, taking into account the
     /// max speed, acceleration and deceleration
@@ -631,15 +834,6 @@ private:
     float          _acceleration;
     float          _sqrt_twoa; // Precomputed sqrt(2*_acceleration)
 
-    /// The current interval between steps in microseconds.
-    /// 0 means the motor is currently stopped with _speed == 0
-    unsigned long  _stepInterval;
-
-    /// The last step time in microseconds
-    unsigned long  _lastStepTime;
-
-    /// The minimum allowed pulse width in microseconds
-    unsigned int   _minPulseWidth;
 
     /// Is the direction pin inverted?
     ///bool           _dirInverted; /// Moved to _pinInverted[1]
@@ -671,6 +865,93 @@ private:
     /// Min step size in microseconds based on maxSpeed
     float _cmin; // at max speed
 
+#if ACCELSTEPPER_INTEGER_PROFILE
+    /// Initial step size in 1/256 microseconds (Q24.8)
+    unsigned long _c0Fixed;
+
+    /// Last step size in 1/256 microseconds (Q24.8)
+    unsigned long _cnFixed;
+
+    /// Min step size in 1/256 microseconds (Q24.8) based on maxSpeed
+    unsigned long _cminFixed;
+#endif
+
+#if ACCELSTEPPER_FAST_DRIVER
+    /// Output register of the Step pin of a DRIVER stepper, or NULL if the fast path is not used
+    volatile uint8_t *_stepPort;
+
+    /// Output register of the Direction pin of a DRIVER stepper
+    volatile uint8_t *_dirPort;
+
+    /// Bit masks of the Step and Direction pins in their output registers
+    uint8_t        _stepMask;
+    uint8_t        _dirMask;
+
+    /// True if the Step pin is still active after a step
+    bool           _pulsePending;
+#endif
+
+#if ACCELSTEPPER_SCURVE
+    /// Max rate of change of the acceleration in steps per second^3, 0 for the trapezoidal profile
+    float          _jerk;
+
+    /// Current speed (>= 0, in the current direction) and acceleration of the S-curve profile
+    float          _sSpeed;
+    float          _sAccel;
+
+    /// Speed of the first step from rest with the S-curve profile (steps per second)
+    float          _sMinSpeed;
+#endif
+
+#if ACCELSTEPPER_RAMP_TABLE
+    /// Table of step intervals being replayed, or NULL
+    const uint16_t *_ramp;
+
+    /// Number of entries in _ramp
+    uint8_t        _rampLength;
+
+    /// Position at the start of the replayed move, and its length in steps
+    long           _rampStart;
+    long           _rampSteps;
+#endif
+
+#if ACCELSTEPPER_QUEUE_SIZE
+    /// A move waiting in the queue, with its speed limits precomputed
+    typedef struct
+    {
+	long          target;    ///< Absolute target position in steps
+	float         maxSpeed;  ///< Max speed in steps per second
+	long          maxSteps;  ///< Steps needed to stop from maxSpeed (Equation 16)
+#if ACCELSTEPPER_INTEGER_PROFILE
+	unsigned long cminFixed; ///< Step size at maxSpeed in 1/256 microseconds
+#else
+	float         cmin;      ///< Step size at maxSpeed in microseconds
+#endif
+    } QueuedMove;
+
+    /// Ring buffer of queued moves
+    QueuedMove    _queue[ACCELSTEPPER_QUEUE_SIZE];
+
+    /// Index of the next queued move in _queue
+    uint8_t       _queueHead;
+
+    /// Number of queued moves
+    uint8_t       _queueCount;
+
+    /// Steps needed to stop from the highest speed allowed when reaching _targetPos,
+    /// 0 if the motor must stop there
+    long          _junctionSteps;
+
+    /// Steps needed to stop from _maxSpeed (Equation 16)
+    long          _maxSteps;
+
+    /// Recomputes _junctionSteps with a backward pass over the queue
+    void          planJunctions();
+
+    /// Makes the next queued move the current one
+    void          nextQueuedMove();
+#endif
+
 };
 
 /// @example Random.pde
@@ -0,0 +1,243 @@
+// FastStepper.h
+
+#ifndef FastStepper_h
+#define FastStepper_h
+
+#include <AccelStepper.h>
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__)
+#define FASTSTEPPER_PORT_IO 1
+#else
+#define FASTSTEPPER_PORT_IO 0
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class FastPin FastStepper.h <FastStepper.h>
+/// \brief Output pin with its port and bit resolved at compile time
+///
+/// On the ATmega168/328 (Arduino Uno, Nano, Pro Mini) digital pins 0 to 7 are PORTD,
+/// 8 to 13 are PORTB and 14 to 19 (A0 to A5) are PORTC. Since Pin is a constant, each
+/// method compiles to a single sbi or cbi instruction, which is also atomic with respect
+/// to interrupts. On other processors it falls back to pinMode() and digitalWrite().
+template <uint8_t Pin>
+class FastPin
+{
+public:
+    /// Sets the pin to OUTPUT mode
+    static inline void output()
+    {
+#if FASTSTEPPER_PORT_IO
+	if (Pin < 8)       DDRD |= (1 << Pin);
+	else if (Pin < 14) DDRB |= (1 << (Pin - 8));
+	else               DDRC |= (1 << (Pin - 14));
+#else
+	pinMode(Pin, OUTPUT);
+#endif
+    }
+
+    /// Sets the pin HIGH
+    static inline void high()
+    {
+#if FASTSTEPPER_PORT_IO
+	if (Pin < 8)       PORTD |= (1 << Pin);
+	else if (Pin < 14) PORTB |= (1 << (Pin - 8));
+	else               PORTC |= (1 << (Pin - 14));
+#else
+	digitalWrite(Pin, HIGH);
+#endif
+    }
+
+    /// Sets the pin LOW
+    static inline void low()
+    {
+#if FASTSTEPPER_PORT_IO
+	if (Pin < 8)       PORTD &= ~(1 << Pin);
+	else if (Pin < 14) PORTB &= ~(1 << (Pin - 8));
+	else               PORTC &= ~(1 << (Pin - 14));
+#else
+	digitalWrite(Pin, LOW);
+#endif
+    }
+
+    /// Sets the pin to the given level
+    static inline void write(bool level)
+    {
+	if (level)
+	    high();
+	else
+	    low();
+    }
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class FastStepper FastStepper.h <FastStepper.h>
+/// \brief AccelStepper for a fixed stepper driver configuration, resolved at compile time
+///
+/// For applications with a single, fixed AccelStepper::DRIVER stepper (Step and Direction
+/// pins, optional Enable pin), FastStepper fixes the pins and their inversion as template
+/// parameters. The acceleration profile, positioning and all other methods are inherited from
+/// AccelStepper, so moveTo(), move(), stop(), setMaxSpeed() etc work as usual.
+///
+/// run(), runSpeed() and runStep() are reimplemented (hiding, not overriding, the AccelStepper
+/// versions), and drive the pins with single instructions: there is no virtual step() call,
+/// no switch on the interface type, no pin arrays and no runtime inversion checks on the hot path.
+/// They must therefore be called on a FastStepper (not through a pointer or reference to
+/// AccelStepper) to get this benefit. Code that does use the AccelStepper versions still works,
+/// through the step() override.
+///
+/// As with the ACCELSTEPPER_FAST_DRIVER path of AccelStepper, the Step pulse is not timed with
+/// delayMicroseconds(): it is ended by the next call to run(), runSpeed() or runStep()
+/// once the minimum pulse width set by setMinPulseWidth() has elapsed.
+///
+/// The constructor does not touch the pins; call enableOutputs() once the processor is initialised.
+/// The Enable pin (if any) is managed by enableOutputs() and disableOutputs(); do not call setEnablePin()
+/// or setPinsInverted() on a FastStepper.
+///
+/// \param Interface Must be AccelStepper::DRIVER
+/// \param StepPin Arduino digital pin number of the Step input to the driver
+/// \param DirPin Arduino digital pin number of the Direction input to the driver
+/// \param EnablePin Arduino digital pin number of the Enable input to the driver, or 0xff if none
+/// \param DirInvert True for inverted direction pin
+/// \param StepInvert True for inverted step pin
+/// \param EnableInvert True for inverted enable pin (ie enabled when LOW)
+template <uint8_t Interface, uint8_t StepPin, uint8_t DirPin, uint8_t EnablePin = 0xff,
+	  bool DirInvert = false, bool StepInvert = false, bool EnableInvert = false>
+class FastStepper : public AccelStepper
+{
+    static_assert(Interface == AccelStepper::DRIVER, "FastStepper only supports AccelStepper::DRIVER");
+
+public:
+    /// Constructor. The pins are not initialised: call enableOutputs() before stepping.
+    FastStepper()
+	: AccelStepper(AccelStepper::DRIVER, StepPin, DirPin, 0xff, 0xff, false),
+	  _pulsePending(false),
+	  _dirLevel(false)
+    {
+    }
+
+    /// Same as AccelStepper::run(), with the step pulse generated inline
+    /// \return true if the motor is still running to the target position.
+    inline boolean run()
+    {
+	if (runSpeed())
+	{
+	    computeNewSpeed();
+	    endStepPulse(false);
+	}
+	return isRunning();
+    }
+
+    /// Same as AccelStepper::runSpeed(), with the step pulse generated inline
+    /// \return true if the motor was stepped.
+    inline boolean runSpeed()
+    {
+	endStepPulse(false);
+	if (!_stepInterval)
+	    return false;
+	unsigned long time = micros();
+	if (time - _lastStepTime >= _stepInterval)
+	{
+	    _currentPos += _direction ? 1 : -1;
+	    pulse();
+	    _lastStepTime = time;
+	    return true;
+	}
+	return false;
+    }
+
+    /// Same as AccelStepper::runStep(), with the step pulse generated inline
+    /// \return the interval in microseconds until the next step is due,
+    /// or 0 if the motor has stopped at the target position.
+    inline unsigned long runStep()
+    {
+	if (!_stepInterval)
+	    return 0;
+	_currentPos += _direction ? 1 : -1;
+	pulse();
+	_lastStepTime = micros();
+	computeNewSpeed();
+	endStepPulse(true);
+	return _stepInterval;
+    }
+
+    /// Sets the Step and Direction pins (and Enable, if any) to OUTPUT mode, and enables the driver
+    virtual void enableOutputs()
+    {
+	FastPin<StepPin>::output();
+	FastPin<DirPin>::output();
+	FastPin<DirPin>::write(_dirLevel);
+	if (EnablePin != 0xff)
+	{
+	    FastPin<EnablePin>::output();
+	    FastPin<EnablePin>::write(!EnableInvert);
+	}
+    }
+
+    /// Sets the Step and Direction pins inactive, and disables the driver if there is an Enable pin
+    virtual void disableOutputs()
+    {
+	FastPin<StepPin>::write(StepInvert);
+	FastPin<DirPin>::write(DirInvert);
+	_dirLevel = DirInvert;
+	_pulsePending = false;
+	if (EnablePin != 0xff)
+	{
+	    FastPin<EnablePin>::output();
+	    FastPin<EnablePin>::write(EnableInvert);
+	}
+    }
+
+protected:
+    /// Called by the AccelStepper versions of runSpeed() and runStep()
+    virtual void step(long step)
+    {
+	(void)(step); // Unused
+	pulse();
+    }
+
+    /// Starts a step pulse in the current direction
+    inline void pulse()
+    {
+	if (_pulsePending)
+	{
+	    // Nothing polled the stepper since the last step: the pin must be inactive for a while too
+	    endStepPulse(true);
+	    delayMicroseconds(_minPulseWidth);
+	}
+	bool dir = _direction ^ DirInvert;
+	if (dir != _dirLevel)
+	{
+	    // Set direction first else get rogue pulses
+	    FastPin<DirPin>::write(dir);
+	    _dirLevel = dir;
+	    delayMicroseconds(1); // Caution 200ns (3967) or 650ns (DRV8825) setup time
+	}
+	FastPin<StepPin>::write(!StepInvert);
+	_pulsePending = true;
+    }
+
+    /// Ends the step pulse once the minimum pulse width has elapsed
+    /// \param[in] wait If true, waits for the rest of the minimum pulse width if needed
+    inline void endStepPulse(bool wait)
+    {
+	if (!_pulsePending)
+	    return;
+	// micros() has a resolution of 4 microseconds on 16MHz processors
+	while (micros() - _lastStepTime < (unsigned long)_minPulseWidth + 4)
+	{
+	    if (!wait)
+		return;
+	}
+	FastPin<StepPin>::write(StepInvert);
+	_pulsePending = false;
+    }
+
+private:
+    /// True if the Step pin is still active after a step
+    bool _pulsePending;
+
+    /// Current level of the Direction pin
+    bool _dirLevel;
+};
+
+#endif
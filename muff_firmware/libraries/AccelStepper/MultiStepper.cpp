@@ -9,6 +9,9 @@
 MultiStepper::MultiStepper()
     : _num_steppers(0)
 {
+#if MULTISTEPPER_ACCELERATION
+    _leader = -1;
+#endif
 }
 
 boolean MultiStepper::addStepper(AccelStepper& stepper)
@@ -21,6 +24,10 @@ boolean MultiStepper::addStepper(AccelStepper& stepper)
 
 void MultiStepper::moveTo(long absolute[])
 {
+#if MULTISTEPPER_ACCELERATION
+    if (_leader >= 0)
+	finish();
+#endif
     // First find the stepper that will take the longest time to move
     float longestTime = 0.0;
 
@@ -48,10 +55,114 @@ void MultiStepper::moveTo(long absolute[])
     }
 }
 
+#if MULTISTEPPER_ACCELERATION
+void MultiStepper::moveToAccelerated(long absolute[])
+{
+    if (_leader >= 0)
+	finish();
+
+    // The stepper with the longest move leads, so the others take at most one step per step of it
+    uint8_t i;
+    _leaderSteps = 0;
+    for (i = 0; i < _num_steppers; i++)
+    {
+	_delta[i] = absolute[i] - _steppers[i]->currentPosition();
+	if (labs(_delta[i]) > _leaderSteps)
+	{
+	    _leaderSteps = labs(_delta[i]);
+	    _leader = i;
+	}
+    }
+    if (_leader < 0)
+	return; // Nothing to move
+
+    // Limit the speed and acceleration of the leader so that no follower exceeds its own
+    AccelStepper* leader = _steppers[_leader];
+    _leaderMaxSpeed = leader->maxSpeed();
+    _leaderAcceleration = leader->acceleration();
+    float maxSpeed = _leaderMaxSpeed;
+    float acceleration = _leaderAcceleration;
+    for (i = 0; i < _num_steppers; i++)
+    {
+	if (i == _leader || _delta[i] == 0)
+	    continue;
+	AccelStepper* follower = _steppers[i];
+	float ratio = (float)_leaderSteps / labs(_delta[i]);
+	if (follower->maxSpeed() * ratio < maxSpeed)
+	    maxSpeed = follower->maxSpeed() * ratio;
+	if (follower->acceleration() > 0.0 && (acceleration == 0.0 || follower->acceleration() * ratio < acceleration))
+	    acceleration = follower->acceleration() * ratio;
+	// Followers are stepped directly by follow(), not by their own run()
+	follower->_targetPos = absolute[i];
+	follower->_direction = (_delta[i] > 0) ? AccelStepper::DIRECTION_CW : AccelStepper::DIRECTION_CCW;
+	_error[i] = _leaderSteps / 2;
+    }
+    leader->setMaxSpeed(maxSpeed);
+    leader->setAcceleration(acceleration);
+    leader->moveTo(absolute[_leader]);
+}
+
+void MultiStepper::stop()
+{
+    // The followers keep in proportion with the leader while it decelerates
+    if (_leader >= 0)
+	_steppers[_leader]->stop();
+}
+
+void MultiStepper::follow(uint8_t i)
+{
+    if (_delta[i] == 0)
+	return;
+    _error[i] += labs(_delta[i]);
+    if (_error[i] < _leaderSteps)
+	return;
+    _error[i] -= _leaderSteps;
+    AccelStepper* follower = _steppers[i];
+    follower->_lastStepTime = micros();
+    follower->_currentPos += (_delta[i] > 0) ? 1 : -1;
+    follower->step(follower->_currentPos);
+}
+
+void MultiStepper::finish()
+{
+    uint8_t i;
+    for (i = 0; i < _num_steppers; i++)
+    {
+	if (i == _leader)
+	    continue;
+	_steppers[i]->endStepPulse(true);
+	_steppers[i]->_targetPos = _steppers[i]->_currentPos;
+    }
+    _steppers[_leader]->setMaxSpeed(_leaderMaxSpeed);
+    _steppers[_leader]->setAcceleration(_leaderAcceleration);
+    _leader = -1;
+}
+#endif
+
 // Returns true if any motor is still running to the target position.
 boolean MultiStepper::run()
 {
     uint8_t i;
+#if MULTISTEPPER_ACCELERATION
+    if (_leader >= 0)
+    {
+	AccelStepper* leader = _steppers[_leader];
+	long before = leader->currentPosition();
+	boolean running = leader->run();
+	boolean stepped = leader->currentPosition() != before;
+	for (i = 0; i < _num_steppers; i++)
+	{
+	    if (i == _leader)
+		continue;
+	    _steppers[i]->endStepPulse(false);
+	    if (stepped)
+		follow(i);
+	}
+	if (!running)
+	    finish();
+	return running;
+    }
+#endif
     boolean ret = false;
     for (i = 0; i < _num_steppers; i++)
     {
@@ -13,6 +13,15 @@
 
 #define MULTISTEPPER_MAX_STEPPERS 10
 
+/// If 1 (the default), moveToAccelerated() can move all the managed steppers with a shared
+/// acceleration-limited profile. The extra arrays are sized by MULTISTEPPER_MAX_STEPPERS, so
+/// this costs a fixed 8 * MULTISTEPPER_MAX_STEPPERS + 13 bytes of RAM per MultiStepper object
+/// (93 bytes on AVR with the default limit of 10), however many steppers it actually manages.
+/// If 0, only constant speed motion is available.
+#ifndef MULTISTEPPER_ACCELERATION
+#define MULTISTEPPER_ACCELERATION 1
+#endif
+
 class AccelStepper;
 
 /////////////////////////////////////////////////////////////////////
@@ -27,9 +36,15 @@ class AccelStepper;
 /// 3D printers etc
 /// to get linear straight line movement between arbitrary 2d (or 3d or ...) positions.
 ///
-/// Caution: only constant speed stepper motion is supported: acceleration and deceleration is not supported
+/// With moveTo(), only constant speed stepper motion is supported: acceleration and deceleration is not supported
 /// All the steppers managed by MultiStepper will step at a constant speed to their
 /// target (albeit perhaps different speeds for each stepper).
+///
+/// With moveToAccelerated(), the stepper with the longest move follows its own acceleration profile
+/// (see AccelStepper::run()), and the others take their steps in proportion to it (Bresenham's
+/// line algorithm), so they all speed up and slow down together along the same time-scaled profile.
+/// The speed and acceleration of the leading stepper are reduced for the move so that no stepper
+/// exceeds its own maxSpeed() and acceleration().
 class MultiStepper
 {
 public:
@@ -50,9 +65,28 @@ public:
     /// the absolute position of the first stepper added by addStepper() etc. The array must be at least as long as 
     /// the number of steppers that have been added by addStepper, else results are undefined.
     void moveTo(long absolute[]);
+
+#if MULTISTEPPER_ACCELERATION
+    /// Set the target positions of all managed steppers 
+    /// according to a coordinate array, like moveTo(), but with acceleration and deceleration.
+    /// All the steppers start and arrive together, following the same profile scaled to
+    /// the length of their own moves, within the maxSpeed() and acceleration() of each one.
+    /// Steppers with zero acceleration() are taken to have no acceleration limit.
+    /// Call run() to implement the motion. The leading stepper's own maxSpeed() and acceleration()
+    /// are restored when the move ends.
+    /// \param[in] absolute An array of desired absolute stepper positions, as for moveTo().
+    void moveToAccelerated(long absolute[]);
+
+    /// Brings a move started by moveToAccelerated() to a stop as quickly as the profile allows,
+    /// keeping all the steppers synchronised. They stop short of their targets, at positions
+    /// that are still in proportion; the targets are then set to those positions.
+    void stop();
+#endif
     
     /// Calls runSpeed() on all the managed steppers
     /// that have not acheived their target position.
+    /// After moveToAccelerated(), calls run() on the leading stepper instead, and steps the
+    /// others as needed to stay in proportion with it.
     /// \return true if any stepper is still in the process of running to its target position.
     boolean run();
 
@@ -69,6 +103,33 @@ private:
     /// Number of steppers we are controlling and the number
     /// of steppers in _steppers[]
     uint8_t       _num_steppers;
+
+#if MULTISTEPPER_ACCELERATION
+    /// Steps the stepper with index i by one step in its direction, if the
+    /// leading stepper has moved far enough.
+    void          follow(uint8_t i);
+
+    /// Ends the accelerated move: restores the leading stepper and sets the targets
+    /// of the others to their current positions.
+    void          finish();
+
+    /// Index in _steppers[] of the stepper leading the accelerated move,
+    /// or -1 if there is no accelerated move in progress
+    int8_t        _leader;
+
+    /// Length of the move of the leading stepper, in steps (positive)
+    long          _leaderSteps;
+
+    /// Length and direction of the move of each stepper, in steps
+    long          _delta[MULTISTEPPER_MAX_STEPPERS];
+
+    /// Bresenham accumulator of each stepper
+    long          _error[MULTISTEPPER_MAX_STEPPERS];
+
+    /// maxSpeed() and acceleration() of the leading stepper before the move
+    float         _leaderMaxSpeed;
+    float         _leaderAcceleration;
+#endif
 };
 
 /// @example MultiStepper.pde
@@ -0,0 +1,81 @@
+/* See {muff_camera.h}. */
+
+#include "Arduino.h"
+#include <muff_utils.h>
+#include <muff_camera.h>
+
+// Estados do sinal de exposicao depois de um disparo:
+#define exposicao_nenhuma (0)    // Nenhum disparo pendente.
+#define exposicao_esperando (1)  // Disparou, exposicao ainda nao comecou.
+#define exposicao_expondo (2)    // Exposicao em andamento.
+#define exposicao_terminada (3)  // Exposicao terminou, ainda nao informada.
+
+static unsigned long largura_pulso_us = 0;
+  // Largura do pulso de disparo, ou 0 se desabilitado.
+
+static bool usa_exposicao = false;
+  // True se o sinal de exposicao deve ser observado.
+
+static volatile bool pulso_ativo = false;
+  // True se o pino de disparo estah em {HIGH}.
+
+static volatile unsigned long inicio_pulso = 0;
+  // Valor de {micros()} no inicio do ultimo pulso.
+
+static volatile int estado_exposicao = exposicao_nenhuma;
+  // Estado do sinal de exposicao desde o ultimo disparo.
+
+void inicializa_camera(void)
+  {
+    FastPin<camera_pino_disparo>::output();
+    FastPin<camera_pino_disparo>::low();
+    pinMode(camera_pino_exposicao, INPUT_PULLUP);
+    camera_configura(0, false);
+  }
+
+void camera_configura(unsigned long largura_us, bool usa_exp)
+  {
+    noInterrupts();
+    largura_pulso_us = largura_us;
+    usa_exposicao = usa_exp;
+    estado_exposicao = exposicao_nenhuma;
+    interrupts();
+  }
+
+bool camera_disparo_habilitado(void)
+  { return (largura_pulso_us != 0); }
+
+bool camera_usa_exposicao(void)
+  { return camera_disparo_habilitado() && usa_exposicao; }
+
+void camera_dispara(void)
+  {
+    if (largura_pulso_us == 0) { return; }
+    FastPin<camera_pino_disparo>::high();
+    inicio_pulso = micros();
+    pulso_ativo = true;
+    if (usa_exposicao) { estado_exposicao = exposicao_esperando; }
+  }
+
+void camera_avanca(void)
+  {
+    if (pulso_ativo)
+      { noInterrupts();
+        if (micros() - inicio_pulso >= largura_pulso_us)
+          { FastPin<camera_pino_disparo>::low();
+            pulso_ativo = false;
+          }
+        interrupts();
+      }
+    if (estado_exposicao == exposicao_esperando)
+      { if (digitalRead(camera_pino_exposicao) == LOW) { estado_exposicao = exposicao_expondo; } }
+    else if (estado_exposicao == exposicao_expondo)
+      { if (digitalRead(camera_pino_exposicao) == HIGH) { estado_exposicao = exposicao_terminada; } }
+  }
+
+bool camera_exposicao_terminou(void)
+  {
+    if (estado_exposicao != exposicao_terminada) { return false; }
+    estado_exposicao = exposicao_nenhuma;
+    return true;
+  }
@@ -0,0 +1,60 @@
+/* Camera trigger output for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_camera_H
+#define muff_camera_H
+
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// DISPARO DA CAMERA
+
+// A camera pode ser disparada por um pulso no pino {camera_pino_disparo}
+// (ativo em {HIGH}), em vez de pelo computador.  O pulso eh gerado 
+// pelo sequenciador (veja {muff_sequenciador.h}) quando o quadro estah
+// pronto, isto eh, depois que o motor parou, que os LEDs do quadro 
+// foram acesos, e que o tempo de estabilizacao do plano passou.
+//
+// Opcionalmente, a camera pode informar o fim da exposicao pelo pino
+// {camera_pino_exposicao} (com resistor de pull-up, ativo em {LOW} 
+// durante a exposicao, como as saidas "strobe" de coletor aberto).
+// Nesse caso o sequenciador passa ao quadro seguinte assim que a
+// exposicao termina, sem esperar pelo computador.
+//
+// O fim do pulso nao usa {delay}: eh feito por {camera_avanca},
+// que deve ser chamada a cada volta do loop principal.
+
+#define camera_pino_disparo (5)
+  // Pino de saida do pulso de disparo.
+
+#define camera_pino_exposicao (7)
+  // Pino de entrada do sinal de exposicao da camera.
+
+void inicializa_camera(void);
+  // Inicializa os pinos de disparo e exposicao.  O disparo
+  // comeca desabilitado.
+
+void camera_configura(unsigned long largura_us, bool usa_exposicao);
+  // Define a largura do pulso de disparo {largura_us} (microssegundos;
+  // 0 desabilita o disparo) e se o sinal de exposicao deve ser usado.
+
+bool camera_disparo_habilitado(void);
+  // Retorna true se a largura do pulso de disparo nao for zero.
+
+bool camera_usa_exposicao(void);
+  // Retorna true se o sinal de exposicao deve ser observado
+  // depois de cada disparo.
+
+void camera_dispara(void);
+  // Comeca um pulso de disparo, se habilitado.  Eh rapida o bastante 
+  // para ser chamada dentro de uma interrupcao.
+
+void camera_avanca(void);
+  // Termina o pulso de disparo, se jah durou o bastante, e observa 
+  // o sinal de exposicao.
+
+bool camera_exposicao_terminou(void);
+  // Retorna true uma unica vez depois que a exposicao iniciada pelo 
+  // ultimo disparo terminou.  Sempre retorna false se o sinal de 
+  // exposicao nao estiver sendo usado.
+
+#endif
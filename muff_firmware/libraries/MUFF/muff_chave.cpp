@@ -0,0 +1,147 @@
+/* See {muff_chave.h}. */
+
+#include "Arduino.h"
+#include <AccelStepper.h>
+#include <muff_utils.h>
+#include <muff_temporizador.h>
+#include <muff_chave.h>
+
+static muff_motor *motor_chave = NULL;
+  // Motor a parar quando a chave for acionada.
+
+static volatile bool parou = false;
+  // True se a chave parou o motor desde a ultima chamada de {chave_avanca}.
+
+typedef enum 
+  { busca_parada,     // Nenhuma busca em andamento.
+    busca_rapida,     // Aproximando-se da chave a {vel_rapida}.
+    busca_recuo,      // Recuando depois da aproximacao rapida.
+    busca_lenta,      // Aproximando-se da chave a {vel_lenta}.
+    busca_final       // Indo para a posicao {alvo}.
+  } muff_estado_busca_t;
+
+static muff_estado_busca_t estado = busca_parada;
+  // Fase corrente da busca da origem.
+
+static int vel_rapida, vel_lenta;
+static long alvo;
+  // Parametros da busca corrente.
+
+static void trava_motor(muff_motor *motor)
+  // Se o {motor} estiver indo no sentido positivo, para imediatamente.
+  // Deve ser chamada com as interrupcoes desabilitadas.
+  {
+    if (motor->distanceToGo() > 0)
+      { motor->setCurrentPosition(motor->currentPosition());
+        parou = true;
+      }
+  }
+
+#if defined(__AVR__)
+
+ISR(PCINT0_vect)
+  {
+    // O Timer1 pode estar no meio de um passo; entao a parada espera ele terminar:
+    if ((motor_chave != NULL) && chave_acionada()) { temporizador_executa(motor_chave, trava_motor); }
+  }
+
+#endif
+
+void inicializa_chave(muff_motor *motor)
+  {
+    motor_chave = motor;
+    pinMode(chave_pino, INPUT_PULLUP);
+#if defined(__AVR__)
+    noInterrupts();
+    *digitalPinToPCMSK(chave_pino) |= (1 << digitalPinToPCMSKbit(chave_pino));
+    PCIFR = (1 << digitalPinToPCICRbit(chave_pino));  // Descarta mudanca pendente.
+    PCICR |= (1 << digitalPinToPCICRbit(chave_pino));
+    interrupts();
+#endif
+  }
+
+bool chave_acionada(void)
+  { return (digitalRead(chave_pino) == LOW); }
+
+void chave_recua(muff_motor *motor, int max_vel)
+  {
+    muff_aviso(aviso_recuando_chave);
+    aciona_motor(motor, -chave_recuo, max_vel);
+  }
+
+static void termina_busca(int erro)
+  // Termina a busca da origem e avisa o computador.  Se {erro} 
+  // nao for 0, a busca falhou por esse motivo.  Nao usa {muff_erro},
+  // pois a falha nao eh do comando que estiver sendo executado.
+  {
+    if (erro != 0) { muff_mostra_erro(erro); }
+    estado = busca_parada;
+    Serial.write(busca_fim);
+  }
+
+static void avanca_busca(muff_motor *motor)
+  // Passa para a fase seguinte da busca, se o motor jah parou.
+  {
+    if (motor_em_movimento(motor)) { return; }
+    if (estado == busca_rapida)
+      { if (! chave_acionada()) { termina_busca(erro_chave_nao_encontrada); return; }
+        aciona_motor(motor, -chave_recuo, vel_rapida);
+        estado = busca_recuo;
+      }
+    else if (estado == busca_recuo)
+      { if (chave_acionada()) { termina_busca(erro_chave_nao_liberada); return; }
+        aciona_motor_micropassos(motor, 2*chave_recuo, vel_lenta);
+        estado = busca_lenta;
+      }
+    else if (estado == busca_lenta)
+      { if (! chave_acionada()) { termina_busca(erro_chave_nao_encontrada); return; }
+        define_posicao_motor(motor, 0);
+        muff_aviso(aviso_origem_chave);
+        aciona_motor_para(motor, alvo, vel_rapida);
+        estado = busca_final;
+      }
+    else if (estado == busca_final)
+      { termina_busca(0); }
+  }
+
+bool chave_avanca(muff_motor *motor)
+  {
+    if (chave_acionada()) 
+      { // Garante que o motor nao avanca sobre a chave, mesmo sem a interrupcao:
+        noInterrupts();
+        trava_motor(motor);
+        interrupts();
+      }
+    noInterrupts();
+    bool parou_agora = parou;
+    parou = false;
+    interrupts();
+    if (estado != busca_parada) { avanca_busca(motor); return false; }
+    if (parou_agora) { muff_mostra_erro(erro_chave_acionada); }
+    return parou_agora;
+  }
+
+bool busca_inicia(muff_motor *motor, int rapida, int lenta, long destino)
+  {
+    if ((rapida <= 0) || (lenta <= 0) || (destino > 0)) { return false; }
+    vel_rapida = rapida;
+    vel_lenta = lenta;
+    alvo = destino;
+    muff_aviso(aviso_procurando_chave);
+    if (chave_acionada())
+      { // Jah estah na chave: basta sair dela e voltar devagar.
+        aciona_motor(motor, -chave_recuo, vel_rapida);
+        estado = busca_recuo;
+      }
+    else
+      { aciona_motor(motor, chave_max_busca, vel_rapida);
+        estado = busca_rapida;
+      }
+    return true;
+  }
+
+bool busca_ativa(void)
+  { return (estado != busca_parada); }
+
+void busca_aborta(void)
+  { estado = busca_parada; }
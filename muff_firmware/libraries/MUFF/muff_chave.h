@@ -0,0 +1,73 @@
+/* Limit switch and homing for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_chave_H
+#define muff_chave_H
+
+#include <AccelStepper.h>
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// CHAVE DE FIM DE CURSO
+
+// A chave de fim de curso fica no alto do curso do carro: ela eh 
+// acionada (pino em {LOW}) quando o motor avanca demais no sentido 
+// positivo.  No ATmega328P a chave gera uma interrupcao de mudanca de 
+// pino, que para o motor imediatamente, sem rampa de desaceleracao, se
+// ele estiver indo no sentido positivo.  Em outras plataformas o pino
+// eh examinado a cada chamada de {chave_avanca}.  Enquanto a chave 
+// estiver acionada, o motor so pode se mover no sentido negativo.
+
+#define chave_pino (leds_usa_spi ? 12 : 10)
+  // Numero do pino da chave (o 10 eh o SS do SPI; veja {leds_usa_spi}).
+  // Ambos ficam na porta B, cujas mudancas geram a interrupcao {PCINT0}.
+
+#define chave_recuo (320L*motor1_micropassos)
+  // Micropassos a recuar depois que a chave eh acionada (2 mm).
+
+#define chave_max_busca (32000L*motor1_micropassos)
+  // Maximo de micropassos a percorrer procurando a chave (200 mm).
+
+void inicializa_chave(muff_motor *motor);
+  // Configura o pino da chave como entrada com "pull-up" e, se 
+  // possivel, liga a interrupcao que para o {motor}.  Deve ser chamada
+  // depois que o {motor} estiver inicializado.
+
+bool chave_acionada(void);
+  // Retorna true se a chave estiver acionada.
+
+bool chave_avanca(muff_motor *motor);
+  // Deve ser chamada a cada volta do loop principal.  Para o motor se
+  // a chave estiver acionada e ele estiver indo no sentido positivo, e
+  // executa a busca da origem (veja {busca_inicia}), se houver.  
+  // Retorna true se a chave parou o motor fora de uma busca, desde a
+  // chamada anterior; quem chamou deve entao abortar o que estiver
+  // fazendo e chamar {chave_recua}.
+
+void chave_recua(muff_motor *motor, int max_vel);
+  // Inicia o movimento do {motor} {chave_recuo} passos no sentido
+  // negativo, com velocidade maxima {max_vel}, para liberar a chave. 
+  // Nao espera terminar.
+
+// -----------------------------------------------------------
+// BUSCA DA ORIGEM
+
+// A busca aproxima o carro da chave a {vel_rapida}, recua {chave_recuo}
+// micropassos, aproxima de novo a {vel_lenta} (em micropassos), e define a posicao em que a 
+// chave eh acionada como sendo zero.  Depois leva o carro para a posicao
+// absoluta {alvo} (que deve ser negativa) e envia o aviso {busca_fim}.
+// Os movimentos sao feitos pelo loop principal, em {chave_avanca}; 
+// o firmware continua atendendo comandos enquanto isso.
+
+#define busca_fim 'H'
+  // Aviso enviado ao computador no fim da busca, com ou sem sucesso.
+
+bool busca_inicia(muff_motor *motor, int vel_rapida, int vel_lenta, long alvo);
+  // Inicia a busca da origem. Retorna false se os parametros forem invalidos.
+
+bool busca_ativa(void);
+  // Retorna true se uma busca da origem estiver em andamento.
+
+void busca_aborta(void);
+  // Abandona a busca da origem em andamento, se houver. Nao para o motor.
+
+#endif
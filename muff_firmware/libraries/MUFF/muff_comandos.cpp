@@ -6,149 +6,597 @@
 #include <AccelStepper.h>
 #include <muff_utils.h>
 #include <muff_comandos.h>
+#include <muff_protocolo.h>
+#include <muff_chave.h>
+#include <muff_camera.h>
+#include <muff_varredura.h>
+#include <muff_padroes.h>
+#include <muff_telemetria.h>
+#include <muff_perfil.h>
 
-void comando_aciona_motor(AccelStepper *motor, int desloc, int max_vel, bool completa)
+void inicializa_comando(muff_comando_t *cmd, int codigo)
   {
-    // Se o motor estiver em movimento, interrompe:
-    para_motor(motor);
+    cmd->codigo = codigo;
+    cmd->nargs = 0;
+    cmd->ok = true;
+    cmd->seq = -1;
+    cmd->respondido = false;
+    cmd->adia_fim = false;
+    cmd->difusao = false;
+  }
+
+void inicializa_leitor(muff_leitor_t *leitor, muff_formato_args_t *formato_args)
+  {
+    leitor->formato_args = formato_args;
+    leitor->formato = NULL;
+    leitor->pos = 0;
+    leitor->negativo = false;
+    inicializa_comando(&(leitor->cmd), 0);
+  }
+
+static void termina_argumento(muff_leitor_t *leitor)
+  // Fecha o argumento corrente de {leitor->cmd}, aplicando o sinal.
+  {
+    muff_comando_t *cmd = &(leitor->cmd);
+    if (leitor->negativo) { cmd->arg[cmd->nargs] = - cmd->arg[cmd->nargs]; }
+    cmd->nargs++;
+    leitor->negativo = false;
+  }
+
+static int valor_digito(int byte, int base)
+  // Retorna o valor do digito {byte} na {base} (10 ou 16), ou -1 se invalido.
+  {
+    int v = -1;
+    if ((byte >= '0') && (byte <= '9')) 
+      { v = byte - '0'; }
+    else if ((base == 16) && (byte >= 'A') && (byte <= 'F'))
+      { v = byte - 'A' + 10; }
+    return v;
+  }
+
+bool leitor_recebe_byte(muff_leitor_t *leitor, int byte)
+  {
+    muff_comando_t *cmd = &(leitor->cmd);
+    
+    if (leitor->formato == NULL)
+      { // O {byte} eh o codigo de um novo comando:
+        inicializa_comando(cmd, byte);
+        leitor->formato = leitor->formato_args(byte);
+        leitor->pos = 0;
+        leitor->negativo = false;
+        cmd->arg[0] = 0;
+      }
+    else
+      { // O {byte} eh o proximo byte de argumento:
+        char tipo = leitor->formato[leitor->pos];
+        if (tipo == ',')
+          { // Comeca outro argumento:
+            termina_argumento(leitor);
+            cmd->arg[cmd->nargs] = 0;
+            leitor->pos++;
+            tipo = leitor->formato[leitor->pos];
+          }
+        long *val = &(cmd->arg[cmd->nargs]);
+        if (tipo == 's')
+          { if (byte == '-') 
+              { leitor->negativo = true; }
+            else 
+              { cmd->ok &= (byte == '+'); }
+          }
+        else if ((tipo == 'd') || (tipo == 'x'))
+          { int base = (tipo == 'd' ? 10 : 16);
+            int v = valor_digito(byte, base);
+            if (v < 0) { cmd->ok = false; v = 0; }
+            (*val) = (*val)*base + v;
+          }
+        else
+          { (*val) = byte; }
+        leitor->pos++;
+      }
+
+    if (leitor->formato[leitor->pos] != '\0') { return false; }
     
+    // Comando completo:
+    if (leitor->pos > 0) { termina_argumento(leitor); }
+    leitor->formato = NULL;
+    return true;
+  }
+
+void comando_confere_args(muff_comando_t *cmd, char *formato)
+  {
+    int k = 0;
+    int pos = 0;
+    while ((k < cmd->nargs) && (formato[pos] != '\0'))
+      { // Examina o campo do argumento {k}, que comeca em {formato[pos]}:
+        bool sinal = false, caracter = false;
+        long lim = 0; // Maior valor absoluto que cabe no campo.
+        while ((formato[pos] != '\0') && (formato[pos] != ','))
+          { char tipo = formato[pos];
+            if (tipo == 's')
+              { sinal = true; }
+            else if (tipo == 'c')
+              { caracter = true; }
+            else
+              { int base = (tipo == 'd' ? 10 : 16);
+                lim = (lim > (0x7FFFFFFFL - (base - 1))/base ? 0x7FFFFFFFL : lim*base + (base - 1));
+              }
+            pos++;
+          }
+        if (caracter) { lim = 255; }
+        long v = cmd->arg[k];
+        if ((v > lim) || (v < (sinal ? -lim : 0))) { cmd->ok = false; }
+        if (formato[pos] == ',') { pos++; }
+        k++;
+      }
+  }
+
+void comando_aciona_motor(muff_motor *motor, long desloc, int max_vel)
+  {
     // Notifica quem chamou
-    Serial.print("# Girando o motor no sentido ");
-    if (desloc > 0)
-      { Serial.print("horario"); }
-    else
-      { Serial.print("anti-horario"); }
-    Serial.print(" por ");
-    Serial.print(desloc);
-    Serial.print(" passos, vel max ");
-    Serial.print(max_vel);
-    Serial.println(" passos/seg");
+    muff_aviso((desloc > 0 ? aviso_girando_horario : aviso_girando_anti_horario), desloc, max_vel);
     
+    // Se o motor estiver em movimento, este movimento comeca quando ele parar:
     aciona_motor(motor, desloc, max_vel);
+  }
     
-    if (completa)
-      { // Gera passos ateh o motor chegar no ponto desejado e parar:
-        while (motor->isRunning()) { motor->run(); } 
-        motor->disableOutputs();
-      }
+void comando_desloca_quadro(muff_motor *motor, long desloc, int max_vel)
+  {
+    muff_aviso(aviso_quadro, desloc);
+    aciona_motor_rampa(motor, desloc, max_vel);
   }
     
-void comando_para_motor(AccelStepper *motor)
+void comando_para_motor(muff_motor *motor)
   {
-    if (motor->isRunning()) 
-      { Serial.println("# Parando o motor...");
+    if (motor_em_movimento(motor)) 
+      { muff_aviso(aviso_parando);
         para_motor(motor);
       }
   }
 
-void comando_define_desloc_quadro(int *desloc)
-  { 
-    Serial.println("# Definindo o deslocamento padrao entre quadros");
-    // Recebe o argumento
-    char arg[5]; // Quatro bytes do argumento e um '\0' para terminar a cadeia.
-    bool ok = true;
-    for (int k = 0; k < 4; k++)
-      { while (Serial.available() <= 0) { }
-        arg[k] = Serial.read();
-        if (k == 0)
-          { ok &= ((arg[k] == '+') || (arg[k] == '-')); }
-        else
-          { ok &= ((arg[k] >= '0') && (arg[k] <= '9')); }
+void comando_interrompe_motor(muff_motor *motor)
+  {
+    if (motor_em_movimento(motor)) 
+      { muff_aviso(aviso_interrompendo);
+        interrompe_motor(motor);
       }
-    arg[4] = '\0'; // Marca fim da cadeia.
-    Serial.print("# Argumento = ");
-    Serial.print(arg);
-    Serial.print(" microns");
-    
-    if (! ok)
-      { Serial.println("");
-        muff_erro("valor invalido");
+  }
+
+void comando_move_motor(muff_comando_t *cmd, muff_motor *motor, int max_vel, bool absoluto)
+  {
+    int unidade = cmd->arg[0];
+    if ((! cmd->ok) || (cmd->nargs != 2) || ((unidade != 'P') && (unidade != 'N')))
+      { muff_erro(erro_unidade); return; }
+    long valor = cmd->arg[1];
+    if (unidade == 'N') { valor = nanometros_para_passos(valor); }
+    muff_aviso((absoluto ? aviso_movendo_para : aviso_movendo_por), valor);
+    if (absoluto)
+      { aciona_motor_para(motor, valor, max_vel); }
+    else
+      { aciona_motor(motor, valor, max_vel); }
+  }
+
+void comando_preve_duracao(muff_comando_t *cmd, muff_motor *motor, int max_vel)
+  {
+    int unidade = cmd->arg[0];
+    if ((! cmd->ok) || (cmd->nargs != 3) || ((unidade != 'P') && (unidade != 'N')))
+      { muff_erro(erro_unidade); return; }
+    if ((cmd->arg[2] < 0) || (cmd->arg[2] > 9999))
+      { muff_erro(erro_velocidade); return; }
+    long desloc = cmd->arg[1];
+    if (unidade == 'N') { desloc = nanometros_para_passos(desloc); }
+    int vel = (cmd->arg[2] == 0 ? max_vel : (int)cmd->arg[2]);
+    long us = duracao_movimento_motor(motor, desloc, vel);
+    muff_aviso(aviso_duracao, desloc, vel, us);
+    if (protocolo_binario())
+      { responde_antes_dos_dados(cmd);
+        for (int k = 0; k < 4; k++) { Serial.write((uint8_t)((us >> (8*k)) & 255)); } }
+    else
+      { Serial.print(F("= "));
+        Serial.println(us);
       }
+  }
+
+void comando_enfileira_movimento(muff_comando_t *cmd, muff_motor *motor, int max_vel)
+  {
+    int unidade = cmd->arg[0];
+    if ((! cmd->ok) || (cmd->nargs != 3) || ((unidade != 'P') && (unidade != 'N')))
+      { muff_erro(erro_unidade); return; }
+    if ((cmd->arg[2] < 0) || (cmd->arg[2] > 9999))
+      { muff_erro(erro_velocidade); return; }
+    long alvo = cmd->arg[1];
+    if (unidade == 'N') { alvo = nanometros_para_passos(alvo); }
+    int vel = (cmd->arg[2] == 0 ? max_vel : (int)cmd->arg[2]);
+    muff_aviso(aviso_enfileirando, alvo, vel);
+    int erro = enfileira_movimento(motor, alvo, vel);
+    if (erro != 0) { muff_erro(erro); }
+  }
+
+void comando_busca_origem(muff_comando_t *cmd, muff_motor *motor, int vel_rapida, int vel_lenta)
+  {
+    int unidade = cmd->arg[0];
+    if ((! cmd->ok) || (cmd->nargs != 2) || ((unidade != 'P') && (unidade != 'N')))
+      { muff_erro(erro_unidade); return; }
+    long alvo = cmd->arg[1];
+    if (unidade == 'N') { alvo = nanometros_para_passos(alvo); }
+    if (! busca_inicia(motor, vel_rapida, vel_lenta, alvo))
+      { muff_erro(erro_destino_busca); }
+  }
+
+void comando_mostra_posicao(muff_comando_t *cmd, muff_motor *motor)
+  {
+    long pos = posicao_motor(motor);
+    if (protocolo_binario())
+      { responde_antes_dos_dados(cmd);
+        for (int k = 0; k < 4; k++) { Serial.write((uint8_t)((pos >> (8*k)) & 255)); } }
     else
-      { // Converte os 4 caracters para inteiro em -999 a +999 (microns):
-        int microns = (arg[1] - '0')*100 + (arg[2] - '0')*10 + (arg[3] - '0');
+      { Serial.print(F("= "));
+        Serial.println(pos);
+      }
+  }
+
+void comando_mostra_estado_motor(muff_comando_t *cmd, muff_motor *motor)
+  {
+    long pos = posicao_motor(motor);
+    long alvo = alvo_motor(motor);
+    int estado = estado_motor(motor);
+    if (protocolo_binario())
+      { responde_antes_dos_dados(cmd);
+        for (int k = 0; k < 4; k++) { Serial.write((uint8_t)((pos >> (8*k)) & 255)); }
+        for (int k = 0; k < 4; k++) { Serial.write((uint8_t)((alvo >> (8*k)) & 255)); }
+        Serial.write((uint8_t)estado);
+      }
+    else
+      { Serial.print(F("= "));
+        Serial.print(pos);
+        Serial.print(' ');
+        Serial.print(alvo);
+        Serial.print(' ');
+        Serial.println((char)estado);
+      }
+  }
+
+void comando_relata_perfil(muff_comando_t *cmd)
+  {
+#if muff_usa_perfil
+    responde_antes_dos_dados(cmd);
+    perfil_relata();
+#else
+    (void)(cmd);
+    muff_erro(erro_sem_perfil);
+#endif
+  }
+
+void comando_zera_posicao(muff_motor *motor)
+  {
+    muff_aviso(aviso_zerando);
+    define_posicao_motor(motor, 0);
+  }
+
+void comando_define_desloc_quadro(muff_comando_t *cmd, long *desloc)
+  { 
+    muff_aviso(aviso_define_desloc);
+    if ((! cmd->ok) || (cmd->nargs != 1))
+      { muff_erro(erro_valor); }
+    else
+      { // Argumento eh inteiro em -999 a +999 (microns):
+        long microns = cmd->arg[0];
 
         // Converte o valor em microns para numero de passos do motor:
-        int npp = nanometros_por_passo;
-        int passos = (microns*((long int)1000)+(npp/2))/npp;
-        if (arg[0] == '-') { passos = - passos;  microns = - microns; }
+        long passos = nanometros_para_passos(microns*1000L);
 
         // Informa usuario sobre conversao: 
-        Serial.print(" = ");
-        Serial.print(passos);
-        Serial.println(" passos");
+        muff_aviso(aviso_desloc, microns, passos);
         (*desloc) = passos;
       }
   }
   
-void comando_define_max_acel(int *max_acel)
+void comando_define_tranco(muff_comando_t *cmd, muff_motor *motor, long *tranco)
   { 
-    Serial.println("# Definindo a aceleracao maxima");
-    // Recebe o argumento
-    char arg[4]; // Tres bytes do argumento e um '\0' para terminar a cadeia.
-    bool ok = true;
-    for (int k = 0; k < 3; k++)
-      { while (Serial.available() <= 0) { }
-        arg[k] = Serial.read();
-        ok &= ((arg[k] >= '0') && (arg[k] <= '9'));
-      }
-    arg[4] = '\0'; // Marca fim da cadeia.
-    Serial.print("# Argumento = ");
-    Serial.print(arg);
-    if (! ok) 
-      { Serial.println("");
-        muff_erro("valor invalido - deve ser '000' a '999'");
-      }
-    else
-      { // Converte os 3 caracters para inteiro em 000 a 999:
-        int acel = (arg[0] - '0')*100 + (arg[1] - '0')*10 + (arg[2] - '0');
-        Serial.print(" = ");
-        Serial.print(acel);
-        Serial.print(" passos/seg^2");
-        Serial.println(""); 
-        
-        if (acel == 0) { muff_erro("aceleracao maxima nao pode ser nula"); }
-    
-        (*max_acel) = acel;
+    muff_aviso(aviso_define_tranco);
+    if ((! cmd->ok) || (cmd->nargs != 1))
+      { muff_erro(erro_tranco); return; }
+    // Argumento eh inteiro em 00000 a 99999, em passos inteiros, como no '8':
+    muff_aviso((cmd->arg[0] == 0 ? aviso_tranco_nulo : aviso_tranco), cmd->arg[0]);
+    (*tranco) = cmd->arg[0]*motor1_micropassos;
+    para_motor(motor);
+    define_tranco_motor(motor, (*tranco));
+  }
+
+void comando_define_retencao(muff_comando_t *cmd, long *retencao_ms)
+  { 
+    muff_aviso(aviso_define_retencao);
+    int modo = cmd->arg[0];
+    if ((! cmd->ok) || (cmd->nargs != 2) || ((modo != 'S') && (modo != 'T') && (modo != 'N')))
+      { muff_erro(erro_retencao); return; }
+    long ms = (modo == 'S' ? retencao_permanente : (modo == 'N' ? 0 : cmd->arg[1]));
+    if (ms == retencao_permanente)
+      { muff_aviso(aviso_sempre_energizado); }
+    else
+      { muff_aviso(aviso_desenergiza, ms); }
+    (*retencao_ms) = ms;
+    define_retencao_motor(ms);
+  }
+
+bool comando_define_parametro(muff_comando_t *cmd, muff_config_t *cfg)
+  {
+    if ((! cmd->ok) || (cmd->nargs != 2) || (! config_define(cfg, cmd->arg[0], cmd->arg[1])))
+      { muff_erro(erro_parametro); return false; }
+    muff_aviso(aviso_parametro, cmd->arg[0], cmd->arg[1]);
+    return true;
+  }
+
+void comando_mostra_parametro(muff_comando_t *cmd, muff_config_t *cfg)
+  {
+    if ((! cmd->ok) || (cmd->nargs != 1) || (cmd->arg[0] < 0) || (cmd->arg[0] >= config_num_params))
+      { muff_erro(erro_parametro); return; }
+    long val = config_valor(cfg, cmd->arg[0]);
+    if (protocolo_binario())
+      { responde_antes_dos_dados(cmd);
+        for (int k = 0; k < 4; k++) { Serial.write((uint8_t)((val >> (8*k)) & 255)); } }
+    else
+      { Serial.print(F("= "));
+        Serial.println(val);
+      }
+  }
+
+bool comando_configuracao(muff_comando_t *cmd, muff_config_t *cfg)
+  {
+    int opcao = cmd->arg[0];
+    if ((! cmd->ok) || (cmd->nargs != 1) || (opcao < 0) || (opcao > 2))
+      { muff_erro(erro_argumentos); return false; }
+    if (opcao == 0)
+      { muff_aviso(aviso_carrega_config);
+        inicializa_padroes();
+        if (! config_carrega(cfg)) { muff_erro(erro_config); return false; }
+      }
+    else if (opcao == 1)
+      { muff_aviso(aviso_grava_config);
+        if (! config_valida(cfg)) { muff_erro(erro_config); return false; }
+        if ((! config_grava(cfg)) || (! padroes_grava())) { muff_erro(erro_eeprom); }
+        return false;
       }
+    else
+      { muff_aviso(aviso_config_padrao);
+        config_padrao(cfg);
+        padroes_apaga();
+      }
+    return true;
   }
 
-void comando_aciona_leds(int estado, int estados_dos_leds[])
+void comando_define_telemetria(muff_comando_t *cmd)
+  { 
+    muff_aviso(aviso_define_telemetria);
+    if ((! cmd->ok) || (cmd->nargs != 1) || (cmd->arg[0] < 0) || (cmd->arg[0] > 9999))
+      { muff_erro(erro_telemetria); return; }
+    long ms = cmd->arg[0];
+    if (ms == 0)
+      { muff_aviso(aviso_telemetria_desligada); }
+    else
+      { muff_aviso(aviso_telemetria, (ms < telemetria_min_periodo_ms ? (long)telemetria_min_periodo_ms : ms)); }
+    telemetria_define_periodo(ms);
+  }
+
+void comando_define_max_acel(muff_comando_t *cmd, long *max_acel)
+  { 
+    muff_aviso(aviso_define_acel);
+    // Argumento eh inteiro em 000 a 999:
+    if ((! cmd->ok) || (cmd->nargs != 1) || (cmd->arg[0] < 0) || (cmd->arg[0] > 999))
+      { muff_erro(erro_acel); return; }
+    int acel = cmd->arg[0];
+    muff_aviso(aviso_acel, acel);
+    // Nao guarda o valor nulo, que tornaria a configuracao invalida:
+    if (acel == 0) { muff_erro(erro_acel_nula); return; }
+    (*max_acel) = (long)acel*motor1_micropassos;
+  }
+
+void comando_aciona_leds(muff_comando_t *cmd, int estado, uint8_t estados_dos_leds[])
   { 
     if (estado == 1)
-      { Serial.println("# Ligando LED(s)"); }
+      { muff_aviso(aviso_ligando_leds); }
     else
-      { Serial.println("# Desligando LED(s)"); }
+      { muff_aviso(aviso_desligando_leds); }
       
-    // Recebe o caracter que identifica o(s) LED(s):
-    while (Serial.available() <= 0) { }
-    int cod_led = Serial.read();
-    mostra_byte("codigo do(s) LED(s)", cod_led);
+    if ((! cmd->ok) || (cmd->nargs != 1))
+      { muff_erro(erro_led); return; }
+
+    // Caracter que identifica o(s) LED(s):
+    int cod_led = cmd->arg[0];
+    muff_aviso(aviso_codigo_led, cod_led, cod_led);
 
     if (cod_led == '@')
       { aciona_todos_os_leds(estado, estados_dos_leds); }
     else 
       { int indice_led = cod_led - 'A'; // Numero do led, 0 a nLED-1.
         if ((indice_led < 0) || (indice_led >= num_leds))
-          { muff_erro("codigo de LED invalido"); }
+          { muff_erro(erro_led); }
         else
           { aciona_um_led(indice_led, estado, estados_dos_leds); }
       }
   }
 
-void mostra_byte(char *mensagem, int byte)
-  { 
-    Serial.print("# ");
-    Serial.print(mensagem);
-    Serial.print(" = '");
-    Serial.print((char)(byte & 255));
-    Serial.print("' = chr(");
-    Serial.print((int)byte);
-    Serial.println(")");
-  }
- 
+void comando_define_leds(muff_comando_t *cmd, uint8_t estados_dos_leds[])
+  {
+    muff_aviso(aviso_define_leds);
+    if ((! cmd->ok) || (cmd->nargs != 1) || (cmd->arg[0] < 0) || (cmd->arg[0] >= (1L << num_leds)))
+      { muff_erro(erro_mascara); }
+    else
+      { muff_aviso(aviso_mascara, cmd->arg[0]);
+        aciona_leds_mascara(cmd->arg[0], estados_dos_leds);
+      }
+  }
+
+void comando_define_padrao(muff_comando_t *cmd)
+  {
+    muff_aviso(aviso_define_padrao);
+    if ((! cmd->ok) || (cmd->nargs != 2) || (cmd->arg[1] < 0) || (cmd->arg[1] >= (1L << num_leds)))
+      { muff_erro(erro_mascara); }
+    else if (! padrao_define(cmd->arg[0], cmd->arg[1]))
+      { muff_erro(erro_padrao); }
+    else
+      { muff_aviso(aviso_padrao, cmd->arg[0], cmd->arg[1]); }
+  }
+
+void comando_grava_padroes(void)
+  {
+    muff_aviso(aviso_grava_padroes);
+    if (! padroes_grava()) { muff_erro(erro_eeprom); }
+  }
+
+void comando_seleciona_padrao(int indice, uint8_t estados_dos_leds[])
+  {
+    muff_aviso(aviso_seleciona_padrao, indice);
+    aciona_leds_mascara(padrao_mascara(indice), estados_dos_leds);
+  }
+
+void comando_define_plano(muff_comando_t *cmd, muff_sequenciador_t *seq)
+  {
+    muff_aviso(aviso_define_plano);
+    if (sequenciador_ativo(seq))
+      { muff_erro(erro_plano_ativo); }
+    else if ((! cmd->ok) || (cmd->nargs != 2) || (cmd->arg[0] <= 0))
+      { muff_erro(erro_plano); }
+    else
+      { muff_aviso(aviso_plano, cmd->arg[0], cmd->arg[1]);
+        sequenciador_define_plano(seq, cmd->arg[0], cmd->arg[1]);
+      }
+  }
+
+void comando_acrescenta_mascara(muff_comando_t *cmd, muff_sequenciador_t *seq)
+  {
+    if (sequenciador_ativo(seq))
+      { muff_erro(erro_plano_ativo); }
+    else if ((! cmd->ok) || (cmd->nargs != 1) || (cmd->arg[0] < 0) || (cmd->arg[0] >= (1L << num_leds)))
+      { muff_erro(erro_mascara); }
+    else
+      { muff_aviso(aviso_condicao, seq->plano.nL, cmd->arg[0]);
+        if (! sequenciador_acrescenta_mascara(seq, cmd->arg[0]))
+          { muff_erro(erro_excesso_mascaras); }
+      }
+  }
+
+void comando_acrescenta_desloc_altura(muff_comando_t *cmd, muff_sequenciador_t *seq)
+  {
+    if (sequenciador_ativo(seq))
+      { muff_erro(erro_plano_ativo); }
+    else if ((! cmd->ok) || (cmd->nargs != 1))
+      { muff_erro(erro_valor); }
+    else
+      { long microns = cmd->arg[0];
+        long passos = nanometros_para_passos(microns*1000L);
+        muff_aviso(aviso_desloc_altura, seq->plano.nZ, microns, passos);
+        if (! sequenciador_acrescenta_desloc(seq, passos))
+          { muff_erro(erro_excesso_alturas); }
+      }
+  }
+
+void comando_proxima_altura(muff_sequenciador_t *seq, muff_motor *motor, int max_vel)
+  {
+    long desloc;
+    if (sequenciador_ativo(seq))
+      { muff_erro(erro_plano_jah_ativo); }
+    else if (! sequenciador_proximo_desloc(seq, &desloc))
+      { muff_erro(erro_fim_alturas); }
+    else
+      { muff_aviso(aviso_proxima_altura, seq->Z - 1, desloc);
+        // Sem tabela de rampa: os deslocamentos variam, e ela eh a do '5':
+        aciona_motor_micropassos(motor, desloc, max_vel);
+      }
+  }
+
+void comando_inicia_sequencia(muff_sequenciador_t *seq, long desloc, int max_vel)
+  {
+    muff_aviso(aviso_inicia_captura, desloc);
+    muff_plano_t *pl = &(seq->plano);
+    if (sequenciador_ativo(seq))
+      { muff_erro(erro_plano_jah_ativo); }
+    else if ((pl->nZ > 0) && (pl->nZ < pl->nH - 1))
+      { muff_erro(erro_lista_alturas); }
+    else if (! sequenciador_inicia(seq, desloc, max_vel))
+      { muff_erro(erro_plano_vazio); }
+  }
+
+void comando_quadro_tirado(muff_sequenciador_t *seq)
+  {
+    int erro = sequenciador_quadro_tirado(seq);
+    if (erro != 0) { muff_erro(erro); }
+  }
+
+void comando_configura_camera(muff_comando_t *cmd)
+  {
+    muff_aviso(aviso_configura_camera);
+    if ((! cmd->ok) || (cmd->nargs != 2) || (cmd->arg[1] < 0) || (cmd->arg[1] > 1))
+      { muff_erro(erro_camera); }
+    else
+      { muff_aviso((cmd->arg[1] ? aviso_camera_exposicao : aviso_camera_sem_exposicao), cmd->arg[0]);
+        camera_configura(cmd->arg[0], cmd->arg[1]);
+      }
+  }
+
+void comando_inicia_varredura(muff_comando_t *cmd, muff_motor *motor, long desloc)
+  {
+    muff_aviso(aviso_inicia_varredura);
+    if ((! cmd->ok) || (cmd->nargs != 2))
+      { muff_erro(erro_argumentos); }
+    else 
+      { muff_aviso(aviso_varredura, cmd->arg[0], desloc, cmd->arg[1]);
+        if (! varredura_inicia(motor, cmd->arg[0], desloc, cmd->arg[1]))
+          { muff_erro(erro_varredura); }
+      }
+  }
+
+void comando_mostra_disparos(muff_comando_t *cmd)
+  {
+    int n = varredura_num_disparos();
+    if (protocolo_binario())
+      { responde_antes_dos_dados(cmd);
+        Serial.write((uint8_t)n);
+        for (int k = 0; k < n; k++)
+          { unsigned int d = varredura_disparo(k);
+            Serial.write((uint8_t)(d & 255));
+            Serial.write((uint8_t)(d >> 8));
+          }
+      }
+    else
+      { Serial.print(F("= "));
+        Serial.print(n);
+        for (int k = 0; k < n; k++)
+          { Serial.print(' ');
+            Serial.print(varredura_disparo(k));
+          }
+        Serial.println();
+      }
+  }
+
+void comando_define_protocolo(muff_comando_t *cmd)
+  {
+    if ((! cmd->ok) || (cmd->nargs != 1) || (cmd->arg[0] < 0) || (cmd->arg[0] > 1))
+      { muff_erro(erro_protocolo); }
+    else if ((cmd->arg[0] == 0) && (protocolo_endereco() != 0))
+      { // No barramento, o ASCII seria ouvido por todas as unidades:
+        muff_erro(erro_protocolo);
+      }
+    else if (cmd->arg[0] == 1)
+      { muff_aviso(aviso_binario);
+        protocolo_define_binario(true);
+      }
+    else
+      { protocolo_define_binario(false);
+        muff_aviso(aviso_ascii);
+      }
+  }
+
+void comando_define_velocidade_serial(muff_comando_t *cmd)
+  {
+    if ((! cmd->ok) || (cmd->nargs != 1) || (! velocidade_serial_valida(cmd->arg[0])))
+      { muff_erro(erro_velocidade_serial); }
+    else
+      { muff_aviso(aviso_velocidade_serial, cmd->arg[0]);
+        define_velocidade_serial(cmd->arg[0]);
+      }
+  }
+
 void mostra_comando(int comando)
   { 
-    mostra_byte("Comando recebido", comando);
+    muff_aviso(aviso_comando, comando, comando);
   }
         
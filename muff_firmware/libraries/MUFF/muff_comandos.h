@@ -7,66 +7,409 @@
 
 #include <AccelStepper.h>
 #include <muff_utils.h>
+#include <muff_sequenciador.h>
+#include <muff_config.h>
 
-void comando_aciona_motor(AccelStepper *motor, int desloc, int maxVel, bool completa);
+// -----------------------------------------------------------
+// LEITURA INCREMENTAL DE COMANDOS
+
+// Cada comando eh um byte de codigo seguido de zero ou mais bytes
+// de argumento.  O numero e o tipo dos bytes de argumento dependem
+// do codigo, e sao descritos por uma cadeia de formato, onde cada 
+// caracter descreve um byte: 
+//
+//   's' um sinal, '+' ou '-';
+//   'd' um digito decimal, '0' a '9';
+//   'x' um digito hexadecimal, '0' a '9' ou 'A' a 'F';
+//   'c' um caracter qualquer, cujo valor eh o proprio codigo ASCII.
+//
+// Bytes consecutivos de tipo 's', 'd' ou 'x' formam um unico argumento
+// numerico. Uma ',' no formato (que nao corresponde a nenhum byte)
+// separa dois argumentos.  Por exemplo, o formato "sddd" descreve um 
+// argumento com sinal e tres digitos decimais, como "+025" ou "-100".
+//
+// Os bytes sao consumidos um a um, aa medida que chegam, sem esperar
+// pelos seguintes; o comando so eh executado quando todos os seus 
+// argumentos tiverem chegado.
+
+#define max_args_comando (4)
+  // Numero maximo de argumentos de um comando.
+
+typedef struct muff_comando_t
+  { int codigo;                   // Codigo do comando (um caracter ASCII).
+    int nargs;                    // Numero de argumentos recebidos.
+    long arg[max_args_comando];   // Valores dos argumentos {arg[0..nargs-1]}.
+    bool ok;                      // False se algum byte de argumento era invalido.
+    int seq;                      // Numero de sequencia do quadro binario, ou -1 se veio em ASCII.
+    bool respondido;              // True se a resposta jah foi enviada (veja {responde_antes_dos_dados}).
+    bool adia_fim;                // True se o aviso de fim deve esperar o movimento (veja {protocolo_adia_fim}).
+    bool difusao;                 // True se o quadro foi enviado a todas as unidades, sem resposta (veja {protocolo_difusao}).
+  } muff_comando_t;
+  // Um comando completo, pronto para ser executado.
+
+typedef char *muff_formato_args_t(int codigo);
+  // Tipo de uma funcao que retorna a cadeia de formato dos argumentos
+  // do comando com o {codigo} dado (uma cadeia vazia se o comando
+  // nao tem argumentos).
+
+typedef struct muff_leitor_t
+  { muff_formato_args_t *formato_args; // Funcao que da o formato de cada comando.
+    muff_comando_t cmd;           // Comando sendo recebido.
+    char *formato;                // Formato dos argumentos de {cmd}, ou NULL se nenhum comando comecou.
+    int pos;                      // Posicao do proximo byte em {formato}.
+    bool negativo;                // True se o argumento corrente tem sinal '-'.
+  } muff_leitor_t;
+  // Estado do leitor incremental de comandos.
+
+void inicializa_comando(muff_comando_t *cmd, int codigo);
+  // Inicializa {*cmd} como um comando ASCII com o {codigo} dado 
+  // e sem argumentos.
+
+void inicializa_leitor(muff_leitor_t *leitor, muff_formato_args_t *formato_args);
+  // Inicializa o {leitor} no estado "esperando codigo de comando".
+  // A funcao {formato_args} sera usada para saber quantos 
+  // bytes de argumento ler depois de cada codigo.
+
+bool leitor_recebe_byte(muff_leitor_t *leitor, int byte);
+  // Processa o {byte} recebido pela porta serial, que pode 
+  // ser um codigo de comando ou um byte de argumento.  Retorna true
+  // se o {byte} completou um comando, que estah entao em {leitor->cmd}.
+  // Nesse caso, o {leitor} volta ao estado "esperando codigo de comando"
+  // na proxima chamada.
+
+void comando_confere_args(muff_comando_t *cmd, char *formato);
+  // Torna {cmd->ok} false se algum argumento {cmd->arg[k]} nao couber
+  // no campo {k} do {formato}: se tiver mais digitos que o campo, se for
+  // negativo num campo sem 's', ou se estiver fora de 0..255 num campo
+  // 'c'.  Serve para os comandos do protocolo binario, cujos argumentos
+  // sao inteiros de 32 bits quaisquer, de modo que os comandos possam
+  // contar com os mesmos limites que no protocolo ASCII.
+
+// -----------------------------------------------------------
+// EXECUCAO DOS COMANDOS
+
+void comando_aciona_motor(muff_motor *motor, long desloc, int maxVel);
   // Inicia o movimento do {motor} {desloc} passos a partir da posicao
   // corrente, com velocidade maxima {maxVel}. O valor {desloc} pode ser 
   // positivo (horario,sobe) ou negativo (antihorario,desce).
   // O valor de {maxVel} deve ser sempre positivo.
   // 
-  // Se {completa} eh true, executa {motor.run} internamente 
-  // e somente retorna quando o movimento tiver terminado
-  // e o motor estiver parado.
-  // 
-  // Se {completa} eh false, apenas inicia o movimento e retorna
-  // imediatamente, sem esperar terminar. O loop principal deve chamar
-  // {motor.run()} repetidamente para realmente executar o movimento,
-  // enquanto {motor.isRunning()} for verdade. O movimento pode ser
+  // Apenas inicia o movimento e retorna imediatamente, sem esperar
+  // terminar. O loop principal deve chamar {motor_gera_passos}
+  // repetidamente para realmente executar o movimento, enquanto
+  // {motor_em_movimento} for verdade. O movimento pode ser
   // interrompido por uma chamada de {comando_para_motor} ou outra
   // chamada desta funcao.
   //
-  // Se o motor ja estiver em movimento, interrompe o mesmo antes de iniciar.  
+  // Se o motor ja estiver em movimento, o faz desacelerar e parar, e
+  // o novo movimento comeca de onde ele parou (veja {aciona_motor}).
+
+void comando_desloca_quadro(muff_motor *motor, long desloc, int max_vel);
+  // Como {comando_aciona_motor}, mas com os passos
+  // cronometrados por uma tabela precalculada (veja {aciona_motor_rampa}).
+  // Deve ser usada para o deslocamento entre quadros, que eh sempre o mesmo.
 
-void comando_para_motor(AccelStepper *motor);
-  // Interrompe o movimento do {motor}, se estiver em movimento, na posicao
-  // corrente.
+void comando_para_motor(muff_motor *motor);
+  // Faz o {motor} desacelerar e parar, se estiver em movimento, e
+  // cancela o movimento que estiver esperando ele parar.
   // 
-  // Somente retorna quando o motor estiver parado.
+  // Retorna imediatamente, sem esperar o motor parar (veja {para_motor}).
   // Se o motor jah estiver parado, nao faz nada.
 
-void comando_define_desloc_quadro(int *desloc);
+void comando_interrompe_motor(muff_motor *motor);
+  // Parada de emergencia: como {comando_para_motor}, mas para o {motor}
+  // imediatamente, sem rampa de desaceleracao (veja {interrompe_motor}),
+  // mesmo que ele jah esteja desacelerando.
+
+#define formato_move_motor "c,sddddddddd"
+  // Formato dos argumentos de {comando_move_motor}.
+
+void comando_move_motor(muff_comando_t *cmd, muff_motor *motor, int max_vel, bool absoluto);
+  // Inicia o movimento do {motor} para a posicao absoluta {cmd->arg[1]}
+  // (se {absoluto} for true) ou por {cmd->arg[1]} a partir da posicao 
+  // corrente (se for false), com velocidade maxima {max_vel}, sem esperar
+  // terminar.  O codigo de comando deve ser seguido da unidade 
+  // {cmd->arg[0]}, 'P' para passos ou 'N' para nanometros, e de um 
+  // sinal e 9 digitos decimais.  No protocolo binario o valor eh um 
+  // inteiro de 32 bits qualquer.
+
+#define formato_preve_duracao "c,sddddddddd,dddd"
+  // Formato dos argumentos de {comando_preve_duracao}.
+
+void comando_preve_duracao(muff_comando_t *cmd, muff_motor *motor, int max_vel);
+  // Envia quanto tempo levaria um movimento do {motor} por {cmd->arg[1]}
+  // a partir da posicao corrente, sem move-lo (veja 
+  // {duracao_movimento_motor}), em microssegundos: no protocolo ASCII,
+  // como uma linha "= {duracao}"; no binario, como 4 bytes, o menos 
+  // significativo primeiro.  Os argumentos sao como os de 
+  // {comando_enfileira_movimento}: unidade, deslocamento, e velocidade
+  // maxima (passos/segundo), ou 0 para usar {max_vel}.
+
+#define formato_enfileira_movimento "c,sddddddddd,dddd"
+  // Formato dos argumentos de {comando_enfileira_movimento}.
+
+void comando_enfileira_movimento(muff_comando_t *cmd, muff_motor *motor, int max_vel);
+  // Acrescenta ao fim da fila do {motor} um movimento para a posicao 
+  // absoluta {cmd->arg[1]}, na unidade {cmd->arg[0]} ('P' ou 'N', como em
+  // {comando_move_motor}), com velocidade maxima {cmd->arg[2]} 
+  // (passos/segundo), ou {max_vel} se {cmd->arg[2]} for zero.  Nao espera:
+  // se o motor estiver parado, o movimento comeca imediatamente; senao,
+  // comeca quando o anterior chegar ao seu objetivo, sem parar se ambos
+  // tiverem o mesmo sentido (veja {enfileira_movimento}).  Se o movimento
+  // nao puder ser enfileirado, o comando falha com o erro correspondente.
+  //
+  // Os comandos de movimento comuns ('1', '3', 'G', etc) descartam a fila.
+
+#define formato_busca_origem "c,sddddddddd"
+  // Formato dos argumentos de {comando_busca_origem}.
+
+void comando_busca_origem(muff_comando_t *cmd, muff_motor *motor, int vel_rapida, int vel_lenta);
+  // Inicia a busca da origem na chave de fim de curso (veja {busca_inicia}
+  // em {muff_chave.h}), aproximando-se dela a {vel_rapida} e depois a 
+  // {vel_lenta}, e terminando na posicao absoluta {cmd->arg[1]} (que deve
+  // ser negativa ou zero), na unidade {cmd->arg[0]} ('P' ou 'N', como em
+  // {comando_move_motor}).  Nao espera terminar: no fim eh enviado o aviso
+  // {busca_fim}.
+
+void comando_mostra_posicao(muff_comando_t *cmd, muff_motor *motor);
+  // Envia a posicao absoluta corrente do {motor}, em passos: no 
+  // protocolo ASCII, uma linha "= {posicao}"; no binario, 4 bytes com o
+  // menos significativo primeiro, logo depois da resposta ao {cmd}.
+
+void comando_mostra_estado_motor(muff_comando_t *cmd, muff_motor *motor);
+  // Envia a posicao absoluta corrente do {motor}, o objetivo do 
+  // movimento corrente (veja {alvo_motor}), ambos em passos, e o 
+  // estado do motor (veja {estado_motor}): no protocolo ASCII, uma linha
+  // "= {posicao} {alvo} {estado}"; no binario, 4 bytes de posicao e
+  // 4 de objetivo, com o menos significativo primeiro, e 1 byte de 
+  // estado, logo depois da resposta ao {cmd}.  Pode ser usada a 
+  // qualquer momento, inclusive durante um movimento.
+
+void comando_relata_perfil(muff_comando_t *cmd);
+  // Envia e zera as medidas de tempo do firmware (veja {perfil_relata}
+  // em {muff_perfil.h}), logo depois da resposta ao {cmd}.  Falha se
+  // o firmware foi compilado com {muff_usa_perfil} igual a 0.
+
+void comando_zera_posicao(muff_motor *motor);
+  // Para o {motor} imediatamente e define a posicao corrente como zero.
+
+#define formato_desloc_quadro "sddd"
+  // Formato do argumento de {comando_define_desloc_quadro}.
+
+void comando_define_desloc_quadro(muff_comando_t *cmd, long *desloc);
   // Define a distancia a deslocar para {comando_executa_desloc_quadro}.
   // O codigo de comando deve ser seguido de 4 bytes -- um sinal e 3
   // digitos decimais -- especificando um valor em microns. Converte
-  // esse valor de microns para passos do motor, e guarda em {*desloc}.
+  // esse valor {cmd->arg[0]} de microns para passos do motor, e guarda em {*desloc}.
   //
   // Este comando nao depende do estado do motor de passo e 
   // nao afeta o movimento do mesmo.
 
-void comando_define_max_acel(int *max_acel);
+#define formato_max_acel "ddd"
+  // Formato do argumento de {comando_define_max_acel}.
+
+void comando_define_max_acel(muff_comando_t *cmd, long *max_acel);
   // Define a aceleracao maxima {max_acel} de um motor de passo.
   // O codigo de comando deve ser seguido de 3
-  // digitos decimais, especificando a aceleracao maxima em passos / segundo^2.
-  // Converte esse valor para binário e aguarda em {*desloc}.
+  // digitos decimais, especificando a aceleracao maxima em passos inteiros
+  // / segundo^2.  Guarda esse valor {cmd->arg[0]}, convertido para 
+  // micropassos / segundo^2, em {*max_acel}.  Se o valor for nulo ou
+  // invalido, falha sem alterar {*max_acel}.
   //
-  // Se o motor de passo estiver em movimento, este comando so vai
-  // ter efeito no proximo movimento.
+  // Nao altera o motor; quem chamou deve aplicar o novo valor com
+  // {define_max_acel_motor}.
+
+#define formato_define_tranco "ddddd"
+  // Formato do argumento de {comando_define_tranco}.
+
+void comando_define_tranco(muff_comando_t *cmd, muff_motor *motor, long *tranco);
+  // Define a taxa maxima de variacao da aceleracao do {motor} 
+  // (veja {define_tranco_motor}).  O codigo de comando deve ser seguido
+  // de 5 digitos decimais, especificando o valor {cmd->arg[0]} em 
+  // passos inteiros / segundo^3; "00000" volta ao perfil de velocidade 
+  // trapezoidal.  Para o motor, se estiver em movimento.  Guarda esse 
+  // valor, convertido para micropassos / segundo^3, em {*tranco}.
+
+#define formato_define_retencao "c,ddddd"
+  // Formato dos argumentos de {comando_define_retencao}.
+
+void comando_define_retencao(muff_comando_t *cmd, long *retencao_ms);
+  // Define quanto tempo o motor continua energizado depois de parar 
+  // (veja {define_retencao_motor}).  O codigo de comando deve ser 
+  // seguido do modo {cmd->arg[0]} -- 'S' para sempre, 'T' para 
+  // {cmd->arg[1]} milissegundos, 'N' para desenergizar logo -- e de
+  // 5 digitos decimais, ignorados nos modos 'S' e 'N'.  Guarda o 
+  // tempo em {*retencao_ms}.
 
-void comando_aciona_leds(int estado, int estados_dos_leds[]);
+#define formato_define_parametro "dd,sddddddddd"
+  // Formato dos argumentos de {comando_define_parametro}.
+
+bool comando_define_parametro(muff_comando_t *cmd, muff_config_t *cfg);
+  // Define o parametro de indice {cmd->arg[0]} da configuracao {*cfg}
+  // (veja {muff_config.h}) com o valor {cmd->arg[1]}.  O codigo de
+  // comando deve ser seguido de 2 digitos decimais com o indice, e de
+  // um sinal e 9 digitos decimais com o valor; no protocolo binario
+  // o valor eh um inteiro de 32 bits qualquer.  Retorna true se o
+  // parametro foi alterado; quem chamou deve entao aplicar a nova
+  // configuracao.  Nao grava na EEPROM.
+
+#define formato_mostra_parametro "dd"
+  // Formato do argumento de {comando_mostra_parametro}.
+
+void comando_mostra_parametro(muff_comando_t *cmd, muff_config_t *cfg);
+  // Envia o valor do parametro de indice {cmd->arg[0]} (2 digitos decimais)
+  // da configuracao {*cfg}: no protocolo ASCII, como uma linha "= {valor}";
+  // no binario, como 4 bytes, o menos significativo primeiro.
+
+#define formato_configuracao "d"
+  // Formato do argumento de {comando_configuracao}.
+
+bool comando_configuracao(muff_comando_t *cmd, muff_config_t *cfg);
+  // Conforme o digito {cmd->arg[0]}: 0, recarrega da EEPROM a
+  // configuracao {*cfg} e a tabela de padroes de iluminacao; 1, grava
+  // ambas na EEPROM, se {*cfg} for valida (veja {config_valida}); 2, 
+  // volta {*cfg} aos valores padrao e apaga a tabela de padroes (sem
+  // gravar).
+  // Retorna true se {*cfg} pode ter mudado; quem chamou deve entao
+  // aplicar a nova configuracao.
+
+#define formato_define_telemetria "dddd"
+  // Formato do argumento de {comando_define_telemetria}.
+
+void comando_define_telemetria(muff_comando_t *cmd);
+  // Liga a telemetria (veja {muff_telemetria.h}) com um quadro a cada
+  // {cmd->arg[0]} milissegundos (4 digitos decimais), ou a desliga 
+  // se for "0000".
+
+#define formato_aciona_leds "c"
+  // Formato do argumento de {comando_aciona_leds}.
+
+void comando_aciona_leds(muff_comando_t *cmd, int estado, uint8_t estados_dos_leds[]);
   // Muda o estado de LED(s) para ligado (se {estado} = 1)
   // ou desligado (se {estado} = 0.
-  // O byte seguinte ao codigo do comando deve ser uma letra maiuscula identificando
+  // O byte seguinte ao codigo do comando ({cmd->arg[0]}) deve ser uma letra maiuscula identificando
   // o numero do LED ('A' = 0, 'B' = 1, etc.); ou '@' para
   // sgnificar "todos os LEDs".
 
 // DEBUGAGEM
 
-void mostra_byte(char *mensagem, int byte);
-  // Excreve na porta serial uma linha "# {mensagem} = '{c}'"
-  // onde {c} eh o caracter com codigo ASCII {byte}.
+#define formato_define_leds "xxxxxx"
+  // Formato do argumento de {comando_define_leds}.
+
+void comando_define_leds(muff_comando_t *cmd, uint8_t estados_dos_leds[]);
+  // Define o estado de todos os LEDs de uma so vez.
+  // O codigo de comando deve ser seguido de 6 digitos hexadecimais,
+  // cujo valor {cmd->arg[0]} tem o bit {k} em 1 sse o LED {k} deve ser aceso.
+  // Os novos estados sao enviados ao multiplexador uma unica vez.
+
+#define formato_define_padrao "x,xxxxxx"
+  // Formato dos argumentos de {comando_define_padrao}.
+
+void comando_define_padrao(muff_comando_t *cmd);
+  // Define um padrao da tabela de iluminacao (veja {muff_padroes.h}).
+  // O codigo de comando deve ser seguido de 1 digito hexadecimal com o
+  // indice do padrao {cmd->arg[0]}, e de 6 digitos hexadecimais com a 
+  // mascara {cmd->arg[1]}.
+
+void comando_grava_padroes(void);
+  // Grava a tabela de padroes de iluminacao na EEPROM.
+
+void comando_seleciona_padrao(int indice, uint8_t estados_dos_leds[]);
+  // Acende os LEDs do padrao de iluminacao {indice}, e apaga os outros.
+
+#define formato_define_plano "dd,ddddd"
+  // Formato dos argumentos de {comando_define_plano}.
+
+void comando_define_plano(muff_comando_t *cmd, muff_sequenciador_t *seq);
+  // Define um novo plano de captura para o sequenciador {seq}, sem
+  // condicoes de iluminacao.  O codigo do comando deve ser seguido de 
+  // 2 digitos decimais com o numero de alturas {cmd->arg[0]}, e 5 digitos 
+  // decimais com o tempo de estabilizacao {cmd->arg[1]} em milissegundos.
+  // O deslocamento entre alturas serah o definido por 
+  // {comando_define_desloc_quadro}, a menos que seja dada uma lista de
+  // deslocamentos (veja {comando_acrescenta_desloc_altura}).
+
+#define formato_acrescenta_mascara "xxxxxx"
+  // Formato do argumento de {comando_acrescenta_mascara}.
+
+void comando_acrescenta_mascara(muff_comando_t *cmd, muff_sequenciador_t *seq);
+  // Acrescenta uma condicao de iluminacao ao plano do sequenciador {seq}.
+  // O codigo do comando deve ser seguido de 6 digitos hexadecimais,
+  // cujo valor {cmd->arg[0]} tem o bit {k} em 1 sse o LED {k} deve ser aceso.
+
+#define formato_acrescenta_desloc_altura "sdddd"
+  // Formato do argumento de {comando_acrescenta_desloc_altura}.
+
+void comando_acrescenta_desloc_altura(muff_comando_t *cmd, muff_sequenciador_t *seq);
+  // Acrescenta um deslocamento a lista de deslocamentos entre alturas
+  // do plano do sequenciador {seq} (veja {muff_sequenciador.h}).  O 
+  // codigo do comando deve ser seguido de um sinal e 4 digitos decimais
+  // com o deslocamento {cmd->arg[0]} em microns, que eh convertido 
+  // para passos do motor.
+
+void comando_proxima_altura(muff_sequenciador_t *seq, muff_motor *motor, int max_vel);
+  // Move o {motor} pelo proximo deslocamento da lista do plano do 
+  // sequenciador {seq} (veja {sequenciador_proximo_desloc}), com
+  // velocidade maxima {max_vel}, em micropassos (veja 
+  // {aciona_motor_micropassos}).  Nao usa a tabela de rampa, que fica 
+  // reservada ao deslocamento do '5' (veja {comando_desloca_quadro}).
+  // Para uso quando a captura eh comandada pelo computador; nao pode
+  // ser usado com o plano em execucao.
+
+void comando_inicia_sequencia(muff_sequenciador_t *seq, long desloc, int max_vel);
+  // Comeca a executar o plano do sequenciador {seq}, deslocando 
+  // {desloc} passos com velocidade maxima {max_vel} entre alturas.
+
+void comando_quadro_tirado(muff_sequenciador_t *seq);
+  // Avisa o sequenciador {seq} de que o quadro pronto foi tirado.  Falha
+  // se nao houver quadro pronto (veja {sequenciador_quadro_tirado}).
+
+#define formato_configura_camera "ddddd,d"
+  // Formato dos argumentos de {comando_configura_camera}.
+
+void comando_configura_camera(muff_comando_t *cmd);
+  // Configura o disparo da camera (veja {muff_camera.h}).  O codigo do
+  // comando deve ser seguido de 5 digitos decimais com a largura do pulso 
+  // {cmd->arg[0]} em microssegundos (0 desabilita o disparo), e de um digito
+  // {cmd->arg[1]}, 1 se o sinal de fim de exposicao da camera deve ser usado, 
+  // 0 se nao.
+
+#define formato_inicia_varredura "dd,dddd"
+  // Formato dos argumentos de {comando_inicia_varredura}.
+
+void comando_inicia_varredura(muff_comando_t *cmd, muff_motor *motor, long desloc);
+  // Comeca uma varredura continua (veja {muff_varredura.h}) de 
+  // {cmd->arg[0]} quadros (2 digitos decimais) separados por {desloc} passos,
+  // a {cmd->arg[1]} passos/segundo (4 digitos decimais).
+
+void comando_mostra_disparos(muff_comando_t *cmd);
+  // Envia o registro de disparos da ultima varredura.  No protocolo 
+  // ASCII, eh uma linha "= {n} {d[0]} ... {d[n-1]}" em decimal; no 
+  // binario, eh um byte {n} seguido de {n} deslocamentos de 16 bits,
+  // com o byte menos significativo primeiro, logo depois da resposta 
+  // ao {cmd}.
+
+#define formato_define_protocolo "d"
+  // Formato do argumento de {comando_define_protocolo}.
+
+void comando_define_protocolo(muff_comando_t *cmd);
+  // Muda o protocolo dos comandos seguintes para binario (se o argumento
+  // {cmd->arg[0]} for 1) ou ASCII (se for 0).  Veja {muff_protocolo.h}.
+  // A resposta a este comando ainda usa o protocolo antigo.  Numa unidade
+  // com endereco (veja {protocolo_endereco}), a volta ao ASCII eh recusada.
+
+#define formato_define_velocidade_serial "ddddddd"
+  // Formato do argumento de {comando_define_velocidade_serial}.
+
+void comando_define_velocidade_serial(muff_comando_t *cmd);
+  // Muda a velocidade da porta serial para {cmd->arg[0]} bits/s, que deve
+  // ser uma das aceitas por {velocidade_serial_valida}.  A resposta a este
+  // comando (e o aviso de fim, no protocolo binario) ainda usa a 
+  // velocidade antiga; a mudanca eh feita por {atualiza_velocidade_serial}.
 
 void mostra_comando(int comando);
-  // Excreve na porta serial uma linha "# Comando recebido = '{c}'"
-  // onde {c} eh o caracter com codigo ASCII {comando}.
+  // Excreve em {muff_diag} uma linha "# Comando recebido = '{c}'"
+  // onde {c} eh o caracter com codigo ASCII {comando}
+  // (veja {aviso_comando}).
 
 #endif
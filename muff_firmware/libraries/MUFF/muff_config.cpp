@@ -0,0 +1,108 @@
+/* See {muff_config.h}. */
+
+#include "Arduino.h"
+#include <muff_utils.h>
+#include <muff_protocolo.h>
+#include <muff_config.h>
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#endif
+
+void config_padrao(muff_config_t *cfg)
+  {
+    // Valores a ajustar experimentalmente:
+    cfg->max_acel = 500L*motor1_micropassos;
+    cfg->max_vel_fino = 80*motor1_micropassos;
+    cfg->max_vel_grosso = 400*motor1_micropassos;
+    cfg->max_vel_quadro = 400*motor1_micropassos;
+    cfg->desloc_fino = 30L*motor1_micropassos;
+    cfg->desloc_grosso = 15000L*motor1_micropassos;
+    cfg->desloc_quadro = 0;
+    cfg->tranco = 0;
+    cfg->retencao_ms = 5000;
+    cfg->endereco = 0;
+  }
+
+static long *campo(muff_config_t *cfg, int indice)
+  // Endereco do parametro de numero {indice} em {*cfg}, ou NULL se invalido.
+  {
+    if ((indice < 0) || (indice >= config_num_params)) { return NULL; }
+    return ((long *)cfg) + indice;
+  }
+
+bool config_valor_valido(int indice, long valor)
+  {
+    if ((indice == config_max_acel) || (indice == config_desloc_fino) || (indice == config_desloc_grosso))
+      { return valor > 0; }
+    else if ((indice == config_max_vel_fino) || (indice == config_max_vel_grosso) || (indice == config_max_vel_quadro))
+      { return (valor > 0) && (valor <= 32767); }
+    else if (indice == config_desloc_quadro)
+      { return true; }
+    else if (indice == config_tranco)
+      { return valor >= 0; }
+    else if (indice == config_retencao)
+      { return (valor >= 0) || (valor == retencao_permanente); }
+    else if (indice == config_endereco)
+      { return (valor >= 0) && (valor <= protocolo_max_endereco); }
+    else
+      { return false; }
+  }
+
+bool config_define(muff_config_t *cfg, int indice, long valor)
+  {
+    if (! config_valor_valido(indice, valor)) { return false; }
+    (*campo(cfg, indice)) = valor;
+    return true;
+  }
+
+long config_valor(muff_config_t *cfg, int indice)
+  { return *campo(cfg, indice); }
+
+bool config_valida(muff_config_t *cfg)
+  {
+    for (int k = 0; k < config_num_params; k++)
+      { if (! config_valor_valido(k, config_valor(cfg, k))) { return false; } }
+    return true;
+  }
+
+bool config_carrega(muff_config_t *cfg)
+  {
+#if defined(__AVR__)
+    uint8_t *end = (uint8_t *)config_endereco_eeprom;
+    if (eeprom_read_word((uint16_t *)end) != config_marca) { return false; }
+    uint8_t cab[2];
+    eeprom_read_block(cab, end + 2, 2);
+    if ((cab[0] != config_versao) || (cab[1] != sizeof(muff_config_t))) { return false; }
+    muff_config_t lida;
+    eeprom_read_block(&lida, end + 4, sizeof(muff_config_t));
+    uint8_t crc = crc8_bloco(crc8_bloco(0, cab, 2), (uint8_t *)&lida, sizeof(muff_config_t));
+    if (eeprom_read_byte(end + 4 + sizeof(muff_config_t)) != crc) { return false; }
+    if (! config_valida(&lida)) { return false; }
+    (*cfg) = lida;
+    return true;
+#else
+    (void)(cfg);
+    return false;
+#endif
+  }
+
+bool config_grava(muff_config_t *cfg)
+  {
+    if (! config_valida(cfg)) { return false; }
+#if defined(__AVR__)
+    uint8_t *end = (uint8_t *)config_endereco_eeprom;
+    uint8_t cab[2] = { config_versao, sizeof(muff_config_t) };
+    uint8_t crc = crc8_bloco(crc8_bloco(0, cab, 2), (uint8_t *)cfg, sizeof(muff_config_t));
+    // Invalida o bloco antigo ateh terminar de gravar o novo:
+    eeprom_update_word((uint16_t *)end, 0xFFFF);
+    eeprom_update_block(cab, end + 2, 2);
+    eeprom_update_block(cfg, end + 4, sizeof(muff_config_t));
+    eeprom_update_byte(end + 4 + sizeof(muff_config_t), crc);
+    eeprom_update_word((uint16_t *)end, config_marca);
+    return true;
+#else
+    (void)(cfg);
+    return false;
+#endif
+  }
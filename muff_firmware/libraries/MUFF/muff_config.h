@@ -0,0 +1,112 @@
+/* Persistent motion configuration of the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_config_H
+#define muff_config_H
+
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// CONFIGURACAO DO MOVIMENTO
+
+// Os parametros do motor (aceleracao, velocidades, deslocamentos, etc.)
+// ficam num {muff_config_t}, que pode ser gravado na EEPROM e eh
+// recarregado dela quando o firmware comeca; assim o posicionador jah
+// comeca com os valores ajustados para ele, sem que o computador
+// precise reenvia-los.  Se a EEPROM nao tiver uma configuracao valida,
+// valem os valores padrao de {config_padrao}.
+//
+// Na EEPROM, a partir do endereco {config_endereco_eeprom}, a
+// configuracao eh gravada como
+//
+//   {marca[2]} {versao} {tam} {valores[tam]} {crc}
+//
+// onde {marca} eh {config_marca}, {versao} eh {config_versao}, {tam} eh
+// o numero de bytes de {muff_config_t}, {valores} sao os bytes do
+// {muff_config_t}, e {crc} eh o CRC-8 dos bytes de {versao} ateh o fim
+// de {valores} (veja {crc8_atualiza}).  Uma configuracao com marca,
+// versao, tamanho ou CRC diferentes, ou com algum valor invalido, eh
+// ignorada.
+//
+// Cada parametro tem um indice {config_*}, usado pelos comandos que
+// definem ou mostram parametros isolados.  Todos sao inteiros de 32
+// bits, na ordem dos indices; os deslocamentos estao em micropassos,
+// as velocidades em micropassos/segundo, a aceleracao em
+// micropassos/segundo^2 e o tranco em micropassos/segundo^3 (veja
+// {motor1_micropassos}).
+//
+// O endereco ({config_endereco}) so eh usado quando o firmware comeca;
+// para muda-lo, eh preciso grava-lo e reiniciar o Arduino.
+
+typedef struct muff_config_t
+  { long max_acel;        // Aceleracao maxima.
+    long max_vel_fino;    // Velocidade maxima no ajuste fino ('1', '2').
+    long max_vel_grosso;  // Velocidade maxima no ajuste grosseiro ('6', '7') e nos movimentos 'G', 'J', 'U', 'O'.
+    long max_vel_quadro;  // Velocidade maxima do deslocamento entre quadros ('5').
+    long desloc_fino;     // Deslocamento dos comandos '1', '2'.
+    long desloc_grosso;   // Deslocamento dos comandos '6', '7'.
+    long desloc_quadro;   // Deslocamento do comando '5' (veja tambem o comando '4').
+    long tranco;          // Tranco maximo, ou 0 para perfil trapezoidal (veja {define_tranco_motor}).
+    long retencao_ms;     // Tempo de retencao do motor parado (veja {define_retencao_motor}).
+    long endereco;        // Endereco da unidade na linha serial, ou 0 se nenhum (veja {muff_protocolo.h}).
+  } muff_config_t;
+  // Parametros do motor de passo principal.
+
+#define config_max_acel (0)
+#define config_max_vel_fino (1)
+#define config_max_vel_grosso (2)
+#define config_max_vel_quadro (3)
+#define config_desloc_fino (4)
+#define config_desloc_grosso (5)
+#define config_desloc_quadro (6)
+#define config_tranco (7)
+#define config_retencao (8)
+#define config_endereco (9)
+  // Indices dos campos de {muff_config_t}.
+
+#define config_num_params (10)
+  // Numero de parametros em {muff_config_t}.
+
+#define config_endereco_eeprom (80)
+  // Endereco da configuracao na EEPROM (depois da tabela de {muff_padroes.h}).
+
+#define config_marca (0x4D43)
+  // Marca gravada no inicio da configuracao na EEPROM.
+
+#define config_versao (2)
+  // Versao do formato de {muff_config_t}; deve mudar quando ele mudar.
+
+void config_padrao(muff_config_t *cfg);
+  // Define todos os parametros de {*cfg} com os valores padrao.
+
+bool config_carrega(muff_config_t *cfg);
+  // Le a configuracao gravada na EEPROM para {*cfg}.  Retorna false,
+  // sem alterar {*cfg}, se a configuracao gravada nao for valida ou
+  // se o processador nao tiver EEPROM.
+
+bool config_grava(muff_config_t *cfg);
+  // Grava a configuracao {*cfg} na EEPROM.  Retorna false, sem gravar,
+  // se {*cfg} nao for valida (e portanto nao seria recarregada por
+  // {config_carrega}), ou se o processador nao tiver EEPROM.
+
+bool config_valida(muff_config_t *cfg);
+  // Retorna true se todos os parametros de {*cfg} forem validos 
+  // (veja {config_valor_valido}).
+
+bool config_define(muff_config_t *cfg, int indice, long valor);
+  // Define o parametro de numero {indice} de {*cfg} como {valor}.
+  // Retorna false, sem alterar {*cfg}, se {indice} ou {valor}
+  // forem invalidos (veja {config_valor_valido}).
+
+long config_valor(muff_config_t *cfg, int indice);
+  // Retorna o valor do parametro de numero {indice} de {*cfg},
+  // que deve ser valido.
+
+bool config_valor_valido(int indice, long valor);
+  // Retorna true se {valor} for valido para o parametro {indice}:
+  // positivo para a aceleracao e os deslocamentos '1', '2', '6' e '7';
+  // de 1 a 32767 para as velocidades; qualquer para o deslocamento
+  // entre quadros; nao negativo para o tranco; nao negativo ou
+  // {retencao_permanente} para a retencao; e de 0 a
+  // {protocolo_max_endereco} para o endereco.
+
+#endif
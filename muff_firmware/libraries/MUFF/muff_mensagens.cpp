@@ -0,0 +1,236 @@
+/* See {muff_mensagens.h}. */
+
+#include "Arduino.h"
+#include <muff_mensagens.h>
+
+class muff_saida_nula_t : public Print
+  // Destino de mensagens que descarta tudo.
+  { public:
+      virtual size_t write(uint8_t byte) { (void)(byte); return 1; }
+  };
+
+static muff_saida_nula_t saida_nula;
+
+Print *muff_diag = &Serial;
+
+static bool erro_pendente = false;
+  // True se houve chamada de {muff_erro} ainda nao consultada.
+
+void muff_define_diagnosticos(bool ligados)
+  {
+    if (ligados)
+      { muff_diag = &Serial; }
+    else
+      { muff_diag = &saida_nula; }
+  }
+
+bool muff_houve_erro(void)
+  { bool houve = erro_pendente;
+    erro_pendente = false;
+    return houve;
+  }
+
+bool muff_erro_anotado(void)
+  { return erro_pendente; }
+
+void muff_esquece_erro(void)
+  { erro_pendente = false; }
+
+void muff_erro(int codigo)
+  { muff_mostra_erro(codigo);
+    erro_pendente = true;
+  }
+
+#if muff_verbosidade >= 2
+
+static void escreve_texto(PGM_P texto, long a, long b, long c)
+  // Escreve em {muff_diag} o {texto}, que estah na memoria de programa,
+  // substituindo os "%d", "%x" e "%c" pelos valores {a}, {b} e {c}.
+  {
+    long vals[3] = { a, b, c };
+    int iv = 0;
+    char ch;
+    while ((ch = pgm_read_byte(texto)) != 0)
+      { texto++;
+        char tipo = (ch == '%' ? pgm_read_byte(texto) : 0);
+        if (((tipo == 'd') || (tipo == 'x') || (tipo == 'c')) && (iv < 3))
+          { long v = vals[iv]; iv++;
+            if (tipo == 'd')
+              { muff_diag->print(v); }
+            else if (tipo == 'x')
+              { muff_diag->print(v, HEX); }
+            else
+              { muff_diag->print((char)(v & 255)); }
+            texto++;
+          }
+        else
+          { muff_diag->print(ch); }
+      }
+  }
+
+// -----------------------------------------------------------
+// TEXTOS DAS MENSAGENS DE ERRO
+
+static const char e_comando_invalido[] PROGMEM = "comando invalido";
+static const char e_unidade[] PROGMEM = "argumentos invalidos - unidade deve ser 'P' ou 'N'";
+static const char e_velocidade[] PROGMEM = "velocidade invalida";
+static const char e_fila_cheia[] PROGMEM = "fila de movimentos cheia";
+static const char e_destino_busca[] PROGMEM = "posicao final deve ser negativa ou zero";
+static const char e_sem_perfil[] PROGMEM = "medidas de tempo desabilitadas - veja {muff_usa_perfil}";
+static const char e_valor[] PROGMEM = "valor invalido";
+static const char e_tranco[] PROGMEM = "valor invalido - deve ser '00000' a '99999'";
+static const char e_retencao[] PROGMEM = "argumentos invalidos - modo deve ser 'S', 'T' ou 'N'";
+static const char e_telemetria[] PROGMEM = "valor invalido - deve ser '0000' a '9999'";
+static const char e_acel[] PROGMEM = "valor invalido - deve ser '000' a '999'";
+static const char e_acel_nula[] PROGMEM = "aceleracao maxima nao pode ser nula";
+static const char e_led[] PROGMEM = "codigo de LED invalido";
+static const char e_mascara[] PROGMEM = "mascara de LEDs invalida";
+static const char e_padrao[] PROGMEM = "indice de padrao invalido";
+static const char e_eeprom[] PROGMEM = "EEPROM indisponivel";
+static const char e_plano_ativo[] PROGMEM = "plano em execucao";
+static const char e_plano[] PROGMEM = "plano invalido";
+static const char e_excesso_mascaras[] PROGMEM = "excesso de condicoes de iluminacao";
+static const char e_plano_jah_ativo[] PROGMEM = "plano jah em execucao";
+static const char e_plano_vazio[] PROGMEM = "plano vazio";
+static const char e_sem_plano[] PROGMEM = "nenhum plano em execucao";
+static const char e_camera[] PROGMEM = "configuracao invalida";
+static const char e_argumentos[] PROGMEM = "argumentos invalidos";
+static const char e_varredura[] PROGMEM = "varredura invalida ou motor em movimento";
+static const char e_protocolo[] PROGMEM = "protocolo invalido - deve ser 0 (ASCII) ou 1 (binario)";
+static const char e_sem_perfil_s[] PROGMEM = "perfil em S nao disponivel";
+static const char e_chave_nao_encontrada[] PROGMEM = "chave de fim de curso nao encontrada";
+static const char e_chave_nao_liberada[] PROGMEM = "chave de fim de curso nao liberada";
+static const char e_chave_acionada[] PROGMEM = "chave de fim de curso acionada";
+static const char e_velocidade_serial[] PROGMEM = "velocidade da porta serial invalida";
+static const char e_parametro[] PROGMEM = "parametro ou valor invalido";
+static const char e_config[] PROGMEM = "configuracao invalida ou ausente na EEPROM";
+static const char e_excesso_alturas[] PROGMEM = "deslocamento invalido ou excesso de deslocamentos entre alturas";
+static const char e_lista_alturas[] PROGMEM = "lista de deslocamentos menor que o plano";
+static const char e_fim_alturas[] PROGMEM = "lista de deslocamentos vazia ou esgotada";
+static const char e_movimento_adiado[] PROGMEM = "motor parando para iniciar outro movimento";
+static const char e_alvo_fracionario[] PROGMEM = "alvo fora dos passos inteiros do movimento corrente";
+static const char e_sem_fila[] PROGMEM = "fila de movimentos nao disponivel";
+static const char e_quadro_nao_pronto[] PROGMEM = "nenhum quadro pronto esperando ser tirado";
+
+static PGM_P const textos_erros[num_erros] PROGMEM =
+  { NULL,
+    e_comando_invalido, e_unidade, e_velocidade, e_fila_cheia, e_destino_busca,
+    e_sem_perfil, e_valor, e_tranco, e_retencao, e_telemetria,
+    e_acel, e_acel_nula, e_led, e_mascara, e_padrao,
+    e_eeprom, e_plano_ativo, e_plano, e_excesso_mascaras, e_plano_jah_ativo,
+    e_plano_vazio, e_sem_plano, e_camera, e_argumentos, e_varredura,
+    e_protocolo, e_sem_perfil_s, e_chave_nao_encontrada, e_chave_nao_liberada, e_chave_acionada,
+    e_velocidade_serial, e_parametro, e_config, e_excesso_alturas, e_lista_alturas,
+    e_fim_alturas, e_movimento_adiado, e_alvo_fracionario, e_sem_fila,
+    e_quadro_nao_pronto
+  };
+  // Textos das mensagens de erro, indexados pelos codigos {erro_*}.
+
+#endif
+
+void muff_mostra_erro(int codigo)
+  {
+#if muff_verbosidade >= 1
+    muff_diag->print(F("# ** "));
+    muff_diag->print(codigo);
+#if muff_verbosidade >= 2
+    if ((codigo > 0) && (codigo < num_erros))
+      { muff_diag->print(' ');
+        escreve_texto((PGM_P)pgm_read_ptr(&(textos_erros[codigo])), 0, 0, 0);
+      }
+#endif
+    muff_diag->println();
+#else
+    (void)(codigo);
+#endif
+  }
+
+#if muff_verbosidade >= 3
+
+// -----------------------------------------------------------
+// TEXTOS DAS MENSAGENS DE DIAGNOSTICO
+
+static const char a_teste[] PROGMEM = "Teste 123....";
+static const char a_digite[] PROGMEM = "Digite comando ('1', '2', etc) e clique em ENVIAR...";
+static const char a_comando[] PROGMEM = "Comando recebido = '%c' = chr(%d)";
+static const char a_girando_horario[] PROGMEM = "Girando o motor no sentido horario por %d passos, vel max %d passos/seg";
+static const char a_girando_anti_horario[] PROGMEM = "Girando o motor no sentido anti-horario por %d passos, vel max %d passos/seg";
+static const char a_quadro[] PROGMEM = "Deslocando o motor por %d passos (quadro)";
+static const char a_parando[] PROGMEM = "Parando o motor...";
+static const char a_interrompendo[] PROGMEM = "Parando o motor sem desacelerar!";
+static const char a_movendo_para[] PROGMEM = "Movendo o motor para a posicao %d passos";
+static const char a_movendo_por[] PROGMEM = "Movendo o motor por %d passos";
+static const char a_enfileirando[] PROGMEM = "Enfileirando movimento para a posicao %d passos a %d passos/s";
+static const char a_zerando[] PROGMEM = "Definindo a posicao corrente como zero";
+static const char a_define_desloc[] PROGMEM = "Definindo o deslocamento padrao entre quadros";
+static const char a_desloc[] PROGMEM = "Argumento = %d microns = %d passos";
+static const char a_define_tranco[] PROGMEM = "Definindo o tranco maximo";
+static const char a_tranco_nulo[] PROGMEM = "Argumento = 0 (perfil trapezoidal)";
+static const char a_tranco[] PROGMEM = "Argumento = %d passos inteiros/seg^3";
+static const char a_define_retencao[] PROGMEM = "Definindo a retencao do motor parado";
+static const char a_sempre_energizado[] PROGMEM = "Motor sempre energizado";
+static const char a_desenergiza[] PROGMEM = "Desenergiza o motor %d ms depois de parar";
+static const char a_define_telemetria[] PROGMEM = "Definindo o periodo da telemetria";
+static const char a_telemetria_desligada[] PROGMEM = "Telemetria desligada";
+static const char a_telemetria[] PROGMEM = "Um quadro a cada %d ms";
+static const char a_define_acel[] PROGMEM = "Definindo a aceleracao maxima";
+static const char a_acel[] PROGMEM = "Argumento = %d passos inteiros/seg^2";
+static const char a_ligando_leds[] PROGMEM = "Ligando LED(s)";
+static const char a_desligando_leds[] PROGMEM = "Desligando LED(s)";
+static const char a_codigo_led[] PROGMEM = "codigo do(s) LED(s) = '%c' = chr(%d)";
+static const char a_define_leds[] PROGMEM = "Definindo os estados de todos os LEDs";
+static const char a_mascara[] PROGMEM = "Mascara = %x";
+static const char a_define_padrao[] PROGMEM = "Definindo padrao de iluminacao";
+static const char a_padrao[] PROGMEM = "Padrao %d = %x";
+static const char a_grava_padroes[] PROGMEM = "Gravando os padroes de iluminacao na EEPROM";
+static const char a_seleciona_padrao[] PROGMEM = "Acendendo o padrao de iluminacao %d";
+static const char a_define_plano[] PROGMEM = "Definindo o plano de captura";
+static const char a_plano[] PROGMEM = "Alturas = %d estabilizacao = %d ms";
+static const char a_condicao[] PROGMEM = "Condicao de iluminacao %d = %x";
+static const char a_inicia_captura[] PROGMEM = "Iniciando a captura, %d passos entre alturas";
+static const char a_quadro_pronto[] PROGMEM = "Quadro pronto: H = %d L = %d";
+static const char a_configura_camera[] PROGMEM = "Configurando o disparo da camera";
+static const char a_camera_exposicao[] PROGMEM = "Pulso = %d us, sinal de exposicao usado";
+static const char a_camera_sem_exposicao[] PROGMEM = "Pulso = %d us, sinal de exposicao ignorado";
+static const char a_inicia_varredura[] PROGMEM = "Iniciando a varredura continua";
+static const char a_varredura[] PROGMEM = "Quadros = %d espacamento = %d passos, vel = %d passos/seg";
+static const char a_binario[] PROGMEM = "Passando para o protocolo binario";
+static const char a_ascii[] PROGMEM = "Passando para o protocolo ASCII";
+static const char a_procurando_chave[] PROGMEM = "Procurando a chave de fim de curso";
+static const char a_recuando_chave[] PROGMEM = "Recuando da chave de fim de curso";
+static const char a_origem_chave[] PROGMEM = "Origem definida na chave de fim de curso";
+static const char a_velocidade_serial[] PROGMEM = "Passando a porta serial para %d bits/s";
+static const char a_parametro[] PROGMEM = "Parametro %d = %d";
+static const char a_carrega_config[] PROGMEM = "Carregando a configuracao e os padroes de iluminacao da EEPROM";
+static const char a_grava_config[] PROGMEM = "Gravando a configuracao e os padroes de iluminacao na EEPROM";
+static const char a_config_padrao[] PROGMEM = "Voltando a configuracao padrao";
+static const char a_desloc_altura[] PROGMEM = "Deslocamento entre alturas %d = %d microns = %d passos";
+static const char a_proxima_altura[] PROGMEM = "Deslocamento %d da lista, %d passos";
+static const char a_duracao[] PROGMEM = "Movimento de %d passos, vel max %d passos/seg, levaria %d us";
+
+static PGM_P const textos_avisos[num_avisos] PROGMEM =
+  { NULL,
+    a_teste, a_digite, a_comando, a_girando_horario, a_girando_anti_horario,
+    a_quadro, a_parando, a_interrompendo, a_movendo_para, a_movendo_por,
+    a_enfileirando, a_zerando, a_define_desloc, a_desloc, a_define_tranco,
+    a_tranco_nulo, a_tranco, a_define_retencao, a_sempre_energizado, a_desenergiza,
+    a_define_telemetria, a_telemetria_desligada, a_telemetria, a_define_acel, a_acel,
+    a_ligando_leds, a_desligando_leds, a_codigo_led, a_define_leds, a_mascara,
+    a_define_padrao, a_padrao, a_grava_padroes, a_seleciona_padrao, a_define_plano,
+    a_plano, a_condicao, a_inicia_captura, a_quadro_pronto, a_configura_camera,
+    a_camera_exposicao, a_camera_sem_exposicao, a_inicia_varredura, a_varredura, a_binario,
+    a_ascii, a_procurando_chave, a_recuando_chave, a_origem_chave, a_velocidade_serial, a_parametro,
+    a_carrega_config, a_grava_config, a_config_padrao, a_desloc_altura,
+    a_proxima_altura, a_duracao
+  };
+  // Textos das mensagens de diagnostico, indexados pelos codigos {aviso_*}.
+
+void muff_aviso(int codigo, long a, long b, long c)
+  {
+    if ((codigo <= 0) || (codigo >= num_avisos)) { return; }
+    muff_diag->print(F("# "));
+    escreve_texto((PGM_P)pgm_read_ptr(&(textos_avisos[codigo])), a, b, c);
+    muff_diag->println();
+  }
+
+#endif
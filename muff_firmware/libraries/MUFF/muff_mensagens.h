@@ -0,0 +1,192 @@
+/* Diagnostic and error messages of the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_mensagens_H
+#define muff_mensagens_H
+
+#include <Arduino.h>
+
+// -----------------------------------------------------------
+// MENSAGENS
+
+// As mensagens de diagnostico ("# ...") e de erro ("# ** ...") sao
+// identificadas por codigos numericos, {aviso_*} e {erro_*} abaixo.
+// Os textos correspondentes ficam numa tabela na memoria de programa
+// (flash), e nao ocupam a RAM.  Um texto pode conter "%d", "%x" ou
+// "%c", que sao substituidos pelos valores dados, em ordem, em decimal,
+// hexadecimal ou como caracter.
+//
+// O nivel {muff_verbosidade} define, na compilacao, quais mensagens
+// existem:
+//
+//   0  nenhuma: os erros sao apenas anotados (veja {muff_houve_erro});
+//   1  apenas erros, como "# ** {codigo}", sem os textos;
+//   2  apenas erros, como "# ** {codigo} {texto}";
+//   3  erros como no nivel 2, e todas as mensagens de diagnostico.
+//
+// Abaixo de 3, os textos omitidos nao sao compilados, e as chamadas
+// correspondentes nao custam nada.
+
+#ifndef muff_verbosidade
+#define muff_verbosidade (3)
+#endif
+  // Nivel de verbosidade das mensagens, de 0 a 3.
+
+extern Print *muff_diag;
+  // Destino das mensagens de diagnostico e de erro. Normalmente eh a
+  // porta serial, mas pode ser um destino que descarta tudo
+  // (veja {muff_define_diagnosticos}).
+
+void muff_define_diagnosticos(bool ligados);
+  // Se {ligados} for true, as mensagens passam a ser escritas
+  // na porta serial; senao, passam a ser descartadas.
+
+void muff_erro(int codigo);
+  // Escreve em {muff_diag} a mensagem de erro {codigo} (veja
+  // {muff_mostra_erro}), e anota que houve erro (veja {muff_houve_erro}).
+  // NAO termina o programa.
+
+void muff_mostra_erro(int codigo);
+  // Escreve em {muff_diag} a mensagem de erro {codigo}, conforme
+  // {muff_verbosidade}, sem anotar o erro.
+
+bool muff_houve_erro(void);
+  // Retorna true se {muff_erro} foi chamada desde a ultima
+  // chamada desta funcao (ou de {muff_esquece_erro}), e limpa essa anotacao.
+
+bool muff_erro_anotado(void);
+  // Retorna true se {muff_erro} foi chamada desde a ultima chamada de
+  // {muff_houve_erro} ou {muff_esquece_erro}, sem limpar essa anotacao.
+
+void muff_esquece_erro(void);
+  // Limpa a anotacao de erro, sem consulta-la.  Deve ser chamada quando
+  // um comando comeca, para que sua resposta so reflita os erros dele, e
+  // nao os de atividades em segundo plano desde o comando anterior.
+
+#if muff_verbosidade >= 3
+
+void muff_aviso(int codigo, long a = 0, long b = 0, long c = 0);
+  // Escreve em {muff_diag} uma linha "# {texto}", onde {texto} eh o
+  // da mensagem de diagnostico {codigo}, com os valores {a}, {b} e {c}
+  // nos lugares de "%d", "%x" ou "%c".
+
+#else
+
+inline void muff_aviso(int codigo, long a = 0, long b = 0, long c = 0)
+  { (void)(codigo); (void)(a); (void)(b); (void)(c); }
+
+#endif
+
+// -----------------------------------------------------------
+// CODIGOS DE ERRO
+
+#define erro_comando_invalido (1)
+#define erro_unidade (2)
+#define erro_velocidade (3)
+#define erro_fila_cheia (4)
+#define erro_destino_busca (5)
+#define erro_sem_perfil (6)
+#define erro_valor (7)
+#define erro_tranco (8)
+#define erro_retencao (9)
+#define erro_telemetria (10)
+#define erro_acel (11)
+#define erro_acel_nula (12)
+#define erro_led (13)
+#define erro_mascara (14)
+#define erro_padrao (15)
+#define erro_eeprom (16)
+#define erro_plano_ativo (17)
+#define erro_plano (18)
+#define erro_excesso_mascaras (19)
+#define erro_plano_jah_ativo (20)
+#define erro_plano_vazio (21)
+#define erro_sem_plano (22)
+#define erro_camera (23)
+#define erro_argumentos (24)
+#define erro_varredura (25)
+#define erro_protocolo (26)
+#define erro_sem_perfil_s (27)
+#define erro_chave_nao_encontrada (28)
+#define erro_chave_nao_liberada (29)
+#define erro_chave_acionada (30)
+#define erro_velocidade_serial (31)
+#define erro_parametro (32)
+#define erro_config (33)
+#define erro_excesso_alturas (34)
+#define erro_lista_alturas (35)
+#define erro_fim_alturas (36)
+#define erro_movimento_adiado (37)
+#define erro_alvo_fracionario (38)
+#define erro_sem_fila (39)
+#define erro_quadro_nao_pronto (40)
+  // Codigos das mensagens de erro.  Os textos estao em {muff_mensagens.cpp}.
+
+#define num_erros (41)
+  // Numero de codigos de erro, mais 1.
+
+// -----------------------------------------------------------
+// CODIGOS DAS MENSAGENS DE DIAGNOSTICO
+
+#define aviso_teste (1)
+#define aviso_digite (2)
+#define aviso_comando (3)
+#define aviso_girando_horario (4)
+#define aviso_girando_anti_horario (5)
+#define aviso_quadro (6)
+#define aviso_parando (7)
+#define aviso_interrompendo (8)
+#define aviso_movendo_para (9)
+#define aviso_movendo_por (10)
+#define aviso_enfileirando (11)
+#define aviso_zerando (12)
+#define aviso_define_desloc (13)
+#define aviso_desloc (14)
+#define aviso_define_tranco (15)
+#define aviso_tranco_nulo (16)
+#define aviso_tranco (17)
+#define aviso_define_retencao (18)
+#define aviso_sempre_energizado (19)
+#define aviso_desenergiza (20)
+#define aviso_define_telemetria (21)
+#define aviso_telemetria_desligada (22)
+#define aviso_telemetria (23)
+#define aviso_define_acel (24)
+#define aviso_acel (25)
+#define aviso_ligando_leds (26)
+#define aviso_desligando_leds (27)
+#define aviso_codigo_led (28)
+#define aviso_define_leds (29)
+#define aviso_mascara (30)
+#define aviso_define_padrao (31)
+#define aviso_padrao (32)
+#define aviso_grava_padroes (33)
+#define aviso_seleciona_padrao (34)
+#define aviso_define_plano (35)
+#define aviso_plano (36)
+#define aviso_condicao (37)
+#define aviso_inicia_captura (38)
+#define aviso_quadro_pronto (39)
+#define aviso_configura_camera (40)
+#define aviso_camera_exposicao (41)
+#define aviso_camera_sem_exposicao (42)
+#define aviso_inicia_varredura (43)
+#define aviso_varredura (44)
+#define aviso_binario (45)
+#define aviso_ascii (46)
+#define aviso_procurando_chave (47)
+#define aviso_recuando_chave (48)
+#define aviso_origem_chave (49)
+#define aviso_velocidade_serial (50)
+#define aviso_parametro (51)
+#define aviso_carrega_config (52)
+#define aviso_grava_config (53)
+#define aviso_config_padrao (54)
+#define aviso_desloc_altura (55)
+#define aviso_proxima_altura (56)
+#define aviso_duracao (57)
+  // Codigos das mensagens de diagnostico.  Os textos estao em {muff_mensagens.cpp}.
+
+#define num_avisos (58)
+  // Numero de codigos de mensagens de diagnostico, mais 1.
+
+#endif
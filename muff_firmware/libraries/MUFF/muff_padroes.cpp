@@ -0,0 +1,64 @@
+/* See {muff_padroes.h}. */
+
+#include "Arduino.h"
+#include <muff_utils.h>
+#include <muff_protocolo.h>
+#include <muff_padroes.h>
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#endif
+
+static uint32_t padroes[max_padroes_leds];
+  // Mascaras dos padroes.
+
+void padroes_apaga(void)
+  {
+    for (int k = 0; k < max_padroes_leds; k++) { padroes[k] = 0; }
+  }
+
+void inicializa_padroes(void)
+  {
+#if defined(__AVR__)
+    uint8_t *end = (uint8_t *)padroes_endereco_eeprom;
+    if (eeprom_read_word((uint16_t *)end) == padroes_marca)
+      { uint8_t cab[2];
+        eeprom_read_block(cab, end + 2, 2);
+        if ((cab[0] == padroes_versao) && (cab[1] == sizeof(padroes)))
+          { // Le direto para a tabela, e a apaga se o CRC nao conferir:
+            eeprom_read_block(padroes, end + 4, sizeof(padroes));
+            uint8_t crc = crc8_bloco(crc8_bloco(0, cab, 2), (uint8_t *)padroes, sizeof(padroes));
+            if (eeprom_read_byte(end + 4 + sizeof(padroes)) == crc) { return; }
+          }
+      }
+#endif
+    padroes_apaga();
+  }
+
+bool padrao_define(int indice, uint32_t mascara)
+  {
+    if ((indice < 0) || (indice >= max_padroes_leds)) { return false; }
+    padroes[indice] = mascara;
+    return true;
+  }
+
+uint32_t padrao_mascara(int indice)
+  { return padroes[indice]; }
+
+bool padroes_grava(void)
+  {
+#if defined(__AVR__)
+    uint8_t *end = (uint8_t *)padroes_endereco_eeprom;
+    uint8_t cab[2] = { padroes_versao, sizeof(padroes) };
+    uint8_t crc = crc8_bloco(crc8_bloco(0, cab, 2), (uint8_t *)padroes, sizeof(padroes));
+    // Invalida a tabela antiga ateh terminar de gravar a nova:
+    eeprom_update_word((uint16_t *)end, 0xFFFF);
+    eeprom_update_block(cab, end + 2, 2);
+    eeprom_update_block(padroes, end + 4, sizeof(padroes));
+    eeprom_update_byte(end + 4 + sizeof(padroes), crc);
+    eeprom_update_word((uint16_t *)end, padroes_marca);
+    return true;
+#else
+    return false;
+#endif
+  }
@@ -0,0 +1,60 @@
+/* Table of LED lighting patterns for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_padroes_H
+#define muff_padroes_H
+
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// TABELA DE PADROES DE ILUMINACAO
+
+// O firmware guarda uma tabela de {max_padroes_leds} padroes de 
+// iluminacao, cada um uma mascara de 24 bits (bit {k} = LED {k}).
+// Os padroes sao enviados pelo computador uma vez por sessao, e 
+// podem ser gravados na EEPROM, de onde sao recarregados quando o
+// firmware comeca.  Depois disso, um unico byte de comando
+// ('a' para o padrao 0, 'b' para o 1, etc.) acende o padrao escolhido.
+//
+// Na EEPROM, a partir do endereco {padroes_endereco_eeprom}, a tabela
+// eh gravada no mesmo formato da configuracao (veja {muff_config.h}):
+//
+//   {marca[2]} {versao} {tam} {mascaras[tam]} {crc}
+//
+// onde {marca} eh {padroes_marca}, {versao} eh {padroes_versao}, {tam}
+// eh o numero de bytes da tabela, e {crc} eh o CRC-8 dos bytes de 
+// {versao} ateh o fim de {mascaras}.  Uma tabela com marca, versao,
+// tamanho ou CRC diferentes eh ignorada.
+
+#define max_padroes_leds (16)
+  // Numero de padroes na tabela.
+
+#define padroes_endereco_eeprom (0)
+  // Endereco da tabela na EEPROM.  Ocupa {4*max_padroes_leds + 5}
+  // bytes, que devem caber antes de {config_endereco_eeprom}.
+
+#define padroes_marca (0x4D50)
+  // Marca gravada no inicio da tabela na EEPROM.
+
+#define padroes_versao (1)
+  // Versao do formato da tabela; deve mudar quando ele mudar.
+
+void inicializa_padroes(void);
+  // Carrega a tabela de padroes da EEPROM, se ela tiver sido gravada e
+  // for valida; senao, apaga a tabela (veja {padroes_apaga}).
+
+void padroes_apaga(void);
+  // Deixa todos os padroes com todos os LEDs apagados, sem gravar.
+
+bool padrao_define(int indice, uint32_t mascara);
+  // Define o padrao de numero {indice} (de 0 a {max_padroes_leds-1}) 
+  // como a {mascara}.  Retorna false se o {indice} for invalido.
+
+uint32_t padrao_mascara(int indice);
+  // Retorna a mascara do padrao de numero {indice}.
+
+bool padroes_grava(void);
+  // Grava a tabela na EEPROM.  Retorna false se o processador nao 
+  // tiver EEPROM.  A marca eh apagada antes e regravada por ultimo, de 
+  // modo que uma gravacao interrompida deixa a tabela invalida.
+
+#endif
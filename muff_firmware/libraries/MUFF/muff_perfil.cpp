@@ -0,0 +1,127 @@
+/* See {muff_perfil.h}. */
+
+#include "Arduino.h"
+#include <muff_perfil.h>
+
+#if muff_usa_perfil
+
+#include <muff_protocolo.h>
+
+typedef struct muff_medida_t
+  { unsigned long n;     // Numero de amostras.
+    unsigned long min;   // Menor amostra.
+    unsigned long max;   // Maior amostra.
+    unsigned long soma;  // Soma das amostras.
+  } muff_medida_t;
+  // Resumo das amostras de uma medida.
+
+static volatile muff_medida_t medidas[perfil_num_medidas];
+  // Resumos das medidas, por indice.
+
+static volatile unsigned long faixas[perfil_num_faixas];
+  // Histograma dos atrasos dos passos.
+
+static unsigned long inicio_volta = 0;
+  // Valor de {micros()} no inicio da volta corrente do loop, ou 0 antes da primeira.
+
+static unsigned long ultimo_passo = 0;
+static bool ultimo_passo_vale = false;
+  // Instante do ultimo passo dado por {motor->run()}, se o motor nao parou desde entao.
+
+static void zera_medidas(void)
+  // Zera todas as medidas e o histograma.
+  {
+    for (int m = 0; m < perfil_num_medidas; m++)
+      { medidas[m].n = 0; medidas[m].min = 0xFFFFFFFFUL; medidas[m].max = 0; medidas[m].soma = 0; }
+    for (int k = 0; k < perfil_num_faixas; k++) { faixas[k] = 0; }
+  }
+
+void inicializa_perfil(void)
+  {
+    noInterrupts();
+    zera_medidas();
+    interrupts();
+  }
+
+void perfil_mede(int medida, unsigned long us)
+  {
+    uint8_t sreg = SREG;
+    noInterrupts();
+    volatile muff_medida_t *md = &(medidas[medida]);
+    md->n++;
+    if (us < md->min) { md->min = us; }
+    if (us > md->max) { md->max = us; }
+    md->soma += us;
+    if (medida == perfil_atraso)
+      { int k = 0;
+        while ((k < perfil_num_faixas - 1) && ((us >> (k + 2)) != 0)) { k++; }
+        faixas[k]++;
+      }
+    SREG = sreg;
+  }
+
+unsigned long perfil_marca(void)
+  { return micros(); }
+
+void perfil_mede_desde(int medida, unsigned long t0)
+  { perfil_mede(medida, micros() - t0); }
+
+void perfil_inicio_volta(void)
+  {
+    unsigned long t = micros();
+    if (inicio_volta != 0) { perfil_mede(perfil_volta, t - inicio_volta); }
+    inicio_volta = t;
+  }
+
+void perfil_passo(bool deu_passo, unsigned long t, unsigned long intervalo)
+  {
+    if (intervalo == 0) { ultimo_passo_vale = false; return; }
+    if (! deu_passo) { return; }
+    if (ultimo_passo_vale)
+      { unsigned long decorrido = t - ultimo_passo;
+        perfil_mede(perfil_atraso, (decorrido > intervalo ? decorrido - intervalo : 0));
+      }
+    ultimo_passo = t;
+    ultimo_passo_vale = true;
+  }
+
+static void envia_valor(unsigned long val, bool primeiro)
+  // Envia {val} pela porta serial como 4 bytes, no protocolo binario,
+  // ou em decimal depois de "= " ou de um branco, no ASCII.
+  {
+    if (protocolo_binario())
+      { for (int k = 0; k < 4; k++) { Serial.write((uint8_t)((val >> (8*k)) & 255)); } }
+    else
+      { if (primeiro) { Serial.print(F("= ")); } else { Serial.print(' '); }
+        Serial.print(val);
+      }
+  }
+
+void perfil_relata(void)
+  {
+    // Copia e zera as medidas sem deixar a interrupcao mexer no meio:
+    muff_medida_t copia[perfil_num_medidas];
+    unsigned long hist[perfil_num_faixas];
+    noInterrupts();
+    for (int m = 0; m < perfil_num_medidas; m++)
+      { copia[m].n = medidas[m].n; copia[m].min = medidas[m].min;
+        copia[m].max = medidas[m].max; copia[m].soma = medidas[m].soma;
+      }
+    for (int k = 0; k < perfil_num_faixas; k++) { hist[k] = faixas[k]; }
+    zera_medidas();
+    interrupts();
+
+    bool binario = protocolo_binario();
+    for (int m = 0; m < perfil_num_medidas; m++)
+      { muff_medida_t *md = &(copia[m]);
+        envia_valor(md->n, true);
+        envia_valor((md->n == 0 ? 0 : md->min), false);
+        envia_valor(md->max, false);
+        envia_valor((md->n == 0 ? 0 : md->soma/md->n), false);
+        if (! binario) { Serial.println(); }
+      }
+    for (int k = 0; k < perfil_num_faixas; k++) { envia_valor(hist[k], (k == 0)); }
+    if (! binario) { Serial.println(); }
+  }
+
+#endif
@@ -0,0 +1,93 @@
+/* Timing instrumentation for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_perfil_H
+#define muff_perfil_H
+
+#include <Arduino.h>
+
+// -----------------------------------------------------------
+// MEDIDAS DE TEMPO
+
+// Se {muff_usa_perfil} for 1, o firmware mede com {micros()} a duracao
+// de cada volta do loop principal, da geracao de passos do motor, da
+// execucao de cada comando e da atualizacao dos LEDs, e tambem o
+// atraso de cada passo do motor em relacao ao instante programado
+// (o intervalo {stepInterval()} depois do passo anterior).  Com o
+// temporizador (veja {muff_temporizador.h}), o atraso eh a latencia
+// da interrupcao, lida no contador do Timer1, e a geracao de passos
+// eh a propria interrupcao.
+//
+// Para cada medida sao guardados o numero de amostras, o minimo, o
+// maximo e a soma (para a media).  Os atrasos dos passos sao tambem
+// contados num histograma de {perfil_num_faixas} faixas: a faixa 0 vai
+// de 0 a 3 microssegundos, e a faixa {k > 0} de {2^(k+1)} a
+// {2^(k+2)-1}, exceto a ultima, que inclui todos os atrasos maiores.
+//
+// As medidas custam algumas dezenas de microssegundos por volta do
+// loop; com {muff_usa_perfil} igual a 0 as funcoes abaixo sao vazias
+// e nao custam nada.
+
+#ifndef muff_usa_perfil
+#define muff_usa_perfil (0)
+#endif
+  // Se 1, o firmware faz as medidas descritas acima.
+
+#define perfil_volta (0)   // Duracao de uma volta do loop principal.
+#define perfil_passos (1)  // Duracao de {motor_gera_passos} ou da interrupcao.
+#define perfil_comando (2) // Duracao de {processa_comando}.
+#define perfil_leds (3)    // Duracao de {atualiza_leds}.
+#define perfil_atraso (4)  // Atraso de cada passo do motor.
+  // Indices das medidas.
+
+#define perfil_num_medidas (5)
+  // Numero de medidas distintas.
+
+#define perfil_num_faixas (8)
+  // Numero de faixas no histograma dos atrasos.
+
+#if muff_usa_perfil
+
+void inicializa_perfil(void);
+  // Zera as medidas.  Deve ser chamada uma vez, no inicio.
+
+void perfil_mede(int medida, unsigned long us);
+  // Acrescenta a amostra {us} (microssegundos) a {medida}.  Pode ser
+  // chamada pela interrupcao do Timer1.
+
+unsigned long perfil_marca(void);
+  // Retorna {micros()}, para uso com {perfil_mede_desde}.
+
+void perfil_mede_desde(int medida, unsigned long t0);
+  // Acrescenta a {medida} o tempo decorrido desde o instante {t0} 
+  // devolvido por {perfil_marca}.
+
+void perfil_inicio_volta(void);
+  // Deve ser chamada no inicio de cada volta do loop principal.
+  // Mede o tempo desde a chamada anterior.
+
+void perfil_passo(bool deu_passo, unsigned long t, unsigned long intervalo);
+  // Deve ser chamada depois de cada {motor->run()} feito no loop principal,
+  // com {deu_passo} true se ele deu um passo, o instante {t} ({micros()})
+  // da chamada, e o intervalo {intervalo} entre passos antes dela
+  // (0 se o motor estava parado).  Mede o atraso do passo.
+
+void perfil_relata(void);
+  // Envia as medidas pela porta serial e as zera.  No protocolo ASCII,
+  // envia uma linha "= {n} {min} {max} {media}" para cada medida, na
+  // ordem dos indices, e uma linha "= {h[0]} ... {h[perfil_num_faixas-1]}"
+  // com o histograma.  No binario, envia os mesmos valores como inteiros
+  // de 32 bits, com o byte menos significativo primeiro.
+
+#else
+
+inline void inicializa_perfil(void) { }
+inline void perfil_mede(int medida, unsigned long us) { (void)(medida); (void)(us); }
+inline unsigned long perfil_marca(void) { return 0; }
+inline void perfil_mede_desde(int medida, unsigned long t0) { (void)(medida); (void)(t0); }
+inline void perfil_inicio_volta(void) { }
+inline void perfil_passo(bool deu_passo, unsigned long t, unsigned long intervalo)
+  { (void)(deu_passo); (void)(t); (void)(intervalo); }
+
+#endif
+
+#endif
@@ -0,0 +1,201 @@
+/* See {muff_protocolo.h}. */
+
+#include "Arduino.h"
+#include <muff_utils.h>
+#include <muff_comandos.h>
+#include <muff_protocolo.h>
+
+// Estados da recepcao de um quadro:
+#define quadro_sinc (0)   // Esperando {protocolo_sinc} ou {protocolo_sinc_endereco}.
+#define quadro_seq (1)    // Esperando o numero de sequencia.
+#define quadro_codigo (2) // Esperando o codigo do comando.
+#define quadro_nb (3)     // Esperando o numero de bytes de argumento.
+#define quadro_args (4)   // Esperando bytes de argumento.
+#define quadro_crc (5)    // Esperando o CRC.
+#define quadro_endereco (6) // Esperando o endereco.
+
+static bool binario = false;
+  // True se o protocolo corrente eh o binario.
+
+static int endereco = 0;
+  // Endereco desta unidade, ou 0 se nenhum.
+
+static uint8_t fins[max_fins_pendentes];
+  // Numeros de sequencia dos comandos com aviso de fim adiado, na ordem,
+  // ou {fim_ascii} para uma resposta '0' adiada no protocolo ASCII.
+
+#define fim_ascii (0xFF)
+  // Entrada de {fins} que representa uma resposta '0' adiada.
+
+static int num_fins = 0;
+  // Numero de entradas usadas em {fins}.
+
+void inicializa_protocolo(muff_protocolo_t *prot)
+  {
+    prot->estado = quadro_sinc;
+    prot->nb = 0;
+    prot->ib = 0;
+    prot->crc = 0;
+    prot->destino = -1;
+    inicializa_comando(&(prot->cmd), 0);
+  }
+
+static void responde_quadro(int seq, bool ok)
+  // Escreve a resposta de um byte ao quadro {seq}.
+  {
+    Serial.write((uint8_t)((ok ? protocolo_ack : protocolo_nak) | (seq & 63)));
+  }
+
+bool protocolo_recebe_byte(muff_protocolo_t *prot, int byte)
+  {
+    muff_comando_t *cmd = &(prot->cmd);
+    uint8_t b = (uint8_t)byte;
+    
+    if (prot->estado == quadro_sinc)
+      { // Uma unidade com endereco so aceita quadros com endereco:
+        if ((b == protocolo_sinc) && (endereco == 0)) 
+          { prot->crc = 0; prot->destino = -1; prot->estado = quadro_seq; }
+        else if (b == protocolo_sinc_endereco)
+          { prot->crc = 0; prot->estado = quadro_endereco; }
+        return false;
+      }
+    if (prot->estado == quadro_crc)
+      { prot->estado = quadro_sinc;
+        if (b != prot->crc)
+          { if (prot->destino < 0) { responde_quadro(cmd->seq, false); }
+            return false;
+          }
+        if ((prot->destino >= 0) && (prot->destino != protocolo_difusao) && (prot->destino != endereco))
+          { return false; }
+        cmd->nargs = prot->nb/4;
+        cmd->difusao = (prot->destino == protocolo_difusao);
+        return true;
+      }
+    
+    prot->crc = crc8_atualiza(prot->crc, b);
+    if (prot->estado == quadro_endereco)
+      { prot->destino = b;
+        prot->estado = quadro_seq;
+      }
+    else if (prot->estado == quadro_seq)
+      { inicializa_comando(cmd, 0);
+        cmd->seq = (b & 63);
+        prot->estado = quadro_codigo;
+      }
+    else if (prot->estado == quadro_codigo)
+      { cmd->codigo = b;
+        prot->estado = quadro_nb;
+      }
+    else if (prot->estado == quadro_nb)
+      { if (((b % 4) != 0) || (b > 4*max_args_comando))
+          { if (prot->destino < 0) { responde_quadro(cmd->seq, false); }
+            prot->estado = quadro_sinc;
+            return false;
+          }
+        prot->nb = b;
+        prot->ib = 0;
+        prot->estado = (b == 0 ? quadro_crc : quadro_args);
+      }
+    else 
+      { // Byte de argumento, menos significativo primeiro:
+        int k = prot->ib/4, j = prot->ib % 4;
+        uint32_t v = (j == 0 ? 0 : (uint32_t)cmd->arg[k]);
+        v |= ((uint32_t)b) << (8*j);
+        cmd->arg[k] = (long)(int32_t)v;
+        prot->ib++;
+        if (prot->ib >= prot->nb) { prot->estado = quadro_crc; }
+      }
+    return false;
+  }
+
+bool protocolo_binario(void)
+  { return binario; }
+
+void protocolo_define_binario(bool bin)
+  {
+    binario = bin;
+    muff_define_diagnosticos(! bin);
+  }
+
+void protocolo_define_endereco(int end)
+  {
+    endereco = end;
+    if (end != 0) { protocolo_define_binario(true); }
+  }
+
+int protocolo_endereco(void)
+  { return endereco; }
+
+static void avisa_fim(int seq)
+  // Escreve o aviso de fim do quadro {seq}, ou a resposta '0' se
+  // {seq} for {fim_ascii}.
+  {
+    if (seq == fim_ascii)
+      { Serial.print('0'); }
+    else
+      { Serial.write((uint8_t)(protocolo_fim | (seq & 63))); }
+  }
+
+static void guarda_fim(int seq)
+  // Acrescenta {seq} a {fins}, enviando antes o aviso mais antigo se 
+  // {fins} estiver cheio.
+  {
+    if (num_fins >= max_fins_pendentes) 
+      { avisa_fim(fins[0]);
+        for (int k = 1; k < num_fins; k++) { fins[k-1] = fins[k]; }
+        num_fins--;
+      }
+    fins[num_fins] = (uint8_t)seq;
+    num_fins++;
+  }
+
+void responde_antes_dos_dados(muff_comando_t *cmd)
+  {
+    if ((cmd->seq < 0) || cmd->difusao) { return; }
+    responde_quadro(cmd->seq, true);
+    cmd->respondido = true;
+  }
+
+void responde_comando(muff_comando_t *cmd)
+  {
+    bool ok = cmd->ok & (! muff_houve_erro());
+    if (cmd->difusao) { return; }
+    if (cmd->seq < 0)
+      { if (cmd->adia_fim && ok) { guarda_fim(fim_ascii); } else { Serial.print('0'); } }
+    else
+      { if (! cmd->respondido) { responde_quadro(cmd->seq, ok); }
+        // O comando 'B0' jah voltou ao protocolo ASCII, que nao tem avisos;
+        // e no barramento os avisos colidiriam com as respostas das outras unidades:
+        if ((! ok) || (! binario) || (endereco != 0)) { return; }
+        if (! cmd->adia_fim)
+          { avisa_fim(cmd->seq); }
+        else
+          { guarda_fim(cmd->seq); }
+      }
+  }
+
+void protocolo_adia_fim(muff_comando_t *cmd)
+  { cmd->adia_fim = true; }
+
+bool protocolo_fins_pendentes(void)
+  { return (num_fins > 0); }
+
+void protocolo_avisa_fins(void)
+  {
+    for (int k = 0; k < num_fins; k++) { avisa_fim(fins[k]); }
+    num_fins = 0;
+  }
+
+uint8_t crc8_atualiza(uint8_t crc, uint8_t byte)
+  {
+    crc ^= byte;
+    for (int i = 0; i < 8; i++)
+      { crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1); }
+    return crc;
+  }
+
+uint8_t crc8_bloco(uint8_t crc, uint8_t *bytes, int n)
+  {
+    for (int k = 0; k < n; k++) { crc = crc8_atualiza(crc, bytes[k]); }
+    return crc;
+  }
@@ -0,0 +1,193 @@
+/* Binary framed command protocol for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_protocolo_H
+#define muff_protocolo_H
+
+#include <muff_comandos.h>
+
+// -----------------------------------------------------------
+// PROTOCOLO BINARIO
+
+// O firmware comeca no protocolo ASCII: cada comando eh um caracter
+// seguido de seus argumentos em texto (veja {muff_leitor_t} em 
+// {muff_comandos.h}), que eh confirmado com um '0' depois de executado, 
+// e as funcoes escrevem mensagens de diagnostico "# ..." ao longo do 
+// caminho.  Esse protocolo eh conveniente para uso interativo.
+//
+// O comando 'B1' passa para o protocolo binario, em que cada comando 
+// eh um quadro 
+//
+//   {protocolo_sinc} {seq} {codigo} {nb} {args[0..nb-1]} {crc}
+//
+// onde {seq} eh um numero de sequencia em 0..63 escolhido pelo 
+// computador, {codigo} eh o mesmo caracter de comando do protocolo ASCII,
+// {nb} eh o numero de bytes de argumento (4 por argumento, no maximo
+// {4*max_args_comando}), cada argumento eh um inteiro de 32 bits com 
+// sinal, com o byte menos significativo primeiro, e {crc} eh o CRC-8 
+// (polinomio 0x07, valor inicial 0) dos bytes de {seq} ateh o ultimo 
+// byte de argumento.  Nos comandos que no protocolo ASCII tem
+// argumento de formato 'c', o argumento eh o codigo do caracter.  Cada
+// argumento deve caber no seu campo do formato ASCII (numero de digitos,
+// sinal; veja {comando_confere_args}), senao o comando falha.
+//
+// Cada quadro recebe uma resposta de um unico byte: 
+// {protocolo_ack|seq} se o comando foi aceito sem erro, ou 
+// {protocolo_nak|seq} se o quadro estava corrompido ou o comando falhou.
+// Os dados enviados por comandos como '?' vem logo depois dessa resposta.
+// No protocolo binario as mensagens de diagnostico sao suprimidas.
+// O quadro com codigo 'B' e argumento 0 volta ao protocolo ASCII.
+//
+// Depois do {protocolo_ack}, cada comando aceito recebe tambem um aviso 
+// de um byte {protocolo_fim|seq} quando terminar.  Para a maioria dos
+// comandos ele vem logo em seguida; para os que iniciam um movimento 
+// (veja {protocolo_adia_fim}), so quando o motor parar.  Assim o
+// computador pode enviar o comando seguinte sem esperar o fim do 
+// anterior.  Os avisos de fim nao se misturam com os dados de resposta,
+// mas podem vir antes de qualquer resposta.
+//
+// No protocolo ASCII nao ha avisos de fim, mas a resposta '0' dos
+// comandos para os quais {protocolo_adia_fim} foi chamada so eh enviada
+// quando o movimento terminar, da mesma forma.  O firmware continua
+// atendendo comandos enquanto isso.
+//
+// Em ambos os protocolos, algumas atividades de fundo enviam ainda
+// avisos de um byte isolado, fora das respostas aos comandos:
+//
+//   {busca_fim} ('H'): fim da busca da origem (veja {muff_chave.h});
+//   {varredura_fim} ('V'): fim da varredura (veja {muff_varredura.h});
+//   {sequenciador_pronto} ('R'): quadro do plano pronto para ser tirado;
+//   {sequenciador_fim} ('F'): fim do plano (veja {muff_sequenciador.h});
+//   {telemetria_sinc} ('@'): inicio de um quadro de telemetria 
+//     (veja {muff_telemetria.h}).
+//
+// Cada aviso tem o seu byte, para que o computador saiba qual atividade
+// terminou.  Todos estao em 0x40..0x7F, e portanto nao se confundem com
+// os bytes {protocolo_ack}, {protocolo_nak} e {protocolo_fim}.
+//
+// Varias unidades podem compartilhar a mesma linha serial, como num 
+// barramento RS-485 de 4 fios, em que os quadros do computador chegam a
+// todas as unidades, e as respostas de todas chegam so ao computador.
+// Os transceptores devem ligar o transmissor sozinhos quando a unidade
+// transmite; o firmware nao controla o pino DE.
+//
+// Para isso, cada unidade recebe um endereco de 1 a {protocolo_max_endereco}
+// (veja {config_endereco} em {muff_config.h}).  Uma unidade com endereco
+// jah comeca no protocolo binario, sem mensagens nem linha de pronto, 
+// ignora os quadros {protocolo_sinc}, e aceita apenas os quadros
+//
+//   {protocolo_sinc_endereco} {end} {seq} {codigo} {nb} {args[0..nb-1]} {crc}
+//
+// cujo {end} seja o seu endereco ou {protocolo_difusao}; o {crc} inclui
+// o byte {end}.  Os quadros para outras unidades, e os corrompidos (cujo
+// endereco nao eh confiavel), sao descartados sem resposta; assim o
+// computador deve esperar a resposta de cada quadro (ou desistir depois
+// de algum tempo) antes de enviar o seguinte.  Para nao colidir com as
+// respostas das outras unidades, uma unidade com endereco nao envia
+// avisos de fim: o computador deve consultar o motor com 'K'.  Pela mesma
+// razao, a telemetria e o plano de captura, que enviam bytes por conta
+// propria, so devem ser usados havendo uma unica unidade na linha.
+//
+// Um quadro para {protocolo_difusao} eh executado por todas as unidades,
+// inclusive as sem endereco, e nenhuma responde.  Serve para comandos como
+// '5', '>' ou 'a'..'p', que assim comecam ao mesmo tempo em todas as
+// estacoes.  Os comandos que enviam dados, como '?' e 'K', nao podem ser
+// difundidos.
+
+#define protocolo_sinc (0xA5)
+  // Byte que marca o inicio de um quadro.
+
+#define protocolo_sinc_endereco (0xA6)
+  // Byte que marca o inicio de um quadro com endereco.
+
+#define protocolo_difusao (0)
+  // Endereco de um quadro para todas as unidades.
+
+#define protocolo_max_endereco (127)
+  // Maior endereco de uma unidade.
+
+#define protocolo_ack (0x80)
+  // Resposta de comando executado, combinada com o {seq} do quadro.
+
+#define protocolo_nak (0xC0)
+  // Resposta de quadro rejeitado, combinada com o {seq} do quadro.
+
+#define protocolo_fim (0x00)
+  // Aviso de comando terminado, combinado com o {seq} do quadro.
+
+#define max_fins_pendentes (8)
+  // Numero maximo de avisos de fim adiados ao mesmo tempo.
+
+typedef struct muff_protocolo_t
+  { int estado;                   // Parte do quadro esperada no proximo byte.
+    int nb;                       // Numero de bytes de argumento do quadro.
+    int ib;                       // Numero de bytes de argumento jah recebidos.
+    uint8_t crc;                  // CRC dos bytes recebidos ateh agora.
+    int destino;                  // Endereco do quadro, ou -1 se veio sem endereco.
+    muff_comando_t cmd;           // Comando sendo recebido.
+  } muff_protocolo_t;
+  // Estado da recepcao de quadros binarios.
+
+void inicializa_protocolo(muff_protocolo_t *prot);
+  // Inicializa {prot} no estado "esperando {protocolo_sinc}".
+
+bool protocolo_recebe_byte(muff_protocolo_t *prot, int byte);
+  // Processa o {byte} recebido pela porta serial no protocolo binario.
+  // Retorna true se o {byte} completou um quadro valido, cujo comando
+  // estah entao em {prot->cmd}.  Se o quadro estiver corrompido, 
+  // responde com {protocolo_nak} (exceto nos quadros com endereco) e
+  // descarta o quadro.  Os quadros para outras unidades sao descartados.
+  // Bytes fora de quadro que nao iniciem um quadro sao ignorados.
+
+bool protocolo_binario(void);
+  // Retorna true se o protocolo corrente eh o binario.
+
+void protocolo_define_binario(bool binario);
+  // Muda o protocolo corrente para binario ou ASCII, suprimindo 
+  // ou restaurando as mensagens de diagnostico.
+
+void protocolo_define_endereco(int endereco);
+  // Define o {endereco} desta unidade, de 0 (nenhum) a 
+  // {protocolo_max_endereco}.  Se nao for 0, muda para o protocolo binario.
+
+int protocolo_endereco(void);
+  // Retorna o endereco desta unidade, ou 0 se ela nao tem endereco.
+
+void responde_comando(muff_comando_t *cmd);
+  // Informa o computador de que o comando {cmd} foi executado, 
+  // no protocolo em que ele chegou: '0' no ASCII, {protocolo_ack} ou
+  // {protocolo_nak} no binario.  No ASCII, se o comando foi aceito e
+  // {protocolo_adia_fim(cmd)} foi chamada, guarda o '0' para 
+  // {protocolo_avisa_fins}.  No binario, se o comando foi aceito,
+  // envia tambem o aviso {protocolo_fim}, ou o guarda para 
+  // {protocolo_avisa_fins} se {protocolo_adia_fim(cmd)} foi chamada,
+  // exceto se a unidade tiver endereco.  Se a resposta jah foi enviada por
+  // {responde_antes_dos_dados}, envia apenas o aviso.  Nao envia nada se
+  // o comando veio por difusao.
+
+void responde_antes_dos_dados(muff_comando_t *cmd);
+  // No protocolo binario, envia logo o {protocolo_ack} do comando {cmd},
+  // que nao pode mais falhar, para que os dados que ele envia venham
+  // depois da resposta.  No ASCII, ou se o comando veio por difusao, 
+  // nao faz nada.
+
+void protocolo_adia_fim(muff_comando_t *cmd);
+  // Anota que o aviso de fim do comando {cmd} deve esperar ateh o fim
+  // do movimento que ele iniciou.  Deve ser chamada antes de
+  // {responde_comando(cmd)}.  Se houver {max_fins_pendentes} avisos 
+  // adiados, o mais antigo eh enviado logo.
+
+bool protocolo_fins_pendentes(void);
+  // Retorna true se ha avisos de fim adiados.
+
+void protocolo_avisa_fins(void);
+  // Envia todos os avisos de fim adiados, na ordem dos comandos.  Deve
+  // ser chamada quando o motor parar, ou quando um comando novo
+  // interromper os movimentos anteriores.
+
+uint8_t crc8_atualiza(uint8_t crc, uint8_t byte);
+  // Retorna o CRC-8 corrente {crc} atualizado com o {byte}.
+
+uint8_t crc8_bloco(uint8_t crc, uint8_t *bytes, int n);
+  // Retorna o CRC-8 corrente {crc} atualizado com os bytes {bytes[0..n-1]}.
+
+#endif
@@ -0,0 +1,144 @@
+/* See {muff_sequenciador.h}. */
+
+#include "Arduino.h"
+#include <AccelStepper.h>
+#include <muff_utils.h>
+#include <muff_sequenciador.h>
+#include <muff_camera.h>
+
+// Estados do sequenciador:
+#define seq_parado (0)      // Nenhum plano em execucao.
+#define seq_ilumina (1)     // Esperando o motor parar para acender os LEDs do quadro {H,L}.
+#define seq_espera (2)      // Esperando a estabilizacao.
+#define seq_pronto (3)      // Esperando o computador tirar o quadro.
+#define seq_proximo (4)     // O quadro {H,L} foi tirado.
+
+void inicializa_sequenciador(muff_sequenciador_t *seq)
+  {
+    seq->estado = seq_parado;
+    sequenciador_define_plano(seq, 0, 0);
+    seq->plano.desloc = 0;
+    seq->plano.max_vel = 0;
+    seq->tirado_pela_camera = false;
+  }
+
+void sequenciador_define_plano(muff_sequenciador_t *seq, int nH, long espera_ms)
+  {
+    seq->plano.nH = nH;
+    seq->plano.nL = 0;
+    seq->plano.nZ = 0;
+    seq->plano.espera_ms = espera_ms;
+    seq->Z = 0;
+  }
+
+bool sequenciador_acrescenta_mascara(muff_sequenciador_t *seq, uint32_t mascara)
+  {
+    muff_plano_t *pl = &(seq->plano);
+    if (pl->nL >= max_mascaras_plano) { return false; }
+    pl->mascara[pl->nL] = mascara;
+    pl->nL++;
+    return true;
+  }
+
+bool sequenciador_acrescenta_desloc(muff_sequenciador_t *seq, long desloc)
+  {
+    muff_plano_t *pl = &(seq->plano);
+    if ((pl->nZ >= max_desloc_plano) || (desloc < -32767) || (desloc > 32767)) { return false; }
+    pl->desloc_altura[pl->nZ] = desloc;
+    pl->nZ++;
+    return true;
+  }
+
+bool sequenciador_proximo_desloc(muff_sequenciador_t *seq, long *desloc)
+  {
+    muff_plano_t *pl = &(seq->plano);
+    if (seq->Z >= pl->nZ) { return false; }
+    (*desloc) = pl->desloc_altura[seq->Z];
+    seq->Z++;
+    return true;
+  }
+
+bool sequenciador_inicia(muff_sequenciador_t *seq, long desloc, int max_vel)
+  {
+    muff_plano_t *pl = &(seq->plano);
+    if ((pl->nH <= 0) || (pl->nL <= 0)) { return false; }
+    if ((pl->nZ > 0) && (pl->nZ < pl->nH - 1)) { return false; }
+    pl->desloc = desloc;
+    pl->max_vel = max_vel;
+    seq->H = 0;
+    seq->L = 0;
+    seq->Z = 0;
+    seq->tirado_pela_camera = false;
+    seq->estado = seq_ilumina;
+    return true;
+  }
+
+int sequenciador_quadro_tirado(muff_sequenciador_t *seq)
+  {
+    if (seq->estado == seq_pronto) { seq->estado = seq_proximo; return 0; }
+    // O fim da exposicao pode ter chegado antes do aviso do computador:
+    if (seq->tirado_pela_camera) { seq->tirado_pela_camera = false; return 0; }
+    return (seq->estado == seq_parado ? erro_sem_plano : erro_quadro_nao_pronto);
+  }
+
+static void termina(muff_sequenciador_t *seq, uint8_t estados_dos_leds[])
+  // Apaga os LEDs, para o sequenciador e avisa o computador.
+  {
+    aciona_todos_os_leds(0, estados_dos_leds);
+    seq->estado = seq_parado;
+    Serial.write(sequenciador_fim);
+  }
+
+void sequenciador_aborta(muff_sequenciador_t *seq, uint8_t estados_dos_leds[])
+  {
+    if (seq->estado != seq_parado) { termina(seq, estados_dos_leds); }
+    seq->tirado_pela_camera = false;
+  }
+
+bool sequenciador_ativo(muff_sequenciador_t *seq)
+  { return (seq->estado != seq_parado); }
+
+void sequenciador_avanca(muff_sequenciador_t *seq, muff_motor *motor, uint8_t estados_dos_leds[])
+  {
+    muff_plano_t *pl = &(seq->plano);
+    if (seq->estado == seq_ilumina)
+      { // Espera o motor chegar na altura {H} antes de acender os LEDs: 
+        if (motor_em_movimento(motor)) { return; }
+        aciona_leds_mascara(pl->mascara[seq->L], estados_dos_leds);
+        seq->inicio_espera = millis();
+        seq->estado = seq_espera;
+      }
+    if (seq->estado == seq_espera)
+      { if (millis() - seq->inicio_espera < (unsigned long)pl->espera_ms) { return; }
+        muff_aviso(aviso_quadro_pronto, seq->H, seq->L);
+        camera_dispara();
+        Serial.write(sequenciador_pronto);
+        seq->tirado_pela_camera = false;
+        seq->estado = seq_pronto;
+      }
+    if (seq->estado == seq_pronto)
+      { // O fim da exposicao tambem conta como "quadro tirado":
+        if (camera_exposicao_terminou()) 
+          { seq->tirado_pela_camera = true;
+            seq->estado = seq_proximo;
+          }
+      }
+    if (seq->estado == seq_proximo)
+      { seq->L++;
+        if (seq->L < pl->nL)
+          { seq->estado = seq_ilumina; }
+        else
+          { seq->L = 0;
+            seq->H++;
+            if (seq->H >= pl->nH)
+              { termina(seq, estados_dos_leds); }
+            else
+              { // Sobe para a proxima altura com os LEDs apagados:
+                aciona_todos_os_leds(0, estados_dos_leds);
+                long desloc = (pl->nZ > 0 ? pl->desloc_altura[seq->H - 1] : pl->desloc);
+                aciona_motor(motor, desloc, pl->max_vel);
+                seq->estado = seq_ilumina;
+              }
+          }
+      }
+  }
@@ -0,0 +1,124 @@
+/* On-device capture sequencer for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_sequenciador_H
+#define muff_sequenciador_H
+
+#include <AccelStepper.h>
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// SEQUENCIADOR DE CAPTURA
+
+// O sequenciador executa sozinho um plano de captura de {nH} alturas
+// por {nL} condicoes de iluminacao, na mesma ordem de {capture_image_set}
+// em {muff_mainloop.py}: para cada altura, para cada condicao de
+// iluminacao, espera o motor parar, acende os LEDs da condicao, espera 
+// as vibracoes passarem e avisa o computador de que o quadro estah pronto;
+// entao espera o aviso de que o quadro foi tirado.  Se o disparo da
+// camera estiver habilitado (veja {muff_camera.h}), dispara a camera 
+// junto com o aviso de quadro pronto, e o fim da exposicao, se 
+// observado, conta como aviso de quadro tirado.  Depois da ultima
+// condicao de uma altura, sobe o microscopio para a altura seguinte.
+//
+// Normalmente as alturas sao igualmente espacadas.  Mas o plano pode
+// ter tambem uma lista de deslocamentos entre alturas consecutivas,
+// para que as alturas fiquem mais proximas perto do foco e mais 
+// espacadas onde a amostra nao tem detalhes: entao, da altura {H-1}
+// para a altura {H}, o microscopio sobe o deslocamento {H-1} da lista.
+// A mesma lista pode ser percorrida pelo computador, um deslocamento 
+// por vez (veja {sequenciador_proximo_desloc}), quando a captura eh
+// comandada por ele.
+//
+// Os avisos enviados ao computador sao bytes isolados, fora das
+// respostas aos comandos: {sequenciador_pronto} quando um quadro estah
+// pronto e {sequenciador_fim} quando o plano terminou ou foi abortado.
+// Como sao letras ASCII, nao se confundem com as respostas do
+// protocolo binario.
+//
+// O sequenciador nunca espera: {sequenciador_avanca} deve ser chamada
+// a cada volta do loop principal, e faz apenas o que jah for possivel.
+
+#define max_mascaras_plano (24)
+  // Numero maximo de condicoes de iluminacao num plano.
+
+#define max_desloc_plano (98)
+  // Numero maximo de deslocamentos na lista do plano (o plano pode
+  // ter ateh 99 alturas).
+
+#define sequenciador_pronto 'R'
+  // Aviso de quadro pronto para ser tirado.
+
+#define sequenciador_fim 'F'
+  // Aviso de fim do plano.
+
+typedef struct muff_plano_t
+  { int nH;                       // Numero de alturas.
+    int nL;                       // Numero de condicoes de iluminacao.
+    uint32_t mascara[max_mascaras_plano]; // LEDs acesos em cada condicao (bit {k} = LED {k}).
+    long espera_ms;               // Tempo de estabilizacao antes de cada quadro (ms).
+    long desloc;                  // Passos entre alturas consecutivas, se {nZ} for 0.
+    int nZ;                       // Numero de deslocamentos na lista {desloc_altura}.
+    int16_t desloc_altura[max_desloc_plano]; // Passos da altura {k} para a altura {k+1}.
+    int max_vel;                  // Velocidade maxima entre alturas (passos/segundo).
+  } muff_plano_t;
+  // Um plano de captura.
+
+typedef struct muff_sequenciador_t
+  { muff_plano_t plano;           // Plano sendo executado ou a executar.
+    int estado;                   // Estado corrente (veja {muff_sequenciador.cpp}).
+    int H;                        // Indice da altura corrente, em {0..nH-1}.
+    int L;                        // Indice da condicao de iluminacao corrente, em {0..nL-1}.
+    int Z;                        // Indice do proximo deslocamento de {sequenciador_proximo_desloc}.
+    unsigned long inicio_espera;  // Valor de {millis()} quando a estabilizacao comecou.
+    bool tirado_pela_camera;      // O ultimo quadro pronto foi dado como tirado pelo fim da exposicao.
+  } muff_sequenciador_t;
+  // Estado do sequenciador.
+
+void inicializa_sequenciador(muff_sequenciador_t *seq);
+  // Inicializa {seq} como parado, com um plano vazio.
+
+void sequenciador_define_plano(muff_sequenciador_t *seq, int nH, long espera_ms);
+  // Define o numero de alturas {nH} e o tempo de estabilizacao {espera_ms}
+  // do plano, e esvazia suas listas de condicoes de iluminacao e de
+  // deslocamentos entre alturas.
+
+bool sequenciador_acrescenta_mascara(muff_sequenciador_t *seq, uint32_t mascara);
+  // Acrescenta ao plano uma condicao de iluminacao com os LEDs da {mascara}.
+  // Retorna false se o plano jah tiver {max_mascaras_plano} condicoes.
+
+bool sequenciador_acrescenta_desloc(muff_sequenciador_t *seq, long desloc);
+  // Acrescenta {desloc} passos ao fim da lista de deslocamentos entre
+  // alturas do plano.  Retorna false se a lista jah tiver 
+  // {max_desloc_plano} deslocamentos, ou se {desloc} nao couber em 16 bits.
+
+bool sequenciador_proximo_desloc(muff_sequenciador_t *seq, long *desloc);
+  // Guarda em {*desloc} o proximo deslocamento da lista do plano, para
+  // o computador mover o microscopio ele mesmo, e avanca na lista.  A
+  // lista volta ao comeco quando o plano eh definido ou iniciado.  
+  // Retorna false se a lista tiver acabado ou estiver vazia.
+
+bool sequenciador_inicia(muff_sequenciador_t *seq, long desloc, int max_vel);
+  // Comeca a executar o plano, subindo {desloc} passos com velocidade 
+  // maxima {max_vel} entre alturas, ou os deslocamentos da lista do
+  // plano, se nao for vazia.  Retorna false se o plano for vazio, ou se
+  // a lista nao for vazia mas tiver menos que {nH-1} deslocamentos.
+
+int sequenciador_quadro_tirado(muff_sequenciador_t *seq);
+  // Avisa o sequenciador de que o quadro corrente foi tirado.  Retorna 0
+  // se havia um quadro pronto esperando o aviso, ou se o ultimo quadro 
+  // pronto jah tinha sido dado como tirado pelo fim da exposicao (e este
+  // eh o primeiro aviso para ele).  Senao, o aviso eh ignorado, e retorna
+  // {erro_sem_plano} se o plano nao estiver em execucao, ou 
+  // {erro_quadro_nao_pronto} se estiver mas nenhum quadro estiver pronto.
+
+void sequenciador_aborta(muff_sequenciador_t *seq, uint8_t estados_dos_leds[]);
+  // Interrompe o plano, se estiver em execucao, apaga os LEDs
+  // e envia {sequenciador_fim}.  Nao para o motor.
+
+bool sequenciador_ativo(muff_sequenciador_t *seq);
+  // Retorna true se o plano estiver em execucao.
+
+void sequenciador_avanca(muff_sequenciador_t *seq, muff_motor *motor, uint8_t estados_dos_leds[]);
+  // Faz o que o plano exigir neste momento, sem esperar.
+
+#endif
@@ -0,0 +1,82 @@
+/* See {muff_telemetria.h}. */
+
+#include "Arduino.h"
+#include <AccelStepper.h>
+#include <muff_utils.h>
+#include <muff_protocolo.h>
+#include <muff_chave.h>
+#include <muff_telemetria.h>
+
+#define telemetria_max_linha (48)
+  // Comprimento maximo de uma linha de telemetria no protocolo ASCII.
+
+static unsigned long periodo_ms = 0;
+  // Intervalo entre quadros, ou 0 se a telemetria estiver desligada.
+
+static unsigned long ultimo_quadro = 0;
+  // Valor de {millis()} quando o ultimo quadro foi enviado.
+
+void telemetria_define_periodo(long periodo)
+  {
+    if (periodo <= 0)
+      { periodo_ms = 0; }
+    else if (periodo < telemetria_min_periodo_ms)
+      { periodo_ms = telemetria_min_periodo_ms; }
+    else
+      { periodo_ms = periodo; }
+    // O primeiro quadro sai na proxima volta do loop:
+    ultimo_quadro = millis() - periodo_ms;
+  }
+
+static int poe_inteiro(uint8_t quadro[], int k, long val, int nb)
+  // Guarda os {nb} bytes menos significativos de {val} em {quadro[k..k+nb-1]},
+  // o menos significativo primeiro.  Retorna {k+nb}.
+  {
+    for (int i = 0; i < nb; i++) { quadro[k+i] = (uint8_t)((val >> (8*i)) & 255); }
+    return k + nb;
+  }
+
+void telemetria_avanca(muff_motor *motor, uint8_t estados_dos_leds[])
+  {
+    if (periodo_ms == 0) { return; }
+    if (millis() - ultimo_quadro < periodo_ms) { return; }
+    bool binario = protocolo_binario();
+    int tam = (binario ? telemetria_tam : telemetria_max_linha);
+    if (Serial.availableForWrite() < tam) { return; }
+    ultimo_quadro = millis();
+
+    long pos = posicao_motor(motor);
+    long vel = velocidade_motor(motor);
+    long falta = alvo_motor(motor) - pos;
+    int chave = (chave_acionada() ? 1 : 0);
+    if (binario)
+      { int estado = estado_motor(motor);
+        int codigo = (estado == motor_estado_girando ? 1 : (estado == motor_estado_adiado ? 2 : 0));
+        if (vel > 32767L) { vel = 32767L; }
+        if (vel < -32767L) { vel = -32767L; }
+        uint8_t quadro[telemetria_tam];
+        int k = 0;
+        quadro[k] = telemetria_sinc; k++;
+        k = poe_inteiro(quadro, k, pos, 4);
+        k = poe_inteiro(quadro, k, vel, 2);
+        k = poe_inteiro(quadro, k, falta, 4);
+        for (int grupo = 0; grupo < num_bytes_leds; grupo++)
+          { quadro[k] = (uint8_t)estados_dos_leds[grupo]; k++; }
+        quadro[k] = (uint8_t)(chave | (codigo << 1)); k++;
+        uint8_t crc = 0;
+        for (int i = 1; i < k; i++) { crc = crc8_atualiza(crc, quadro[i]); }
+        quadro[k] = crc; k++;
+        Serial.write(quadro, k);
+      }
+    else
+      { long leds = 0;
+        for (int grupo = num_bytes_leds - 1; grupo >= 0; grupo--)
+          { leds = (leds << 8) | (estados_dos_leds[grupo] & 255); }
+        Serial.print((char)telemetria_sinc);
+        Serial.print(' '); Serial.print(pos);
+        Serial.print(' '); Serial.print(vel);
+        Serial.print(' '); Serial.print(falta);
+        Serial.print(' '); Serial.print(leds, HEX);
+        Serial.print(' '); Serial.println(chave);
+      }
+  }
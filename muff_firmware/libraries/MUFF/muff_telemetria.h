@@ -0,0 +1,61 @@
+/* Periodic motion telemetry for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_telemetria_H
+#define muff_telemetria_H
+
+#include <AccelStepper.h>
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// TELEMETRIA
+
+// Opcionalmente, o firmware envia a cada {periodo} milissegundos um
+// quadro de telemetria com o estado do motor, dos LEDs e da chave de
+// fim de curso, inclusive durante os movimentos.  No protocolo binario
+// (veja {muff_protocolo.h}) o quadro tem {telemetria_tam} bytes:
+//
+//   {telemetria_sinc} {pos[4]} {vel[2]} {falta[4]} {leds[3]} {estado} {crc}
+//
+// onde {pos} eh a posicao absoluta corrente do motor, {vel} a
+// velocidade corrente (limitada a 16 bits com sinal), e {falta} o
+// numero de passos ateh o objetivo do movimento corrente, todos em
+// micropassos e com o byte menos significativo primeiro; {leds} eh o
+// vetor {estados_dos_leds}; {estado} tem o bit 0 em 1 se a chave
+// estiver acionada, e nos bits 1 e 2 o valor 0 se o motor estiver
+// parado, 1 se estiver em movimento, e 2 se estiver parando para
+// iniciar outro movimento (veja {estado_motor}); e {crc} eh o CRC-8
+// dos bytes de {pos} ateh {estado} (veja {crc8_atualiza}).  O byte
+// {telemetria_sinc} nao se confunde com as respostas e avisos do
+// protocolo, e o quadro nunca eh intercalado com os dados de uma
+// resposta.
+//
+// No protocolo ASCII, o quadro eh uma linha
+// "@ {pos} {vel} {falta} {leds} {chave}", com {leds} em hexadecimal
+// (o byte {estados_dos_leds[0]} nos dois digitos menos significativos)
+// e {chave} igual a 0 ou 1.
+//
+// O quadro soh eh escrito quando cabe inteiro no espaco livre do buffer
+// de transmissao da porta serial, e portanto nunca faz o firmware
+// esperar; se nao couber, fica para a volta seguinte do loop principal.
+
+#define telemetria_sinc ('@')
+  // Byte que marca o inicio de um quadro de telemetria.
+
+#define telemetria_tam (16)
+  // Numero de bytes de um quadro de telemetria no protocolo binario.
+
+#define telemetria_min_periodo_ms (20)
+  // Periodo minimo entre quadros (ms); a 9600 bauds, um quadro
+  // binario leva uns 17 ms para ser transmitido.
+
+void telemetria_define_periodo(long periodo_ms);
+  // Passa a enviar um quadro a cada {periodo_ms} milissegundos, ou
+  // deixa de enviar se {periodo_ms} for 0.  Valores entre 0 e
+  // {telemetria_min_periodo_ms} sao aumentados para este.
+
+void telemetria_avanca(muff_motor *motor, uint8_t estados_dos_leds[]);
+  // Deve ser chamada a cada volta do loop principal.  Envia o quadro
+  // de telemetria, se for a hora e houver espaco no buffer de
+  // transmissao.
+
+#endif
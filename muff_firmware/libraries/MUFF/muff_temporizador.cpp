@@ -0,0 +1,164 @@
+/* See {muff_temporizador.h}. */
+
+#include "Arduino.h"
+#include <AccelStepper.h>
+#include <muff_utils.h>
+#include <muff_temporizador.h>
+#include <muff_perfil.h>
+
+static muff_motor *motor_temporizado = NULL;
+  // Motor cujos passos sao gerados pela interrupcao.
+
+static volatile bool ativo = false;
+  // True se o Timer1 estiver contando e a interrupcao habilitada.
+
+static muff_observador_t *volatile observador = NULL;
+  // Funcao a chamar depois de cada passo, ou NULL.
+
+static volatile bool calculando = false;
+  // True enquanto a interrupcao calcula o passo com as outras interrupcoes habilitadas.
+
+static muff_acao_motor_t *volatile acao_adiada = NULL;
+  // Acao pedida por {temporizador_executa} durante os calculos, ou NULL.
+
+#if defined(__AVR__)
+
+#define tiques_por_us (F_CPU/8000000L)
+  // Tiques do Timer1 por microssegundo, com prescaler 8.
+
+#define max_pedaco_us (30000L)
+  // Intervalo maximo (microssegundos) que cabe em {OCR1A} de uma vez.
+
+#define min_intervalo_us (8L)
+  // Intervalo minimo programavel (microssegundos).
+
+static volatile unsigned long restante_us = 0;
+  // Parte do intervalo corrente que ainda falta contar,
+  // alem do pedaco que estah em {OCR1A}.
+
+static void programa_intervalo(unsigned long us)
+  // Programa o Timer1 para interromper daqui a {us} microssegundos,
+  // contados a partir da ultima comparacao.  Deve ser chamada
+  // com as interrupcoes desabilitadas.
+  {
+    if (us > max_pedaco_us)
+      { restante_us = us - max_pedaco_us; us = max_pedaco_us; }
+    else
+      { restante_us = 0; }
+    if (us < min_intervalo_us) { us = min_intervalo_us; }
+    uint16_t limite = (uint16_t)(us*tiques_por_us - 1);
+    OCR1A = limite;
+    // Se a interrupcao demorou mais que o intervalo, dispara logo em vez
+    // de esperar o contador dar a volta completa:
+    if (TCNT1 >= limite) { TCNT1 = limite - 1; }
+  }
+
+static void liga_temporizador(unsigned long us)
+  // Zera o contador e liga o Timer1 para a primeira interrupcao
+  // daqui a {us} microssegundos.
+  {
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12); // Modo CTC, contador parado.
+    TCNT1 = 0;
+    programa_intervalo(us);
+    TIFR1 = (1 << OCF1A);  // Descarta comparacao pendente.
+    TIMSK1 |= (1 << OCIE1A);
+    TCCR1B |= (1 << CS11); // Prescaler 8, comeca a contar.
+    ativo = true;
+  }
+
+static void desliga_temporizador(void)
+  {
+    TCCR1B &= ~((1 << CS12) | (1 << CS11) | (1 << CS10));
+    TIMSK1 &= ~(1 << OCIE1A);
+    restante_us = 0;
+    ativo = false;
+  }
+
+ISR(TIMER1_COMPA_vect)
+  {
+    if (restante_us > 0)
+      { // Ainda nao eh hora do passo, conta mais um pedaco:
+        programa_intervalo(restante_us);
+        return;
+      }
+#if muff_usa_perfil
+    // No modo CTC o contador foi zerado na comparacao; o que ele conta eh a latencia:
+    uint16_t entrada = TCNT1;
+    perfil_mede(perfil_atraso, entrada/tiques_por_us);
+#endif
+    // Os calculos do passo (sobretudo no perfil em S) sao demorados; enquanto
+    // isso esta interrupcao fica mascarada, sem nova comparacao (o contador 
+    // segue contando desde esta), e as outras sao atendidas:
+    OCR1A = 0xFFFF;
+    TIMSK1 &= ~(1 << OCIE1A);
+    calculando = true;
+    interrupts();
+    // Dah o passo e calcula o intervalo ateh o proximo:
+    unsigned long intervalo = motor_temporizado->runStep();
+    noInterrupts();
+    calculando = false;
+#if muff_usa_perfil
+    perfil_mede(perfil_passos, (uint16_t)(TCNT1 - entrada)/tiques_por_us);
+#endif
+    if (acao_adiada != NULL)
+      { // Outra interrupcao alterou o movimento durante os calculos:
+        acao_adiada(motor_temporizado);
+        acao_adiada = NULL;
+        intervalo = motor_temporizado->stepInterval();
+      }
+    if (observador != NULL) { observador(motor_temporizado->currentPosition()); }
+    if (intervalo == 0)
+      { desliga_temporizador(); }
+    else
+      { TIFR1 = (1 << OCF1A);  // Descarta comparacao pendente.
+        programa_intervalo(intervalo);
+        TIMSK1 |= (1 << OCIE1A);
+      }
+  }
+
+void inicializa_temporizador(muff_motor *motor)
+  {
+    noInterrupts();
+    motor_temporizado = motor;
+    desliga_temporizador();
+    interrupts();
+  }
+
+void temporizador_executa(muff_motor *motor, muff_acao_motor_t *acao)
+  {
+    if (calculando && (motor == motor_temporizado))
+      { acao_adiada = acao; }
+    else
+      { acao(motor); }
+  }
+
+void temporizador_acorda(void)
+  {
+    noInterrupts();
+    if ((! ativo) && (motor_temporizado != NULL) && (motor_temporizado->stepInterval() != 0))
+      { liga_temporizador(min_intervalo_us); }
+    interrupts();
+  }
+
+#else
+
+// Em outras plataformas nao ha Timer1; os passos devem ser
+// gerados por {motor.run()} no loop principal.
+
+void inicializa_temporizador(muff_motor *motor)
+  { motor_temporizado = motor; }
+
+void temporizador_acorda(void)
+  { }
+
+void temporizador_executa(muff_motor *motor, muff_acao_motor_t *acao)
+  { acao(motor); }
+
+#endif
+
+bool temporizador_ativo(void)
+  { return ativo; }
+
+void temporizador_define_observador(muff_observador_t *obs)
+  { observador = obs; }
@@ -0,0 +1,70 @@
+/* Timer-interrupt step generation for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_temporizador_H
+#define muff_temporizador_H
+
+#include <AccelStepper.h>
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// GERACAO DE PASSOS PELO TEMPORIZADOR
+
+// Quando {motor1_usa_temporizador} (em {muff_utils.h}) eh 1, os passos
+// do motor principal sao gerados pela interrupcao de comparacao do
+// Timer1 do ATmega328P (Arduino Nano), em vez de chamadas de
+// {motor.run()} no loop principal.  O loop principal cuida apenas dos
+// comandos; o perfil de velocidade continua sendo o de
+// {AccelStepper::computeNewSpeed()}, calculado dentro da interrupcao
+// por {muff_motor::runStep()} logo apos cada passo.
+//
+// O Timer1 opera em modo CTC, com prescaler 8 (0.5 microssegundos por
+// tique a 16 MHz).  Apos cada passo o registro {OCR1A} eh reprogramado
+// com o intervalo ateh o proximo.  Intervalos maiores que o ciclo
+// maximo do Timer1 sao divididos em pedacos.
+//
+// Enquanto o temporizador estiver ativo, quem chamar metodos do motor
+// fora da interrupcao deve faze-lo com as interrupcoes desabilitadas
+// (veja {motor_em_movimento} e {aciona_motor} em {muff_utils.h}).
+//
+// O passo e o calculo do intervalo seguinte ({runStep}) podem levar 
+// mais que o intervalo entre dois bytes da porta serial, sobretudo no
+// perfil em S.  Durante eles a interrupcao do Timer1 fica mascarada,
+// mas as demais interrupcoes (porta serial, chave de fim de curso)
+// continuam habilitadas.  Por isso, as outras interrupcoes nao devem
+// alterar o motor diretamente, mas por meio de {temporizador_executa}.
+
+void inicializa_temporizador(muff_motor *motor);
+  // Prepara o Timer1 para gerar os passos do {motor}, sem ainda
+  // liga-lo.  Deve ser chamada uma vez, depois que o {motor} estiver
+  // configurado.
+
+void temporizador_acorda(void);
+  // Deve ser chamada depois de qualquer alteracao do objetivo ou
+  // da velocidade do motor.  Se o temporizador estiver parado e o
+  // motor tiver passos a dar, agenda o primeiro passo para daqui a
+  // poucos microssegundos. Se o temporizador jah estiver ativo,
+  // nao faz nada: a interrupcao seguinte jah usa o novo perfil.
+
+bool temporizador_ativo(void);
+  // Retorna true se o temporizador estiver gerando passos.
+
+typedef void muff_observador_t(long posicao);
+  // Tipo de uma funcao chamada depois de cada passo do motor,
+  // com a nova posicao {motor.currentPosition()}.
+
+typedef void muff_acao_motor_t(muff_motor *motor);
+  // Tipo de uma funcao que altera o movimento do {motor}.
+
+void temporizador_executa(muff_motor *motor, muff_acao_motor_t *acao);
+  // Aplica a {acao} ao {motor}: imediatamente, ou, se for o motor do
+  // temporizador e a interrupcao do Timer1 estiver no meio dos calculos
+  // de um passo, assim que eles terminarem e antes do passo seguinte.  Deve ser 
+  // chamada com as interrupcoes desabilitadas, por exemplo de dentro
+  // de outra interrupcao.  Soh uma acao pode ficar adiada de cada vez.
+
+void temporizador_define_observador(muff_observador_t *obs);
+  // Define a funcao {obs} (ou nenhuma, se NULL) a ser chamada pela
+  // interrupcao depois de cada passo.  Ela eh chamada com as 
+  // interrupcoes desabilitadas, e portanto deve ser breve.
+
+#endif
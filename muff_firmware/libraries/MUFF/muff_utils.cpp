@@ -5,113 +5,521 @@
 #include "Arduino.h"
 #include <AccelStepper.h>
 #include <muff_utils.h>
+#include <muff_temporizador.h>
+#include <muff_perfil.h>
 
 // -----------------------------------------------------------
 // UTILITARIOS PARA COMUNICACAO
 
-#define bauds_serial (9600)
-  // Velocidade da porta serial.
+static long bauds_serial = bauds_serial_inicial;
+  // Velocidade corrente da porta serial.
+
+static long bauds_pendente = 0;
+  // Velocidade a usar depois da resposta do comando corrente, ou 0.
 
 void inicializa_porta_serial(void)
   {
     Serial.begin(bauds_serial);
-    Serial.println("# Teste 123....");
+    muff_aviso(aviso_teste);
+  }
+
+void anuncia_firmware(void)
+  {
+    Serial.print(pronto_sinc);
+    Serial.print(F("MUFF " versao_firmware " "));
+    Serial.println(bauds_serial);
   }
 
-void muff_erro(char *mensagem)
-  { Serial.print("# ** ");
-    Serial.println(mensagem);
+bool velocidade_serial_valida(long bauds)
+  {
+    return 
+      (bauds == 9600) || (bauds == 19200) || (bauds == 38400) || (bauds == 57600) || 
+      (bauds == 115200) || (bauds == 230400) || (bauds == 250000) || (bauds == 500000) ||
+      (bauds == 1000000);
+  }
+
+void define_velocidade_serial(long bauds)
+  { bauds_pendente = bauds; }
+
+void atualiza_velocidade_serial(void)
+  {
+    if (bauds_pendente == 0) { return; }
+    Serial.flush();
+    bauds_serial = bauds_pendente;
+    bauds_pendente = 0;
+    Serial.begin(bauds_serial);
   }
 
+long velocidade_serial(void)
+  { return bauds_serial; }
+
 // -----------------------------------------------------------
 // UTILITARIOS PARA ACIONAMENTO DO MOTOR
 
-#define motor1_interfaceType (AccelStepper::DRIVER)
-  // Tipo de interface do motor de passo (2 pinos: "step" e "direction").
-  
-#define motor1_stepPin (3)                          
-  // Numero do pino "step".
-  
-#define motor1_dirPin (4)                           
-  // Numero do pino "direction".
-  
-#define motor1_disablePin (2)                        
-  // Numero do pino "enable".
+#define motor1_largura_min_pulso (2)
+  // Largura minima do pulso "step" (microssegundos). O DRV8825 exige 1.9.
+
+static int escala_motor = 1;
+  // Micropassos por pulso no modo corrente do driver: 1 no modo de 
+  // micropassos, {motor1_micropassos} no de passos inteiros.
+
+static long fase_base = 0;
+  // As posicoes (em micropassos) que caem em passos inteiros do driver
+  // sao {fase_base + k*motor1_micropassos}, para {k} inteiro.  No modo de
+  // passos inteiros, a posicao {p} do objeto {motor} corresponde 
+  // a {fase_base + p*motor1_micropassos}.
 
-AccelStepper inicializa_motor1(int max_acel)
+static bool fase_conhecida = false;
+  // True se {fase_base} corresponde de fato ao indexador do driver.  O
+  // reset do Arduino (por exemplo pelo DTR, ao abrir a porta serial) nao
+  // reinicia o driver, que continua no micropasso em que estava; assim a
+  // fase so eh conhecida se {inicializa_motor1} puder reiniciar o driver
+  // pelo pino {motor1_resetPin}.  Senao, nenhuma posicao eh considerada
+  // passo inteiro, e o modo de passos inteiros nunca eh usado.
+
+static float max_acel_motor = 0;
+static float max_tranco_motor = 0;
+  // Aceleracao e tranco maximos em micropassos (veja {define_max_acel_motor} 
+  // e {define_tranco_motor}).
+
+static long pulsos_para_micropassos(long pulsos)
+  // Converte uma posicao do objeto {motor}, no modo corrente, para micropassos.
+  { return (escala_motor == 1 ? pulsos : fase_base + pulsos*escala_motor); }
+
+static long micropassos_para_pulsos(long pos)
+  // Converte uma posicao em micropassos para o modo corrente do driver.
+  // No modo de passos inteiros, {pos} deve cair num passo inteiro.
+  { return (escala_motor == 1 ? pos : (pos - fase_base)/escala_motor); }
+
+static bool passo_inteiro(long pos)
+  // Retorna true se a posicao {pos} (em micropassos) cai num passo inteiro.
+  { return fase_conhecida && (((pos - fase_base) % motor1_micropassos) == 0); }
+
+static void define_modo_motor(muff_motor *motor, int escala)
+  // Poe o driver no modo com {escala} micropassos por pulso, convertendo
+  // a posicao, aceleracao e tranco do {motor}.  O motor deve estar parado,
+  // e, se {escala} for maior que 1, numa posicao que cai num passo inteiro.
+  {
+    long pos = pulsos_para_micropassos(motor->currentPosition());
+    escala_motor = escala;
+    int k = 0;
+    while ((motor1_micropassos >> k) > escala) { k++; }
+    digitalWrite(motor1_M0Pin, (k & 1) ? HIGH : LOW);
+    digitalWrite(motor1_M1Pin, (k & 2) ? HIGH : LOW);
+    digitalWrite(motor1_M2Pin, (k & 4) ? HIGH : LOW);
+    motor->setCurrentPosition(micropassos_para_pulsos(pos));
+    motor->setAcceleration(max_acel_motor/escala);
+#if ACCELSTEPPER_SCURVE
+    motor->setJerk(max_tranco_motor/escala);
+#endif
+  }
+
+void inicializa_motor1(muff_motor *motor, long max_acel)
   { 
-    // Cria o registro de configuracao e estado:
-    AccelStepper motor1(motor1_interfaceType, motor1_stepPin, motor1_dirPin);
-    
-    // Define o pino "disable" do motor:
-    pinMode(motor1_disablePin, OUTPUT);
-    motor1.setEnablePin(motor1_disablePin);
-    motor1.setPinsInverted(0,0,1);
-    
-    // Parametros e estado inicial:
-    motor1.disableOutputs();
-    motor1.setAcceleration(max_acel);
-    motor1.setCurrentPosition(0);
-    motor1.moveTo(0);  // Objetivo eh ficar onde estah.
-    motor1.enableOutputs();
+    // Parametros e estado inicial (os pinos, inclusive o "disable", 
+    // sao fixados pelo tipo {muff_motor}):
+    motor->setMinPulseWidth(motor1_largura_min_pulso);
+    motor->disableOutputs();
+    pinMode(motor1_M0Pin, OUTPUT);
+    pinMode(motor1_M1Pin, OUTPUT);
+    pinMode(motor1_M2Pin, OUTPUT);
+    if (motor1_resetPin >= 0)
+      { // Volta o indexador do driver a posicao inicial, que eh um passo inteiro:
+        pinMode(motor1_resetPin, OUTPUT);
+        digitalWrite(motor1_resetPin, LOW);
+        delayMicroseconds(10);
+        digitalWrite(motor1_resetPin, HIGH);
+        fase_base = 0;
+        fase_conhecida = true;
+      }
+    max_acel_motor = max_acel;
+    escala_motor = 0;  // Forca a definicao dos pinos de modo.
+    define_modo_motor(motor, 1);
+    motor->setCurrentPosition(0);
+    motor->moveTo(0);  // Objetivo eh ficar onde estah.
+    energiza_motor(motor);
     
-    return motor1;
+    if (motor1_usa_temporizador) { inicializa_temporizador(motor); }
+  }
+
+void define_max_acel_motor(muff_motor *motor, long max_acel)
+  {
+    max_acel_motor = max_acel;
+    if (motor1_usa_temporizador) { noInterrupts(); }
+    motor->setAcceleration(max_acel_motor/escala_motor);
+    if (motor1_usa_temporizador) { interrupts(); }
   }
 
-void aciona_motor(AccelStepper *motor, int desloc, int max_vel)
+void define_tranco_motor(muff_motor *motor, long tranco)
   {
-    // Para o motor, se estiver em movimento:
+#if ACCELSTEPPER_SCURVE
+    max_tranco_motor = tranco;
+    if (motor1_usa_temporizador) { noInterrupts(); }
+    motor->setJerk(max_tranco_motor/escala_motor);
+    if (motor1_usa_temporizador) { interrupts(); }
+#else
+    if (tranco != 0) { muff_erro(erro_sem_perfil_s); }
+#endif
+  }
+
+static long retencao_ms = 0;
+  // Tempo que o motor continua energizado depois de parar (veja {define_retencao_motor}).
+
+static bool energizado = false;
+  // True se o motor estiver energizado.
+
+static bool ocioso = false;
+  // True se o motor ja estava parado na ultima chamada de {motor_ocioso}.
+
+static unsigned long parado_desde = 0;
+  // Valor de {millis()} quando o motor parou.
+
+void define_retencao_motor(long ms)
+  {
+    retencao_ms = ms;
+  }
+
+void energiza_motor(muff_motor *motor)
+  {
+    if (! energizado) { motor->enableOutputs(); energizado = true; }
+    ocioso = false;
+  }
+
+void motor_ocioso(muff_motor *motor)
+  {
+    if (! energizado) { return; }
+    if (! ocioso) { ocioso = true; parado_desde = millis(); }
+    if (retencao_ms == retencao_permanente) { return; }
+    if (millis() - parado_desde >= (unsigned long)retencao_ms)
+      { motor->disableOutputs(); energizado = false; }
+  }
+
+typedef void muff_acionamento_t(muff_motor *motor, long valor, int max_vel);
+  // Tipo das funcoes {aciona_motor*} que podem ser adiadas por {adia_movimento}.
+
+static muff_acionamento_t *acionamento_pendente = NULL;
+static long valor_pendente;
+static int max_vel_pendente;
+  // Movimento a iniciar quando o motor parar, ou NULL se nao houver
+  // (veja {adia_movimento}).
+
+static bool motor_girando(muff_motor *motor)
+  // Retorna {motor->isRunning()}, lido com as interrupcoes desabilitadas
+  // se os passos forem gerados pelo temporizador.
+  {
+    if (! motor1_usa_temporizador) { return motor->isRunning(); }
+    noInterrupts();
+    bool rodando = motor->isRunning();
+    interrupts();
+    return rodando;
+  }
+
+static bool adia_movimento(muff_motor *motor, muff_acionamento_t *aciona, long valor, int max_vel)
+  // Se o {motor} estiver girando, comeca a desacelera-lo e guarda a
+  // chamada {aciona(motor,valor,max_vel)}, no lugar de qualquer outra
+  // jah guardada, para {motor_gera_passos} executar quando ele parar.  
+  // Retorna true nesse caso, false se o motor estiver parado.
+  {
+    if (! motor_girando(motor)) { acionamento_pendente = NULL; return false; }
     para_motor(motor);
+    acionamento_pendente = aciona;
+    valor_pendente = valor;
+    max_vel_pendente = max_vel;
+    return true;
+  }
+
+bool motor_em_movimento(muff_motor *motor)
+  {
+    return (acionamento_pendente != NULL) || motor_girando(motor);
+  }
+
+void motor_gera_passos(muff_motor *motor)
+  {
+    if (! motor1_usa_temporizador) 
+      { 
+#if muff_usa_perfil
+        unsigned long t0 = perfil_marca();
+        unsigned long intervalo = motor->stepInterval();
+        long pos = motor->currentPosition();
+        motor->run();
+        perfil_mede_desde(perfil_passos, t0);
+        perfil_passo(motor->currentPosition() != pos, t0, intervalo);
+#else
+        motor->run(); 
+#endif
+      }
+    if ((acionamento_pendente != NULL) && (! motor_girando(motor)))
+      { // Acabou a desaceleracao; inicia o movimento guardado:
+        muff_acionamento_t *aciona = acionamento_pendente;
+        acionamento_pendente = NULL;
+        aciona(motor, valor_pendente, max_vel_pendente);
+      }
+  }
+
+long nanometros_para_passos(long nm)
+  {
+    // Separa os passos inteiros para nao estourar {long}:
+    long npp = nanometros_por_passo_inteiro;
+    long mnm = (nm >= 0 ? nm : - nm);
+    long passos = (mnm/npp)*motor1_micropassos + ((mnm % npp)*motor1_micropassos + npp/2)/npp;
+    return (nm >= 0 ? passos : - passos);
+  }
+
+void aciona_motor(muff_motor *motor, long desloc, int max_vel)
+  {
+    // Se o motor estiver em movimento, o deslocamento conta a partir de onde ele parar:
+    if (adia_movimento(motor, aciona_motor, desloc, max_vel)) { return; }
+    aciona_motor_para(motor, posicao_motor(motor) + desloc, max_vel);
+  }
+
+static void inicia_movimento(muff_motor *motor, long alvo, int max_vel, bool inteiros)
+  // Inicia o movimento do {motor} para a posicao {alvo} (micropassos), 
+  // em passos inteiros se {inteiros} for true e senao em micropassos.  
+  // O motor deve estar parado.
+  {
+    // O motor estah parado, e portanto o temporizador tambem:
+    define_modo_motor(motor, (inteiros ? motor1_micropassos : 1));
+    energiza_motor(motor);
+    motor->setMaxSpeed(((float)max_vel)/escala_motor);
+    motor->moveTo(micropassos_para_pulsos(alvo));
+    if (motor1_usa_temporizador) { temporizador_acorda(); }
+  }
+
+void aciona_motor_para(muff_motor *motor, long alvo, int max_vel)
+  {
+    if (adia_movimento(motor, aciona_motor_para, alvo, max_vel)) { return; }
     
-    motor->disableOutputs();
-    motor->setMaxSpeed(max_vel);
-    motor->setCurrentPosition(0);
-    motor->moveTo(desloc);
-    motor->enableOutputs();
+    long pos = posicao_motor(motor);
+    bool inteiros = 
+      (motor1_micropassos > 1) && 
+      (labs(alvo - pos) >= motor1_desloc_min_inteiro) && 
+      passo_inteiro(pos) && passo_inteiro(alvo);
+    inicia_movimento(motor, alvo, max_vel, inteiros);
     // Serial.print('>'); Serial.print(motor->distanceToGo());
     // if (motor->isRunning()) { Serial.print('$'); } else { Serial.print('*'); }
   } 
+
+void aciona_motor_micropassos(muff_motor *motor, long desloc, int max_vel)
+  {
+    if (adia_movimento(motor, aciona_motor_micropassos, desloc, max_vel)) { return; }
+    inicia_movimento(motor, posicao_motor(motor) + desloc, max_vel, false);
+  }
+
+void motor_em_micropassos(muff_motor *motor)
+  {
+    if (motor_em_movimento(motor)) { return; }
+    if (escala_motor != 1) { define_modo_motor(motor, 1); }
+  }
+
+long duracao_movimento_motor(muff_motor *motor, long desloc, int max_vel)
+  {
+    long pos = posicao_motor(motor);
+    bool inteiros = 
+      (motor1_micropassos > 1) && 
+      (labs(desloc) >= motor1_desloc_min_inteiro) && 
+      passo_inteiro(pos) && passo_inteiro(pos + desloc);
+    long escala = (inteiros ? motor1_micropassos : 1);
+    // Com a aceleracao e o tranco do modo do movimento:
+    return (long)motor->moveDuration(desloc/escala, ((float)max_vel)/escala, max_acel_motor/escala, max_tranco_motor/escala);
+  }
+
+#if ACCELSTEPPER_RAMP_TABLE
+static uint16_t tabela_rampa[max_intervalos_rampa];
+  // Intervalos entre passos (microssegundos) precalculados por {prepara_rampa_motor}.
+
+static uint8_t num_intervalos_rampa = 0;
+  // Numero de entradas usadas em {tabela_rampa}, ou 0 se ela nao vale.
+
+static long desloc_rampa;
+static int max_vel_rampa;
+static float acel_rampa;
+static float tranco_rampa;
+  // Parametros do movimento para o qual {tabela_rampa} foi calculada.
+
+static float tranco_motor(muff_motor *motor)
+  // Retorna o tranco maximo corrente do {motor}, ou 0 se o perfil for trapezoidal.
+  {
+#if ACCELSTEPPER_SCURVE
+    return motor->jerk();
+#else
+    (void)(motor);
+    return 0.0;
+#endif
+  }
+#endif
+
+void prepara_rampa_motor(muff_motor *motor, long desloc, int max_vel)
+  {
+#if ACCELSTEPPER_RAMP_TABLE
+    if (motor_em_movimento(motor)) { num_intervalos_rampa = 0; return; }
+    motor_em_micropassos(motor);
+    desloc_rampa = (desloc >= 0 ? desloc : -desloc);
+    max_vel_rampa = max_vel;
+    acel_rampa = motor->acceleration();
+    tranco_rampa = tranco_motor(motor);
+    num_intervalos_rampa = motor->buildRampTable(desloc_rampa, max_vel, tabela_rampa, max_intervalos_rampa);
+#endif
+  }
+
+void aciona_motor_rampa(muff_motor *motor, long desloc, int max_vel)
+  {
+#if ACCELSTEPPER_RAMP_TABLE
+    // A tabela supoe que o movimento comeca do repouso:
+    if (adia_movimento(motor, aciona_motor_rampa, desloc, max_vel)) { return; }
+    motor_em_micropassos(motor);
+    if 
+      ( (num_intervalos_rampa == 0) || 
+        (desloc_rampa != (desloc >= 0 ? desloc : -desloc)) || 
+        (max_vel_rampa != max_vel) ||
+        (acel_rampa != motor->acceleration()) || 
+        (tranco_rampa != tranco_motor(motor))
+      )
+      { prepara_rampa_motor(motor, desloc, max_vel); }
+    if (num_intervalos_rampa > 0)
+      { // O motor estah parado, e portanto o temporizador tambem:
+        energiza_motor(motor);
+        motor->moveWithRamp(desloc, tabela_rampa, num_intervalos_rampa);
+        if (motor1_usa_temporizador) { temporizador_acorda(); }
+        return;
+      }
+#endif
+    aciona_motor_micropassos(motor, desloc, max_vel);
+  }
+
+int enfileira_movimento(muff_motor *motor, long alvo, int max_vel)
+  {
+    if (acionamento_pendente != NULL) { return erro_movimento_adiado; }
+    if (! motor_girando(motor)) 
+      { aciona_motor_para(motor, alvo, max_vel); return 0; }
+#if ACCELSTEPPER_QUEUE_SIZE
+    // O motor pode ter parado desde a consulta acima; nesse caso 
+    // {queueMoveTo} inicia o movimento como {moveTo}, no mesmo modo:
+    if ((escala_motor != 1) && (! passo_inteiro(alvo))) { return erro_alvo_fracionario; }
+    energiza_motor(motor);
+    if (motor1_usa_temporizador) { noInterrupts(); }
+    bool ok = motor->queueMoveTo(micropassos_para_pulsos(alvo), ((float)max_vel)/escala_motor);
+    if (motor1_usa_temporizador) { interrupts(); temporizador_acorda(); }
+    return (ok ? 0 : erro_fila_cheia);
+#else
+    return erro_sem_fila;
+#endif
+  }
   
-void para_motor(AccelStepper *motor)
+long posicao_motor(muff_motor *motor)
+  {
+    if (! motor1_usa_temporizador) { return pulsos_para_micropassos(motor->currentPosition()); }
+    noInterrupts();
+    long pos = motor->currentPosition();
+    interrupts();
+    return pulsos_para_micropassos(pos);
+  }
+
+long alvo_motor(muff_motor *motor)
   {
-    if (motor->isRunning()) 
+    if (motor1_usa_temporizador) { noInterrupts(); }
+    long alvo = motor->targetPosition();
+    if (motor1_usa_temporizador) { interrupts(); }
+    return pulsos_para_micropassos(alvo);
+  }
+
+long velocidade_motor(muff_motor *motor)
+  {
+    if (motor1_usa_temporizador) { noInterrupts(); }
+    float vel = motor->speed();
+    if (motor1_usa_temporizador) { interrupts(); }
+    return (long)(vel*escala_motor);
+  }
+
+int estado_motor(muff_motor *motor)
+  {
+    if (acionamento_pendente != NULL) 
+      { return motor_estado_adiado; }
+    else if (motor_girando(motor))
+      { return motor_estado_girando; }
+    else
+      { return motor_estado_parado; }
+  }
+
+void define_posicao_motor(muff_motor *motor, long posicao)
+  {
+    interrompe_motor(motor);
+    motor_em_micropassos(motor);
+    // Preserva a fase do driver em relacao aos passos inteiros:
+    long fase = (motor->currentPosition() - fase_base) % motor1_micropassos;
+    fase_base = (posicao - fase) % motor1_micropassos;
+    if (fase_base < 0) { fase_base += motor1_micropassos; }
+    motor->setCurrentPosition(posicao);
+  }
+
+void para_motor(muff_motor *motor)
+  {
+    acionamento_pendente = NULL;
+    if (motor_girando(motor)) 
       { // Define o objetivo do motor como sendo "parar o mais cedo possivel":
+        if (motor1_usa_temporizador) { noInterrupts(); }
         motor->stop();
-        // Espera o motor parar: 
-        while (motor->isRunning()) { motor->run(); }
-        motor->disableOutputs();
+        if (motor1_usa_temporizador) { interrupts(); temporizador_acorda(); }
       }
   }
 
+void interrompe_motor(muff_motor *motor)
+  {
+    acionamento_pendente = NULL;
+    // Objetivo e posicao iguais, velocidade zero; o temporizador para no proximo tique:
+    if (motor1_usa_temporizador) { noInterrupts(); }
+    motor->setCurrentPosition(motor->currentPosition());
+    if (motor1_usa_temporizador) { interrupts(); }
+  }
+
 // -----------------------------------------------------------
 // UTILITARIOS PARA ACIONAMENTO DOS LEDS
 
 #define leds_latchPin (8)
+#if leds_usa_spi
+#define leds_clockPin (13) // SCK.
+#define leds_dataPin (11)  // MOSI.
+#else
 #define leds_clockPin (9)
 #define leds_dataPin (6)
+#endif
 
-void inicializa_leds(int estados_dos_leds[])
+void inicializa_leds(uint8_t estados_dos_leds[])
   { 
     // Inicializa o estado dos pinos do multiplexador:
-    pinMode(leds_latchPin, OUTPUT);
+    FastPin<leds_latchPin>::output();
     pinMode(leds_clockPin, OUTPUT);
     pinMode(leds_dataPin, OUTPUT); 
+#if leds_usa_spi
+    // O pino SS (10) precisa ser saida, senao um {LOW} nele tira o SPI do modo mestre:
+    pinMode(10, OUTPUT);
+    // SPI mestre, modo 0, bit menos significativo primeiro, {F_CPU/4}:
+    SPCR = (1 << SPE) | (1 << MSTR) | (1 << DORD);
+    SPSR &= ~(1 << SPI2X);
+#endif
     
     // Garante e lembra que todos os LEDs est�o apagados:
     aciona_todos_os_leds(0,estados_dos_leds);
   }
 
-void atualiza_leds(int estados_dos_leds[])
+void atualiza_leds(uint8_t estados_dos_leds[])
   // (Re)envia o vetor {estados_dos_leds[0..2]} para o multiplexador.
   {
-    digitalWrite(leds_latchPin, LOW);
-    shiftOut(leds_dataPin, leds_clockPin, LSBFIRST, estados_dos_leds[0]);
-    shiftOut(leds_dataPin, leds_clockPin, LSBFIRST, estados_dos_leds[1]);
-    shiftOut(leds_dataPin, leds_clockPin, LSBFIRST, estados_dos_leds[2]);
-    digitalWrite(leds_latchPin, HIGH);
+    unsigned long t0 = perfil_marca();
+    FastPin<leds_latchPin>::low();
+    for (int grupo = 0; grupo < 3; grupo++)
+      { 
+#if leds_usa_spi
+        SPDR = (uint8_t)estados_dos_leds[grupo];
+        while (! (SPSR & (1 << SPIF))) { }
+#else
+        shiftOut(leds_dataPin, leds_clockPin, LSBFIRST, estados_dos_leds[grupo]);
+#endif
+      }
+    FastPin<leds_latchPin>::high();
+    perfil_mede_desde(perfil_leds, t0);
   }
 
-void aciona_um_led(int indice_led, int estado, int estados_dos_leds[])
+void aciona_um_led(int indice_led, int estado, uint8_t estados_dos_leds[])
   { 
     int grupo = indice_led / 8; // Indice do grupo de 8 LEDs (0 a 2).
     int indice_bit = (indice_led + 7) % 8;  // Indice do bit no grupo (0 a 7).
@@ -127,7 +535,7 @@ void aciona_um_led(int indice_led, int estado, int estados_dos_leds[])
     atualiza_leds(estados_dos_leds);
   }
     
-void aciona_todos_os_leds(int estado, int estados_dos_leds[])
+void aciona_todos_os_leds(int estado, uint8_t estados_dos_leds[])
   { 
     for (int grupo = 0; grupo < 3; grupo++)
       { if (estado == 1)
@@ -141,3 +549,16 @@ void aciona_todos_os_leds(int estado, int estados_dos_leds[])
       }
     atualiza_leds(estados_dos_leds);
   }
+
+void aciona_leds_mascara(uint32_t mascara, uint8_t estados_dos_leds[])
+  { 
+    for (int grupo = 0; grupo < 3; grupo++) { estados_dos_leds[grupo] = 0; }
+    for (int indice_led = 0; indice_led < num_leds; indice_led++)
+      { if ((mascara >> indice_led) & 1)
+          { int grupo = indice_led / 8; // Indice do grupo de 8 LEDs (0 a 2).
+            int indice_bit = (indice_led + 7) % 8;  // Indice do bit no grupo (0 a 7).
+            estados_dos_leds[grupo] |= (1 << indice_bit);
+          }
+      }
+    atualiza_leds(estados_dos_leds);
+  }
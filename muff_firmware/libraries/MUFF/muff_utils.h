@@ -5,16 +5,53 @@
 #ifndef muff_utils_H
 #define muff_utils_H
 
+#include <AccelStepper.h>
+#include <FastStepper.h>
+#include <muff_mensagens.h>
+
 // -----------------------------------------------------------
 // UTILITARIOS PARA COMUNICACAO
 
+#define versao_firmware "2.1"
+  // Versao do firmware, enviada em {anuncia_firmware}.
+
+#define pronto_sinc '!'
+  // Primeiro caracter da linha enviada por {anuncia_firmware}.
+
+#define bauds_serial_inicial (115200L)
+  // Velocidade da porta serial no inicio (bits/s).
+
 void inicializa_porta_serial(void);
-  // Inicializa a porta serial com a velocidade certa
-  // e escreve nela uma mensagem de teste.
+  // Inicializa a porta serial com a velocidade {bauds_serial_inicial}
+  // e escreve nela uma mensagem de teste.  As mensagens de
+  // diagnostico e de erro estao em {muff_mensagens.h}.
+
+void anuncia_firmware(void);
+  // Envia pela porta serial a linha "{pronto_sinc}MUFF {versao} {bauds}",
+  // onde {versao} eh {versao_firmware} e {bauds} a velocidade corrente
+  // da porta, que avisa o computador de que o firmware estah pronto
+  // para receber comandos.  Esta linha eh enviada mesmo com
+  // {muff_verbosidade} igual a 0.
+
+bool velocidade_serial_valida(long bauds);
+  // Retorna true se {bauds} for uma das velocidades aceitas pela
+  // porta serial: 9600, 19200, 38400, 57600, 115200, 230400, 250000,
+  // 500000 ou 1000000 bits/s.  (No ATmega328P a 16 MHz, as tres 
+  // ultimas sao exatas; 115200 tem erro de cerca de 2%.)
+
+void define_velocidade_serial(long bauds);
+  // Anota que a porta serial deve passar para a velocidade {bauds},
+  // que deve ser valida.  A mudanca soh eh feita por
+  // {atualiza_velocidade_serial}, para que a resposta do comando
+  // corrente ainda use a velocidade antiga.
 
-void muff_erro(char *mensagem);
-  // Escreve na porta serial uma linha "# ** {mensagem}".
-  // NAO termina o programa.
+void atualiza_velocidade_serial(void);
+  // Se houver mudanca de velocidade anotada por {define_velocidade_serial},
+  // espera os bytes jah escritos na porta serial sairem e reinicializa
+  // a porta com a nova velocidade.
+
+long velocidade_serial(void);
+  // Velocidade corrente da porta serial (bits/s).
 
 // -----------------------------------------------------------
 // UTILITARIOS PARA ACIONAMENTO DOS LEDS
@@ -24,57 +61,300 @@ void muff_erro(char *mensagem);
   
 #define num_bytes_leds (((num_leds) + 7)/8)
   // Numero de bytes no vetor de estados dos LEDs.
+
+#ifndef leds_usa_spi
+#define leds_usa_spi (0)
+#endif
+  // Se 1, os bytes sao enviados ao multiplexador pelo periferico SPI 
+  // do ATmega328P (dados no pino 11, relogio no 13, cerca de 2 
+  // microssegundos por byte).  Nesse caso o pino 10 (SS) fica reservado
+  // como saida, e a chave de fim de curso vai para o pino 12.  Se 0 (o
+  // padrao, que corresponde a fiacao original), os bytes sao enviados por
+  // {shiftOut} (dados no pino 6, relogio no 9).  O pino "latch" eh o 8 em
+  // ambos os casos.  Usar 1 exige refazer a fiacao (veja {00-README}).
+
+#if leds_usa_spi && (! FASTSTEPPER_PORT_IO)
+#error "leds_usa_spi requer o ATmega328P"
+#endif
   
 // As funcoes abaixo usam e modificam o vetor de inteiros 
 // {estados_dos_leds[0..num_bytes_leds-1]} cujos bits descrevem
 // os estados correntes dos LEDs (0 = desligado, 1 = ligado).
 // Cada elemento do vetor contem os estados de 8 LEDs.
 
-void inicializa_leds(int estados_dos_leds[]);
+void inicializa_leds(uint8_t estados_dos_leds[]);
   // Inicializa os pinos de controle do multiplexador de 
   // LEDs para saida.  Inicializa todos os LEDs
   // para "apagado".
   
-void aciona_um_led(int indice_led, int estado, int estados_dos_leds[]);
+void aciona_um_led(int indice_led, int estado, uint8_t estados_dos_leds[]);
   // Aciona o LED de indice {indice_led} (de 0 a {num_leds-1}) 
   // para o {estado} indicado (0 = desligado, 1 = ligado).
 
-void aciona_todos_os_leds(int estado, int estados_dos_leds[]);
+void aciona_todos_os_leds(int estado, uint8_t estados_dos_leds[]);
   // Aciona todos os LEDs para o {estado} indicado (0 = desligado, 1 = ligado).
+
+void aciona_leds_mascara(uint32_t mascara, uint8_t estados_dos_leds[]);
+  // Liga o LED de indice {k} se o bit {k} da {mascara} for 1, e o
+  // desliga se for 0, para todo {k} em {0..num_leds-1}.  Os novos
+  // estados sao enviados ao multiplexador de uma so vez.
   
 // -----------------------------------------------------------
 // UTILITARIOS PARA ACIONAMENTO DO MOTOR
   
-#define nanometros_por_passo (6250)   
-  // Deslocamento do carro por passo do motor principal (nm).
+#define nanometros_por_passo_inteiro (6250L)   
+  // Deslocamento do carro por passo inteiro ("full step") do motor 
+  // principal (nm).
 
-AccelStepper inicializa_motor1(int maxAcel);
-  // Cria um objeto do tipo {AccelStepper} que vai representar
+#define motor1_micropassos (8)
+  // Numero de micropassos por passo inteiro no modo fino do driver 
+  // (1, 2, 4, 8, 16 ou 32).  Posicoes, deslocamentos, velocidades e
+  // aceleracoes do motor, no firmware e nos comandos, sao medidos em
+  // micropassos; cada um desloca o carro de 
+  // {nanometros_por_passo_inteiro/motor1_micropassos} nm (781.25 nm).
+  // Se 1, o driver fica sempre em passos inteiros.
+
+long nanometros_para_passos(long nm);
+  // Converte um deslocamento de {nm} nanometros para o numero 
+  // inteiro de micropassos mais proximo.
+
+#if defined(__AVR__)
+#define motor1_usa_temporizador (1)
+#else
+#define motor1_usa_temporizador (0)
+#endif
+  // Se 1, os passos do motor 1 sao gerados pela interrupcao do Timer1
+  // (veja {muff_temporizador.h}), e o loop principal so precisa
+  // tratar os comandos.  Se 0, os passos sao gerados pelas
+  // chamadas de {motor_gera_passos} no loop principal.
+
+#define motor1_stepPin (3)                          
+  // Numero do pino "step".
+  
+#define motor1_dirPin (4)                           
+  // Numero do pino "direction".
+  
+#define motor1_disablePin (2)                        
+  // Numero do pino "enable" ({LOW} = habilitado, {HIGH} = desabilitado).
+
+#define motor1_M0Pin (A0)
+#define motor1_M1Pin (A1)
+#define motor1_M2Pin (A2)
+  // Pinos que selecionam o modo de micropasso do DRV8825: o numero de 
+  // micropassos por passo inteiro eh {2^k}, onde {k} eh o numero binario
+  // {M2 M1 M0}.
+
+#ifndef motor1_resetPin
+#define motor1_resetPin (-1)
+#endif
+  // Numero do pino ligado ao "reset" do DRV8825 ({LOW} = volta o indexador
+  // a posicao inicial), ou -1 se ele nao estiver ligado ao Arduino (por
+  // exemplo, -Dmotor1_resetPin=A3 na compilacao).  Sem ele, a fase do
+  // driver eh desconhecida e os movimentos sao sempre em micropassos
+  // (veja {motor1_desloc_min_inteiro}).
+
+#define motor1_desloc_min_inteiro (50L*motor1_micropassos)
+  // Deslocamento minimo (micropassos) para que {aciona_motor} use passos
+  // inteiros, se a fase do driver for conhecida (veja {motor1_resetPin}).
+
+typedef FastStepper<AccelStepper::DRIVER, motor1_stepPin, motor1_dirPin, motor1_disablePin, false, false, true> muff_motor;
+  // Tipo do objeto que representa a configuracao e estado do motor 
+  // de passo 1. Eh um {AccelStepper} cujos pinos e tipo de interface
+  // (2 pinos: "step" e "direction") sao fixados em tempo de compilacao.
+  // As funcoes abaixo devem receber um {muff_motor}, e nao um
+  // {AccelStepper}, para que {run()} e {runStep()} sejam os de
+  // {FastStepper}.
+
+void inicializa_motor1(muff_motor *motor, long maxAcel);
+  // Inicializa o objeto {*motor} que representa
   // a configuracao e estado do motor de passo 1 (principal,
   // que move a camera verticalmente).
   // 
   // Define a aceleracao maxima {maxAcel} (passos/segundo^2).
-  // Inicializa o estado como "parado".
+  // Inicializa o estado como "parado".  Se {motor1_usa_temporizador}
+  // for 1, associa o {motor} ao Timer1; portanto {*motor} deve
+  // ser o objeto definitivo, nao uma copia.
   //
-  // Esta funcao supoe que os pinos 3 e 4 do Arduino sao
-  // "step" e "direction" do motor 1, e que o pino 2 significa 
-  // "enable" quando {LOW}, "disable" quando {HIGH}.
+  // Os pinos sao os definidos acima, no tipo {muff_motor}.
+
+void define_max_acel_motor(muff_motor *motor, long max_acel);
+  // Define a aceleracao maxima (micropassos/segundo^2) do {motor}.  Se ele
+  // estiver em movimento, a nova aceleracao vale a partir do proximo passo.
 
-void aciona_motor(AccelStepper *motor, int desloc, int max_vel);
+void define_tranco_motor(muff_motor *motor, long tranco);
+  // Define a taxa maxima de variacao da aceleracao (passos/segundo^3) do
+  // {motor} (veja {AccelStepper::setJerk}).  Se {tranco} for positivo, o 
+  // perfil de velocidade passa a ser em "S": a aceleracao cresce e decresce
+  // gradualmente, e o carro para sem solavanco, assentando mais depressa.
+  // Se for zero, volta ao perfil trapezoidal.  Nesse perfil os calculos
+  // apos cada passo usam ponto flutuante (algumas centenas de 
+  // microssegundos), o que limita a velocidade a uns 1000 passos/segundo.
+
+#define retencao_permanente (-1L)
+  // Valor de {define_retencao_motor} que mantem o motor sempre energizado.
+
+void define_retencao_motor(long retencao_ms);
+  // Define por quanto tempo o motor continua energizado (segurando o 
+  // carro na posicao) depois de parar: {retencao_ms} milissegundos, ou 
+  // para sempre se for {retencao_permanente}.  Com 0 o motor eh
+  // desenergizado assim que para, como antes; mas entao o rotor pode 
+  // pular ateh um micropasso quando for energizado de novo no inicio do
+  // movimento seguinte.
+
+void energiza_motor(muff_motor *motor);
+  // Energiza o {motor}, se ja nao estiver energizado, e anota que ele
+  // vai se mover.  Deve ser chamada antes de iniciar cada movimento.
+
+void motor_ocioso(muff_motor *motor);
+  // Deve ser chamada a cada volta do loop principal enquanto o {motor}
+  // estiver parado.  Desenergiza o motor quando o tempo definido por
+  // {define_retencao_motor} tiver passado desde que ele parou.  Nao mexe
+  // nos pinos enquanto isso, nem depois.
+
+bool motor_em_movimento(muff_motor *motor);
+  // Retorna true se {motor->isRunning()}, ou se houver um movimento
+  // esperando o motor parar para comecar (veja {aciona_motor}).  Se os
+  // passos forem gerados pelo temporizador, faz a consulta com as
+  // interrupcoes desabilitadas, para nao ler o estado do motor pela metade.
+
+void motor_gera_passos(muff_motor *motor);
+  // Deve ser chamada a cada volta do loop principal enquanto 
+  // {motor_em_movimento(motor)} for true.  Se os passos forem gerados 
+  // pelo loop principal, chama {motor->run()}, que dah um passo se for
+  // o momento.  Se o motor acabou de parar e havia um movimento 
+  // esperando, inicia esse movimento.
+
+void aciona_motor(muff_motor *motor, long desloc, int max_vel);
   // Define o objetivo do motor como sendo
-  // mover {desloc} passos a partir da posicao corrente,
-  // e executa {motor.enableOutputs()}. 
+  // mover {desloc} micropassos a partir da posicao corrente,
+  // e executa {energiza_motor(motor)}.  A posicao
+  // do motor eh absoluta: nao eh zerada a cada movimento.
   // 
-  // Define tambem a velocidade maxima {maxVel} (passos/segundo)
+  // Define tambem a velocidade maxima {maxVel} (micropassos/segundo)
   // permitida durante esse movimento.
+  //
+  // Se {desloc} for pelo menos {motor1_desloc_min_inteiro}, e as 
+  // posicoes inicial e final cairem em passos inteiros do driver, 
+  // o driver eh posto no modo de passos inteiros durante o movimento,
+  // que assim precisa de {motor1_micropassos} vezes menos pulsos.
+  // Senao, o movimento eh feito em micropassos.
+  //
+  // Se o motor jah estiver em movimento, esta funcao apenas comeca a
+  // desacelera-lo (como {para_motor}) e guarda o novo movimento, que
+  // {motor_gera_passos} inicia quando ele parar; o deslocamento {desloc}
+  // conta a partir desse ponto.  Outra chamada antes disso substitui o
+  // movimento guardado, e {para_motor} ou {interrompe_motor} o cancela.
   
-  // Esta funcao deve ser chamada retorna imediatamente.  Quem chamou
-  // deve usar {motor.run()} para efetuar o movimento,
-  // ateh {motor.isRunning()} retornar falso, e 
-  // entao executar {motor.disableOutputs()}.
+  // Esta funcao retorna imediatamente.  Quem chamou
+  // deve usar {motor_gera_passos(motor)} para efetuar o movimento,
+  // ateh {motor_em_movimento(motor)} retornar falso.  O motor eh 
+  // desenergizado depois por {motor_ocioso}.
   
-void para_motor(AccelStepper *motor);
-  // Interrompe o movimento do motor, se estiver em 
-  // movimento.  Retorna apenas quando estiver parado.
+void aciona_motor_para(muff_motor *motor, long alvo, int max_vel);
+  // Como {aciona_motor}, mas o objetivo eh a posicao absoluta {alvo}.
+
+void aciona_motor_micropassos(muff_motor *motor, long desloc, int max_vel);
+  // Como {aciona_motor}, mas o movimento eh sempre feito em micropassos.
+
+void motor_em_micropassos(muff_motor *motor);
+  // Se o motor estiver parado, poe o driver no modo de micropassos; 
+  // se estiver em movimento, nao faz nada.  Nesse modo a posicao, velocidade e aceleracao do
+  // objeto {motor} sao as do firmware (em micropassos); no modo de 
+  // passos inteiros sao em passos inteiros, e devem ser obtidas pelas
+  // funcoes deste modulo.
+
+long duracao_movimento_motor(muff_motor *motor, long desloc, int max_vel);
+  // Retorna quanto tempo (microssegundos) levaria um movimento de {desloc}
+  // micropassos, a partir do repouso na posicao corrente, com velocidade 
+  // maxima {max_vel} e a aceleracao e o tranco correntes do {motor}, do
+  // primeiro ao ultimo pulso, em passos inteiros ou micropassos como 
+  // {aciona_motor} faria.  O tempo eh a soma exata dos intervalos que o
+  // {motor} usaria (veja {AccelStepper::moveDuration}); o calculo percorre
+  // os passos das rampas, mas nao os de velocidade constante.  Nao altera
+  // o estado do motor.
+
+#define max_intervalos_rampa (80)
+  // Numero maximo de intervalos guardados na tabela de {prepara_rampa_motor}.
+  // Basta para deslocamentos de ateh 160 micropassos (125 um), ou para 
+  // qualquer deslocamento cuja aceleracao ateh {max_vel} leve ateh 80
+  // micropassos.
+
+void prepara_rampa_motor(muff_motor *motor, long desloc, int max_vel);
+  // Precalcula numa tabela os intervalos entre os passos de um movimento
+  // de {desloc} passos a partir do repouso, com velocidade maxima {max_vel}
+  // e a aceleracao e o tranco correntes do {motor} (veja 
+  // {AccelStepper::buildRampTable}), para uso por {aciona_motor_rampa}.
+  // Se o motor estiver em movimento, nao faz nada; a tabela sera
+  // calculada pelo proximo {aciona_motor_rampa}.
+
+void aciona_motor_rampa(muff_motor *motor, long desloc, int max_vel);
+  // Como {aciona_motor_micropassos}, mas os passos sao cronometrados pela
+  // tabela de {prepara_rampa_motor}, sem calculos durante o movimento; a 
+  // tabela eh recalculada antes se foi feita para outros parametros.  Assim,
+  // todas as repeticoes do mesmo movimento tem exatamente a mesma duracao.
+  // Se o movimento nao couber na tabela, equivale a {aciona_motor_micropassos}.
+  // Se o motor estiver em movimento, a tabela soh eh usada quando ele parar.
+
+int enfileira_movimento(muff_motor *motor, long alvo, int max_vel);
+  // Se o motor estiver parado, equivale a {aciona_motor_para}.  Senao,
+  // acrescenta o movimento para a posicao absoluta {alvo}, com velocidade
+  // maxima {max_vel}, na fila do motor (veja {AccelStepper::queueMoveTo}),
+  // sem interromper o movimento corrente.  Se o novo trecho tiver o mesmo
+  // sentido do anterior, o motor passa pela juncao sem parar.
+  // Retorna 0 se o movimento foi aceito.  Senao, retorna o codigo do 
+  // motivo, sem mostrar a mensagem: {erro_fila_cheia} se a fila estiver
+  // cheia, {erro_alvo_fracionario} se o movimento corrente for em passos
+  // inteiros e {alvo} nao cair num passo inteiro, {erro_movimento_adiado}
+  // se o motor estiver parando para iniciar outro movimento, ou 
+  // {erro_sem_fila} se a fila nao foi compilada 
+  // ({ACCELSTEPPER_QUEUE_SIZE} zero).
+
+long posicao_motor(muff_motor *motor);
+  // Retorna a posicao absoluta corrente do motor (micropassos),
+  // lida sem risco de ser alterada pela interrupcao no meio.
+
+long alvo_motor(muff_motor *motor);
+  // Retorna a posicao absoluta (micropassos) onde o movimento corrente
+  // do motor vai terminar.  Se o motor estiver parando para iniciar 
+  // outro movimento, eh a posicao onde ele vai parar.  Se estiver
+  // parado, eh a posicao corrente.
+
+long velocidade_motor(muff_motor *motor);
+  // Retorna a velocidade corrente do motor (micropassos/segundo), 
+  // positiva no sentido horario (sobe).
+
+#define motor_estado_parado ('P')
+  // Valor de {estado_motor} para motor parado, sem movimento esperando.
+
+#define motor_estado_girando ('G')
+  // Valor de {estado_motor} para motor em movimento.
+
+#define motor_estado_adiado ('A')
+  // Valor de {estado_motor} para motor desacelerando, com outro 
+  // movimento esperando ele parar (veja {aciona_motor}).
+
+int estado_motor(muff_motor *motor);
+  // Retorna {motor_estado_parado}, {motor_estado_girando} ou 
+  // {motor_estado_adiado}, conforme o estado corrente do motor.
+
+void define_posicao_motor(muff_motor *motor, long posicao);
+  // Para o motor imediatamente (veja {interrompe_motor}), se estiver 
+  // em movimento, e define sua posicao
+  // corrente como sendo {posicao} (micropassos).  Nao altera a fase do
+  // driver: as posicoes que caem em passos inteiros continuam as mesmas
+  // fisicamente.
+
+void para_motor(muff_motor *motor);
+  // Se o motor estiver em movimento, faz com que desacelere e pare o
+  // mais cedo possivel, e cancela o movimento que estiver esperando
+  // ele parar.  Retorna imediatamente; o motor para durante as
+  // chamadas seguintes de {motor_gera_passos}.  Nao desenergiza o 
+  // motor (veja {motor_ocioso}).
+
+void interrompe_motor(muff_motor *motor);
+  // Como {para_motor}, mas para o motor imediatamente, sem rampa de 
+  // desaceleracao, mesmo que ele jah esteja desacelerando.  Em alta
+  // velocidade o rotor pode perder passos; deve ser usada apenas em
+  // emergencias.
 
 #endif
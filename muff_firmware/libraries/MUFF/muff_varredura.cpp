@@ -0,0 +1,116 @@
+/* See {muff_varredura.h}. */
+
+#include "Arduino.h"
+#include <AccelStepper.h>
+#include <muff_utils.h>
+#include <muff_temporizador.h>
+#include <muff_camera.h>
+#include <muff_varredura.h>
+
+static volatile bool disparando = false;
+  // True enquanto ainda ha quadros a disparar.
+
+static bool em_movimento = false;
+  // True desde o inicio da varredura ateh o motor parar.
+
+static long inicio;
+  // Posicao do motor no inicio da varredura.
+
+static int sentido;
+  // Sentido da varredura (+1 ou -1).
+
+static unsigned int passo_quadros;
+  // Distancia entre quadros (passos).
+
+static volatile unsigned int proximo;
+  // Deslocamento desde {inicio} do proximo quadro.
+
+static int nq_total;
+  // Numero de quadros da varredura.
+
+static volatile int nd = 0;
+  // Numero de disparos registrados.
+
+static unsigned int disparos[max_quadros_varredura];
+  // Deslocamentos desde {inicio} no instante de cada disparo.
+
+static void observa(long posicao)
+  // Dispara a camera se a {posicao} cruzou a altura do proximo quadro.
+  {
+    if (! disparando) { return; }
+    long ofs = sentido*(posicao - inicio);
+    if (ofs < (long)proximo) { return; }
+    camera_dispara();
+    disparos[nd] = (unsigned int)ofs;
+    nd++;
+    proximo += passo_quadros;
+    if (nd >= nq_total) { disparando = false; }
+  }
+
+bool varredura_inicia(muff_motor *motor, int nq, long desloc, int vel)
+  {
+    if ((nq <= 0) || (nq > max_quadros_varredura) || (desloc == 0) || (labs(desloc) > 32767L) || (vel <= 0)) { return false; }
+    
+    // O inicio eh deduzido do objetivo, que so vale se o movimento comecar agora:
+    if (motor_em_movimento(motor)) { return false; }
+    
+    // A varredura eh sempre em micropassos:
+    motor_em_micropassos(motor);
+
+    // Distancia para atingir a velocidade {vel} (mais um passo de folga); com
+    // tranco, a aceleracao tambem cresce aos poucos e a rampa eh mais longa:
+    float acel = motor->acceleration();
+    float dist = ((float)vel)*vel/(2.0*acel);
+#if ACCELSTEPPER_SCURVE
+    if (motor->jerk() > 0) { dist = AccelStepper::sCurveStopSteps(vel, 0, motor->jerk(), acel); }
+#endif
+    long rampa = (long)dist + 1;
+    long pilha = ((long)(nq - 1))*labs(desloc);
+    if (2*rampa + pilha > 32767L) { return false; }
+
+    varredura_aborta();
+    sentido = (desloc > 0 ? +1 : -1);
+    long total = sentido*(2*rampa + pilha);
+    aciona_motor_micropassos(motor, total, vel);
+    
+    // O motor pode jah ter dado um passo; o inicio eh deduzido do objetivo:
+    noInterrupts();
+    inicio = motor->targetPosition() - total;
+    passo_quadros = labs(desloc);
+    proximo = (unsigned int)rampa;
+    nq_total = nq;
+    nd = 0;
+    disparando = true;
+    interrupts();
+    em_movimento = true;
+    if (motor1_usa_temporizador) { temporizador_define_observador(observa); }
+    return true;
+  }
+
+void varredura_avanca(muff_motor *motor)
+  {
+    if (! em_movimento) { return; }
+    if (! motor1_usa_temporizador) { observa(motor->currentPosition()); }
+    if (! motor_em_movimento(motor))
+      { varredura_aborta();
+        em_movimento = false;
+        Serial.write(varredura_fim);
+      }
+  }
+
+bool varredura_ativa(void)
+  { return em_movimento; }
+
+void varredura_aborta(void)
+  {
+    noInterrupts();
+    disparando = false;
+    interrupts();
+    temporizador_define_observador(NULL);
+  }
+
+int varredura_num_disparos(void)
+  { return nd; }
+
+unsigned int varredura_disparo(int k)
+  { return disparos[k]; }
@@ -0,0 +1,56 @@
+/* Continuous-motion focus sweep for the MUFF v2.0 microscope positioner firmware. */
+
+#ifndef muff_varredura_H
+#define muff_varredura_H
+
+#include <AccelStepper.h>
+#include <muff_utils.h>
+
+// -----------------------------------------------------------
+// VARREDURA CONTINUA
+
+// Na varredura, o carro percorre toda a pilha de {nq} quadros a 
+// velocidade constante {vel}, sem parar em cada altura.  O movimento 
+// comeca e termina com rampas de aceleracao de {vel^2/(2*acel)} passos
+// (ou mais, com o perfil em S; veja {AccelStepper::sCurveStopSteps}),
+// fora da pilha.  Cada vez que a posicao do motor cruza a altura do 
+// proximo quadro (de {|desloc|} em {|desloc|} passos a partir do fim da 
+// rampa inicial), a camera eh disparada (veja {muff_camera.h}) e o 
+// deslocamento exato do motor desde o inicio da varredura eh registrado.
+// O registro pode ser lido depois pelo computador.
+//
+// Com o temporizador (veja {muff_temporizador.h}) a posicao eh 
+// examinada a cada passo, dentro da interrupcao; senao, eh examinada a 
+// cada chamada de {varredura_avanca}. Ao fim do movimento eh enviado o 
+// aviso {varredura_fim}.
+
+#define varredura_fim 'V'
+  // Aviso enviado ao computador no fim da varredura.
+
+#define max_quadros_varredura (100)
+  // Numero maximo de quadros numa varredura.
+
+bool varredura_inicia(muff_motor *motor, int nq, long desloc, int vel);
+  // Comeca uma varredura de {nq} quadros separados por {desloc} passos 
+  // (positivo para subir), a {vel} passos/segundo. Retorna false se os
+  // parametros forem invalidos, ou se o motor ainda estiver em 
+  // movimento (por exemplo, parando depois do comando '3').
+
+void varredura_avanca(muff_motor *motor);
+  // Deve ser chamada a cada volta do loop principal.  Observa a posicao
+  // do motor, se necessario, e detecta o fim da varredura.
+
+bool varredura_ativa(void);
+  // Retorna true se uma varredura estiver em andamento.
+
+void varredura_aborta(void);
+  // Para de disparar a camera.  Nao para o motor.
+
+int varredura_num_disparos(void);
+  // Numero de disparos registrados na ultima varredura.
+
+unsigned int varredura_disparo(int k);
+  // Deslocamento do motor (passos, em valor absoluto) desde o inicio
+  // da ultima varredura, no instante do disparo {k}, em {0..varredura_num_disparos()-1}.
+
+#endif
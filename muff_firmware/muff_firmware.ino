@@ -5,96 +5,348 @@
 #include <AccelStepper.h>
 #include <muff_utils.h>
 #include <muff_comandos.h>
+#include <muff_protocolo.h>
+#include <muff_sequenciador.h>
+#include <muff_camera.h>
+#include <muff_varredura.h>
+#include <muff_padroes.h>
+#include <muff_chave.h>
+#include <muff_telemetria.h>
+#include <muff_perfil.h>
+#include <muff_config.h>
 
 // Estado interno do firmware:
 
-int estados_dos_leds[num_bytes_leds]; // Bytes cujos bits indicam os estados correntes dos LEDs.
+uint8_t estados_dos_leds[num_bytes_leds]; // Bytes cujos bits indicam os estados correntes dos LEDs.
 
-// Parametros do motor de passo principal (a ajustar experimentalmente):
+muff_config_t config; // Parametros do motor de passo principal (veja {muff_config.h}).
 
-int motor1_max_acel = 500;   // Aceleracao maxima (passos/segundo^2).
+muff_motor motor1; // Configuracao e estado do motor.
 
-int desloc_ajuste_fino = 30;       // Passos a deslocar nos comandos '1', '2'. 
-int motor1_max_vel_fino = 80;      // Velocidade maxima no ajuste fino (passos/segundo).
+muff_sequenciador_t sequenciador; // Estado do plano de captura automatica.
 
-int desloc_ajuste_grosso = 15000;  // Passos a deslocar nos comandos '6', e '7'. 
-int motor1_max_vel_grosso = 400;   // Velocidade maxima no ajuste grosseiro (passos/segundo).
+muff_leitor_t leitor; // Estado da leitura do comando corrente no protocolo ASCII.
 
-int desloc_quadro = 0;             // Passos a deslocar no comando '5', definido pelo comando '4'.
-int motor1_max_vel_quadro = 400;   // Velocidade maxima do comando '5' (passos/segundo).
+muff_protocolo_t protocolo; // Estado da leitura do quadro corrente no protocolo binario.
 
-const int pinoChave = 10; //PINO DIGITAL UTILIZADO PELA CHAVE FIM DE CURSO
+char *formato_args(int comando)
+  // Retorna o formato dos bytes de argumento do {comando}
+  // (veja {muff_leitor_t} em {muff_comandos.h}).
+  {
+    if (comando == '4')
+      { return formato_desloc_quadro; }
+    else if ((comando == '+') || (comando == '-'))
+      { return formato_aciona_leds; }
+    else if (comando == '8')
+      { return formato_max_acel; }
+    else if (comando == '9')
+      { return formato_define_tranco; }
+    else if (comando == 'H')
+      { return formato_define_retencao; }
+    else if (comando == 'B')
+      { return formato_define_protocolo; }
+    else if (comando == 'D')
+      { return formato_define_velocidade_serial; }
+    else if (comando == 'Y')
+      { return formato_define_telemetria; }
+    else if (comando == 'A')
+      { return formato_define_parametro; }
+    else if (comando == 'I')
+      { return formato_mostra_parametro; }
+    else if (comando == 'F')
+      { return formato_configuracao; }
+    else if ((comando == 'G') || (comando == 'J'))
+      { return formato_move_motor; }
+    else if (comando == 'U')
+      { return formato_enfileira_movimento; }
+    else if (comando == 't')
+      { return formato_preve_duracao; }
+    else if (comando == 'O')
+      { return formato_busca_origem; }
+    else if (comando == 'E')
+      { return formato_define_leds; }
+    else if (comando == 'Q')
+      { return formato_define_padrao; }
+    else if (comando == 'P')
+      { return formato_define_plano; }
+    else if (comando == 'M')
+      { return formato_acrescenta_mascara; }
+    else if (comando == 'N')
+      { return formato_acrescenta_desloc_altura; }
+    else if (comando == 'C')
+      { return formato_configura_camera; }
+    else if (comando == 'V')
+      { return formato_inicia_varredura; }
+    else
+      { return ""; }
+  }
 
-AccelStepper motor1; // Configuracao e estado do motor.
+void aplica_config(void)
+  // Aplica ao motor os parametros de {config}.  Como o comando '9', 
+  // para o motor se estiver em movimento.
+  {
+    para_motor(&motor1);
+    define_max_acel_motor(&motor1, config.max_acel);
+    define_tranco_motor(&motor1, config.tranco);
+    define_retencao_motor(config.retencao_ms);
+    prepara_rampa_motor(&motor1, config.desloc_quadro, config.max_vel_quadro);
+  }
 
 void setup()
-  { inicializa_porta_serial();
+  { // Usa a configuracao gravada na EEPROM, se houver:
+    config_padrao(&config);
+    config_carrega(&config);
+
+    // Com endereco, comeca no protocolo binario, sem mensagens:
+    protocolo_define_endereco((int)config.endereco);
+
+    inicializa_porta_serial();
+  
+    inicializa_leitor(&leitor, formato_args);
+    inicializa_protocolo(&protocolo);
   
     inicializa_leds(estados_dos_leds);
+    inicializa_padroes();
+
+    inicializa_motor1(&motor1, config.max_acel);
+    aplica_config();
     
-    motor1 = inicializa_motor1(motor1_max_acel);
+    inicializa_sequenciador(&sequenciador);
+    
+    inicializa_camera();
+
+    inicializa_chave(&motor1);
 
-    pinMode(pinoChave, INPUT_PULLUP); //DEFINE O PINO COMO ENTRADA / "_PULLUP" É PARA ATIVAR O RESISTOR INTERNO DO ARDUINO PARA GARANTIR QUE NÃO EXISTA FLUTUAÇÃO ENTRE 0 (LOW) E 1 (HIGH)
+    inicializa_perfil();
 
     // Prompt em caso de interacao direta com usuario
-    Serial.println("# Digite comando ('1', '2', etc) e clique em ENVIAR...");
+    muff_aviso(aviso_digite);
+
+    // Avisa o computador de que estah pronto (exceto no barramento, onde as
+    // linhas de varias unidades colidiriam):
+    if (protocolo_endereco() == 0) { anuncia_firmware(); }
   }
 
-void processa_comando(int comando)
+void processa_comando(muff_comando_t *cmd)
   {
+    int comando = cmd->codigo;
+    // A resposta deve refletir apenas os erros deste comando:
+    muff_esquece_erro();
     mostra_comando(comando);
     if (comando == '1')
-      { comando_aciona_motor(&motor1, +desloc_ajuste_fino, motor1_max_vel_fino, 0); }
+      { comando_aciona_motor(&motor1, +config.desloc_fino, config.max_vel_fino); }
     else if (comando == '2')
-      { comando_aciona_motor(&motor1, -desloc_ajuste_fino, motor1_max_vel_fino, 0); }
+      { comando_aciona_motor(&motor1, -config.desloc_fino, config.max_vel_fino); }
     else if (comando == '3')
-      { comando_para_motor(&motor1); }
+      { sequenciador_aborta(&sequenciador, estados_dos_leds);
+        varredura_aborta();
+        busca_aborta();
+        comando_para_motor(&motor1);
+      }
+    else if (comando == 'X')
+      { sequenciador_aborta(&sequenciador, estados_dos_leds);
+        varredura_aborta();
+        busca_aborta();
+        comando_interrompe_motor(&motor1);
+      }
     else if (comando == '4')
-      { comando_define_desloc_quadro(&desloc_quadro); }
+      { comando_define_desloc_quadro(cmd, &config.desloc_quadro);
+        prepara_rampa_motor(&motor1, config.desloc_quadro, config.max_vel_quadro);
+      }
     else if (comando == '5')
-      { comando_aciona_motor(&motor1, desloc_quadro, motor1_max_vel_quadro, 1); }
+      { comando_desloca_quadro(&motor1, config.desloc_quadro, config.max_vel_quadro); }
     else if (comando == '+')
-      { comando_aciona_leds(1,estados_dos_leds); }
+      { comando_aciona_leds(cmd, 1, estados_dos_leds); }
     else if (comando == '-')
-      { comando_aciona_leds(0,estados_dos_leds); }
+      { comando_aciona_leds(cmd, 0, estados_dos_leds); }
     else if (comando == '6')
-      { comando_aciona_motor(&motor1, +desloc_ajuste_grosso, motor1_max_vel_grosso, 0); }
+      { comando_aciona_motor(&motor1, +config.desloc_grosso, config.max_vel_grosso); }
     else if (comando == '7')
-      { comando_aciona_motor(&motor1, -desloc_ajuste_grosso, motor1_max_vel_grosso, 0); }
+      { comando_aciona_motor(&motor1, -config.desloc_grosso, config.max_vel_grosso); }
     else if (comando == '8')
-      { comando_define_max_acel(&motor1_max_acel); }
+      { comando_define_max_acel(cmd, &config.max_acel);
+        define_max_acel_motor(&motor1, config.max_acel);
+        prepara_rampa_motor(&motor1, config.desloc_quadro, config.max_vel_quadro);
+      }
+    else if (comando == '9')
+      { comando_define_tranco(cmd, &motor1, &config.tranco); }
+    else if (comando == 'H')
+      { comando_define_retencao(cmd, &config.retencao_ms); }
+    else if (comando == 'B')
+      { comando_define_protocolo(cmd); }
+    else if (comando == 'D')
+      { comando_define_velocidade_serial(cmd); }
+    else if (comando == 'Y')
+      { comando_define_telemetria(cmd); }
+    else if (comando == 'A')
+      { if (comando_define_parametro(cmd, &config)) { aplica_config(); } }
+    else if (comando == 'I')
+      { comando_mostra_parametro(cmd, &config); }
+    else if (comando == 'F')
+      { if (comando_configuracao(cmd, &config)) { aplica_config(); } }
+    else if (comando == 'G')
+      { comando_move_motor(cmd, &motor1, config.max_vel_grosso, true); }
+    else if (comando == 'J')
+      { comando_move_motor(cmd, &motor1, config.max_vel_grosso, false); }
+    else if (comando == 'U')
+      { comando_enfileira_movimento(cmd, &motor1, config.max_vel_grosso); }
+    else if (comando == 't')
+      { comando_preve_duracao(cmd, &motor1, config.max_vel_grosso); }
+    else if (comando == 'O')
+      { comando_busca_origem(cmd, &motor1, config.max_vel_grosso, config.max_vel_fino); }
+    else if (comando == '?')
+      { comando_mostra_posicao(cmd, &motor1); }
+    else if (comando == 'K')
+      { comando_mostra_estado_motor(cmd, &motor1); }
+    else if (comando == 'R')
+      { comando_relata_perfil(cmd); }
+    else if (comando == 'Z')
+      { comando_zera_posicao(&motor1); }
+    else if (comando == 'E')
+      { comando_define_leds(cmd, estados_dos_leds); }
+    else if (comando == 'Q')
+      { comando_define_padrao(cmd); }
+    else if (comando == 'W')
+      { comando_grava_padroes(); }
+    else if ((comando >= 'a') && (comando < 'a' + max_padroes_leds))
+      { comando_seleciona_padrao(comando - 'a', estados_dos_leds); }
+    else if (comando == 'P')
+      { comando_define_plano(cmd, &sequenciador); }
+    else if (comando == 'M')
+      { comando_acrescenta_mascara(cmd, &sequenciador); }
+    else if (comando == 'N')
+      { comando_acrescenta_desloc_altura(cmd, &sequenciador); }
+    else if (comando == '>')
+      { comando_proxima_altura(&sequenciador, &motor1, config.max_vel_quadro); }
+    else if (comando == 'S')
+      { comando_inicia_sequencia(&sequenciador, config.desloc_quadro, config.max_vel_quadro); }
+    else if (comando == 'T')
+      { comando_quadro_tirado(&sequenciador); }
+    else if (comando == 'C')
+      { comando_configura_camera(cmd); }
+    else if (comando == 'V')
+      { comando_inicia_varredura(cmd, &motor1, config.desloc_quadro); }
+    else if (comando == 'L')
+      { comando_mostra_disparos(cmd); }
     else
-      { muff_erro("comando invalido");  }
+      { muff_erro(erro_comando_invalido);  }
+  }
+
+bool comando_movimenta(int comando)
+  // Retorna true se o {comando} inicia um movimento (ou uma parada com
+  // desaceleracao) que continua depois da resposta.
+  {
+    return (strchr("123567GJUOVS>", comando) != NULL);
+  }
+
+bool comando_interrompe(int comando)
+  // Retorna true se o {comando} interrompe ou substitui os movimentos 
+  // anteriores.
+  {
+    return (comando_movimenta(comando) && (comando != 'U')) || (comando == 'X') || (comando == 'Z');
+  }
+
+bool comando_envia_dados(int comando)
+  // Retorna true se o {comando} envia dados alem da resposta.
+  {
+    return (strchr("?KIRLt", comando) != NULL);
+  }
+
+bool atividade_em_andamento(void)
+  // Retorna true se a varredura, a busca da origem ou o plano de
+  // captura ainda nao terminaram.
+  {
+    return varredura_ativa() || busca_ativa() || sequenciador_ativo(&sequenciador);
+  }
 
-    // Notifica o usuario de que ocomando foi executado:
-    Serial.print('0');
+bool firmware_em_movimento(void)
+  // Retorna true se o motor, a varredura, a busca da origem ou o plano de
+  // captura ainda nao terminaram.
+  {
+    return motor_em_movimento(&motor1) || atividade_em_andamento();
+  }
+
+void processa_comando_simples(int comando)
+  // Executa um {comando} sem argumentos gerado pelo proprio firmware.
+  {
+    muff_comando_t cmd;
+    inicializa_comando(&cmd, comando);
+    processa_comando(&cmd);
+    if (! protocolo_binario()) { responde_comando(&cmd); }
   }
 
 void loop(void)
   // Loop principal do firmware. 
-  { // Gera pulsos para o motor se e como necessario:
-    if (motor1.isRunning())
+  { // Mede a duracao da volta anterior, se {muff_usa_perfil}:
+    perfil_inicio_volta();
+    
+    // Gera pulsos para o motor se e como necessario
+    // (ou deixa para o temporizador, se {motor1_usa_temporizador}):
+    if (motor_em_movimento(&motor1))
       { // Motor estah em movimento:
         // Serial.print('!'); Serial.print(motor1.distanceToGo());
-        motor1.run();
+        motor_gera_passos(&motor1);
       }
     else
-      { // Motor estah parado, desligue alimentacao para poupar energia:
-        motor1.disableOutputs();
+      { // Motor estah parado, desligue alimentacao quando for a hora:
+        motor_ocioso(&motor1);
       }
-    // Verifica se ha comando:
+    // Termina o pulso de disparo da camera e observa a exposicao:
+    camera_avanca();
+    
+    // Acompanha a varredura continua, se houver:
+    varredura_avanca(&motor1);
+    
+    // Executa o plano de captura, se houver:
+    sequenciador_avanca(&sequenciador, &motor1, estados_dos_leds);
+
+    // Envia o quadro de telemetria, se for a hora:
+    telemetria_avanca(&motor1, estados_dos_leds);
+
+    // Consome no maximo um byte de comando por volta, sem esperar pelos 
+    // seguintes, para nao atrasar os passos do motor:
     if (Serial.available() > 0) 
-      { // Chegou um comando:
-        int comando = Serial.read();
-        processa_comando(comando);
+      { // Chegou um byte de comando ou argumento:
+        int byte = Serial.read();
+        muff_comando_t *cmd = NULL;
+        if (protocolo_binario())
+          { if (protocolo_recebe_byte(&protocolo, byte)) 
+              { cmd = &(protocolo.cmd);
+                // Os argumentos devem caber nos mesmos campos que no protocolo ASCII:
+                comando_confere_args(cmd, formato_args(cmd->codigo));
+              }
+          }
+        else
+          { if (leitor_recebe_byte(&leitor, byte)) { cmd = &(leitor.cmd); } }
+        // Os dados de varias unidades colidiriam, entao nao sao difundidos:
+        if ((cmd != NULL) && cmd->difusao && comando_envia_dados(cmd->codigo)) { cmd = NULL; }
+        if (cmd != NULL) 
+          { unsigned long t0 = perfil_marca();
+            processa_comando(cmd);
+            perfil_mede_desde(perfil_comando, t0);
+            // Se o comando deu certo e substituiu os movimentos anteriores, 
+            // eles terminaram; senao os avisos esperam {firmware_em_movimento}:
+            bool aceito = cmd->ok && (! muff_erro_anotado());
+            if (comando_interrompe(cmd->codigo) && aceito && (! atividade_em_andamento()))
+              { protocolo_avisa_fins(); }
+            // No protocolo ASCII, so o '5' e o '>' respondem quando o movimento termina:
+            if (comando_movimenta(cmd->codigo) && (protocolo_binario() || (cmd->codigo == '5') || (cmd->codigo == '>')))
+              { protocolo_adia_fim(cmd); }
+            // Notifica o usuario de que o comando foi aceito:
+            responde_comando(cmd);
+            // Muda a velocidade da porta serial depois da resposta, se pedido:
+            atualiza_velocidade_serial();
+          }
       }
 
-    // Para o motor em caso de acionamento do sensor fim de curso
-    if(digitalRead(pinoChave) == LOW)
-      { //SE A LEITURA DO PINO FOR IGUAL A LOW, FAZ
-        processa_comando('2');
-        delay(1000);
-        processa_comando('3');
+    // Avisa o fim dos movimentos pedidos (ou responde o '5' e o '>', no protocolo ASCII):
+    if (protocolo_fins_pendentes() && (! firmware_em_movimento())) { protocolo_avisa_fins(); }
+
+    // O motor jah foi parado pela chave de fim de curso, se acionada;
+    // aborta o que estiver fazendo e recua, sem esperar:
+    if (chave_avanca(&motor1))
+      { processa_comando_simples('3');
+        chave_recua(&motor1, config.max_vel_fino);
       }
   }
       
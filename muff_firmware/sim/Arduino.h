@@ -0,0 +1,152 @@
+/* Simulated Arduino core for running the MUFF v2.0 firmware on a host computer. */
+
+// Este arquivo substitui o {Arduino.h} do Arduino quando o firmware eh
+// compilado pelo {Makefile} deste diretorio (veja {00-README}).  Ele
+// declara apenas o que o firmware e as bibliotecas {AccelStepper} e
+// {MUFF} usam.  O relogio ({micros}, {millis}) eh virtual: soh avanca
+// quando o simulador manda (veja {sim_avanca_relogio}) ou quando uma
+// escrita na porta serial tem que esperar o buffer de transmissao.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH (1)
+#define LOW (0)
+
+#define INPUT (0)
+#define OUTPUT (1)
+#define INPUT_PULLUP (2)
+
+#define LSBFIRST (0)
+#define MSBFIRST (1)
+
+#define DEC (10)
+#define HEX (16)
+
+#define A0 (14)
+#define A1 (15)
+#define A2 (16)
+#define A3 (17)
+
+#define F(s) (s)
+#define PROGMEM
+#define PGM_P const char *
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_ptr(p) (*(const void * const *)(p))
+#define PSTR(s) (s)
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+
+#define sim_num_pinos (20)
+  // Numero de pinos digitais simulados (0 a 13, e A0 a A5).
+
+// -----------------------------------------------------------
+// TEMPO
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void sim_avanca_relogio(unsigned long us);
+  // Avanca o relogio virtual de {us} microssegundos, entregando
+  // ao receptor serial os bytes que chegarem nesse intervalo.
+
+// -----------------------------------------------------------
+// PINOS
+
+void pinMode(uint8_t pino, uint8_t modo);
+void digitalWrite(uint8_t pino, uint8_t valor);
+int digitalRead(uint8_t pino);
+void shiftOut(uint8_t pino_dados, uint8_t pino_relogio, uint8_t ordem, uint8_t valor);
+
+typedef void sim_observador_pino_t(uint8_t pino, uint8_t valor, unsigned long us);
+  // Tipo de uma funcao chamada a cada {digitalWrite} que muda o nivel
+  // de um pino, com o instante {us} do relogio virtual.
+
+void sim_define_observador_pino(sim_observador_pino_t *obs);
+  // Define a funcao {obs} (ou nenhuma, se NULL) chamada a cada mudanca
+  // de nivel de um pino de saida.
+
+void sim_define_entrada(uint8_t pino, uint8_t valor);
+  // Define o nivel {valor} lido por {digitalRead(pino)}.  Inicialmente
+  // todas as entradas estao em {HIGH} (como com "pull-up").
+
+// -----------------------------------------------------------
+// INTERRUPCOES
+
+// No simulador nao ha interrupcoes; os passos sao sempre gerados
+// pelo loop principal (veja {motor1_usa_temporizador}).
+
+inline void noInterrupts(void) { }
+inline void interrupts(void) { }
+
+extern uint8_t SREG;
+
+// -----------------------------------------------------------
+// PORTA SERIAL
+
+class Print
+  // Destino de texto, como o {Print} do Arduino.
+  { public:
+      virtual size_t write(uint8_t c) = 0;
+      size_t write(const uint8_t *buf, size_t n);
+      size_t print(const char *s);
+      size_t print(char c);
+      size_t print(int v, int base = DEC);
+      size_t print(unsigned int v, int base = DEC);
+      size_t print(long v, int base = DEC);
+      size_t print(unsigned long v, int base = DEC);
+      size_t print(double v, int digitos = 2);
+      size_t println(void);
+      template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+      template <class T> size_t println(T v, int b) { size_t n = print(v, b); return n + println(); }
+  };
+
+class HardwareSerial : public Print
+  // Porta serial simulada.  Os bytes escritos saem pela saida padrao
+  // do simulador, no ritmo da velocidade definida por {begin}; os
+  // recebidos sao os do roteiro do simulador.
+  { public:
+      void begin(unsigned long bauds);
+      void end(void) { }
+      int available(void);
+      int read(void);
+      int peek(void);
+      int availableForWrite(void);
+      void flush(void);
+      using Print::write;
+      virtual size_t write(uint8_t c);
+      operator bool() { return true; }
+  };
+
+extern HardwareSerial Serial;
+
+#define sim_tam_buffer_serial (64)
+  // Capacidade dos buffers de transmissao e recepcao, como no Arduino Nano.
+
+void sim_recebe(const uint8_t *bytes, int n);
+  // Acrescenta {bytes[0..n-1]} aos bytes que chegam a porta serial, a
+  // partir do instante corrente, um a cada tempo de transmissao de um byte.
+
+bool sim_recepcao_pendente(void);
+  // Retorna true se ainda ha bytes de {sim_recebe} por chegar.
+
+void sim_define_eco(bool eco);
+  // Se {eco} for true (o padrao), os bytes transmitidos pela porta serial
+  // sao copiados na saida padrao; senao, sao descartados.
+
+#endif
@@ -0,0 +1,426 @@
+/* Host simulator and benchmark for the MUFF v2.0 microscope positioner firmware. */
+
+// Uso:
+//
+//   muff_sim [-l {us}] [-T {s}] [-p {arquivo}] [-q] {roteiro}
+//   muff_sim -b
+//
+// Na primeira forma, executa o firmware ({setup} e {loop}) com o
+// Arduino simulado de {Arduino.h}, enviando pela porta serial os
+// comandos do {roteiro} (veja abaixo).  Cada volta do loop principal
+// custa {-l} microssegundos do relogio virtual (padrao 10), alem do
+// tempo que o firmware esperar pela porta serial.  A simulacao termina
+// no evento "fim" do roteiro, ou quando o roteiro acaba e o motor para,
+// ou depois de {-T} segundos simulados (padrao 600).
+//
+// Os bytes enviados pelo firmware sao copiados na saida padrao, exceto
+// com a opcao {-q}.  Com {-p}, os pulsos do pino "step" do motor sao
+// escritos no {arquivo}, uma linha "{t} {pos}" por pulso, onde {t} eh o
+// instante (microssegundos) e {pos} a contagem de pulsos com sinal.
+//
+// No fim, escreve em {stderr} um relatorio de cada movimento (sequencia
+// de pulsos entre duas paradas do motor): numero de pulsos, velocidade
+// maxima, aceleracao e tranco do {motor1} no inicio, duracao, duracao
+// ideal com esses parametros, duracao dada por
+// {AccelStepper::moveDuration()}, e o maximo e a raiz da media
+// quadratica da diferenca entre o instante de cada pulso e o do
+// trapezio ideal.  Nos movimentos com perfil em "S", a duracao ideal eh
+// a de {moveDuration()}, e as diferencas nao sao calculadas ("-").
+//
+// Cada movimento que chega ao alvo que o {motor1} tinha no inicio
+// (isto eh, nao foi interrompido nem emendado com outro da fila) eh
+// conferido: a duracao deve diferir da de {moveDuration()} por no
+// maximo {sim_tol_duracao}, e, no trapezio, a raiz da media quadratica
+// das diferencas deve ser no maximo {sim_tol_rms} da duracao.  O
+// programa termina com status 1 se algum movimento falhar, e a ultima
+// coluna do relatorio diz "ok", "FALHOU", ou "-" se nao foi conferido.
+//
+// O roteiro tem uma linha por evento, no formato "{t} {acao} {args}",
+// onde {t} eh o instante do evento em milissegundos, absoluto, ou
+// relativo ao evento anterior se comecar com '+'.  As acoes sao:
+//
+//   envia {texto}  os bytes de {texto} (ateh o fim da linha) chegam pela
+//                  porta serial, no ritmo da velocidade da porta; sao
+//                  aceitos os escapes "\n", "\r", "\\" e "\x{HH}".
+//   chave {0|1}    solta (0) ou aciona (1) a chave de fim de curso.
+//   fim            termina a simulacao.
+//
+// Linhas vazias ou comecando com '#' sao ignoradas.
+//
+// Na segunda forma ({-b}), mede o tempo gasto por
+// {AccelStepper::computeNewSpeed()} num movimento longo, com perfil
+// trapezoidal e em "S", em ciclos do processador do computador (ou
+// nanossegundos, se o contador de ciclos nao estiver disponivel).  Os
+// numeros nao sao os do ATmega328P, mas servem para comparar versoes.
+
+#include <time.h>
+#include <vector>
+  // Antes de {Arduino.h}, por causa das macros {min} e {max}.
+
+#include "Arduino.h"
+#include <AccelStepper.h>
+#include <muff_utils.h>
+#include <muff_chave.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define sim_usa_ciclos (1)
+#else
+#define sim_usa_ciclos (0)
+#endif
+  // Se 1, o tempo de {-b} eh medido em ciclos com {__rdtsc()}.
+
+void setup(void);
+void loop(void);
+extern muff_motor motor1;
+  // Definidos em {muff_firmware.ino}.
+
+// -----------------------------------------------------------
+// PULSOS E MOVIMENTOS
+
+typedef struct sim_movimento_t
+  { int ini;            // Indice do primeiro pulso em {pulsos}.
+    int fim;            // Indice do ultimo pulso mais 1.
+    float max_vel;      // Velocidade maxima do {motor1} no primeiro pulso (pulsos/s).
+    float acel;         // Aceleracao do {motor1} no primeiro pulso (pulsos/s^2).
+    float tranco;       // Tranco do {motor1} no primeiro pulso, ou 0.
+    long alvo;          // Alvo do {motor1} no primeiro pulso.
+    bool completo;      // True se o movimento terminou no {alvo}.
+  } sim_movimento_t;
+  // Um movimento: sequencia de pulsos entre duas paradas do motor.
+
+static std::vector<unsigned long> pulsos;
+  // Instantes de todos os pulsos "step", em ordem.
+
+static std::vector<long> posicoes;
+  // Contagem de pulsos com sinal depois de cada pulso de {pulsos}.
+
+static std::vector<sim_movimento_t> movimentos;
+  // Movimentos completos ou em andamento.
+
+static bool em_movimento = false;
+  // True se o ultimo elemento de {movimentos} ainda estah em andamento.
+
+static long contagem = 0;
+  // Contagem corrente de pulsos com sinal.
+
+static uint8_t nivel_dir = LOW;
+  // Nivel corrente do pino "direction".
+
+static void observa_pino(uint8_t pino, uint8_t valor, unsigned long us)
+  // Registra as mudancas dos pinos do motor (veja {sim_define_observador_pino}).
+  {
+    if (pino == motor1_dirPin)
+      { nivel_dir = valor; }
+    else if ((pino == motor1_stepPin) && (valor == HIGH))
+      { contagem += (nivel_dir == HIGH ? +1 : -1);
+        pulsos.push_back(us);
+        posicoes.push_back(contagem);
+        if (! em_movimento)
+          { sim_movimento_t mv;
+            mv.ini = pulsos.size() - 1;
+            mv.fim = mv.ini;
+            mv.max_vel = motor1.maxSpeed();
+            mv.acel = motor1.acceleration();
+#if ACCELSTEPPER_SCURVE
+            mv.tranco = motor1.jerk();
+#else
+            mv.tranco = 0;
+#endif
+            mv.alvo = motor1.targetPosition();
+            mv.completo = false;
+            movimentos.push_back(mv);
+            em_movimento = true;
+          }
+        movimentos.back().fim = pulsos.size();
+      }
+  }
+
+static double tempo_ideal(double x, double n, double v, double a)
+  // Instante (segundos) em que o trapezio ideal de {n} passos, com
+  // velocidade maxima {v} e aceleracao {a}, atinge a distancia {x}.
+  {
+    double d = v*v/(2*a);
+    if (2*d > n) { d = n/2; v = sqrt(a*n); }
+    double t1 = v/a;
+    double tf = 2*t1 + (n - 2*d)/v;
+    if (x <= d)
+      { return sqrt(2*x/a); }
+    else if (x <= n - d)
+      { return t1 + (x - d)/v; }
+    else
+      { return tf - sqrt(2*(n - x)/a); }
+  }
+
+#define sim_tol_duracao (0.005)
+  // Diferenca relativa maxima entre a duracao de um movimento e a de {moveDuration()}.
+
+#define sim_tol_rms (0.03)
+  // Raiz da media quadratica maxima das diferencas para o trapezio, relativa a duracao.
+
+static int relata_movimentos(void)
+  // Escreve o relatorio dos movimentos em {stderr}, e devolve o numero
+  // de movimentos que falharam na conferencia.
+  {
+    fprintf(stderr, "# %d movimentos, %d pulsos\n", (int)movimentos.size(), (int)pulsos.size());
+    fprintf(stderr, "#  mov   pulsos   max_vel      acel  tranco   duracao    ideal   modelo  erro_max  erro_rms  conf\n");
+    fprintf(stderr, "#                 (pul/s)  (pul/s2)             (ms)     (ms)     (ms)      (us)      (us)\n");
+    int falhas = 0;
+    for (int m = 0; m < (int)movimentos.size(); m++)
+      { sim_movimento_t *mv = &(movimentos[m]);
+        int n = mv->fim - mv->ini;
+        double t0 = pulsos[mv->ini];
+        double dur = (pulsos[mv->fim - 1] - t0)/1000.0;
+        double modelo = motor1.moveDuration(n, mv->max_vel, mv->acel, mv->tranco)/1000.0;
+        bool trapezio = (mv->tranco == 0);
+        double ideal = (trapezio ? 0 : modelo), emax = 0, esoma = 0;
+        if (trapezio && (n > 1) && (mv->max_vel > 0) && (mv->acel > 0))
+          { double T1 = tempo_ideal(1, n, mv->max_vel, mv->acel);
+            ideal = (tempo_ideal(n, n, mv->max_vel, mv->acel) - T1)*1000.0;
+            for (int k = 0; k < n; k++)
+              { double ti = (tempo_ideal(k + 1, n, mv->max_vel, mv->acel) - T1)*1.0e6;
+                double e = (pulsos[mv->ini + k] - t0) - ti;
+                if (fabs(e) > emax) { emax = fabs(e); }
+                esoma += e*e;
+              }
+          }
+        double erms = sqrt(esoma/n);
+        const char *conf = "-";
+        if (mv->completo && (n > 1))
+          { bool ok = (fabs(dur - modelo) <= sim_tol_duracao*modelo);
+            if (trapezio) { ok = ok && (erms*0.001 <= sim_tol_rms*dur); }
+            conf = (ok ? "ok" : "FALHOU");
+            if (! ok) { falhas++; }
+          }
+        fprintf
+          ( stderr, "# %4d %8d %9.1f %9.1f %7.0f %9.2f %8.2f %8.2f",
+            m + 1, n, mv->max_vel, mv->acel, mv->tranco, dur, ideal, modelo
+          );
+        if (trapezio)
+          { fprintf(stderr, " %9.1f %9.1f", emax, erms); }
+        else
+          { fprintf(stderr, " %9s %9s", "-", "-"); }
+        fprintf(stderr, "  %s\n", conf);
+      }
+    if (falhas > 0) { fprintf(stderr, "# %d movimentos fora da tolerancia\n", falhas); }
+    return falhas;
+  }
+
+static void escreve_pulsos(char *nome)
+  // Escreve os pulsos no arquivo {nome} (veja a opcao {-p}).
+  {
+    FILE *arq = fopen(nome, "w");
+    if (arq == NULL) { fprintf(stderr, "muff_sim: nao consegui criar %s\n", nome); exit(1); }
+    for (int k = 0; k < (int)pulsos.size(); k++)
+      { fprintf(arq, "%lu %ld\n", pulsos[k], posicoes[k]); }
+    fclose(arq);
+  }
+
+// -----------------------------------------------------------
+// ROTEIRO
+
+#define max_linha (1024)
+  // Comprimento maximo de uma linha do roteiro.
+
+typedef struct sim_evento_t
+  { unsigned long us;          // Instante do evento.
+    char acao;                 // 'e' = envia, 'c' = chave, 'f' = fim.
+    std::vector<uint8_t> dados; // Bytes a enviar, ou o nivel da chave.
+  } sim_evento_t;
+  // Um evento do roteiro.
+
+static int hexa(char c)
+  // Valor do digito hexadecimal {c}, ou -1.
+  {
+    if ((c >= '0') && (c <= '9')) { return c - '0'; }
+    if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+    if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+    return -1;
+  }
+
+static std::vector<sim_evento_t> le_roteiro(char *nome)
+  // Le os eventos do roteiro no arquivo {nome}.
+  {
+    FILE *arq = fopen(nome, "r");
+    if (arq == NULL) { fprintf(stderr, "muff_sim: nao consegui abrir %s\n", nome); exit(1); }
+    std::vector<sim_evento_t> evs;
+    char linha[max_linha];
+    unsigned long t = 0;
+    int nl = 0;
+    while (fgets(linha, max_linha, arq) != NULL)
+      { nl++;
+        int n = strlen(linha);
+        while ((n > 0) && ((linha[n-1] == '\n') || (linha[n-1] == '\r'))) { n--; linha[n] = 0; }
+        char *p = linha;
+        while (*p == ' ') { p++; }
+        if ((*p == 0) || (*p == '#')) { continue; }
+        bool relativo = (*p == '+');
+        if (relativo) { p++; }
+        char *q;
+        double ms = strtod(p, &q);
+        if ((q == p) || (*q != ' ')) { fprintf(stderr, "muff_sim: %s:%d: instante invalido\n", nome, nl); exit(1); }
+        t = (relativo ? t : 0) + (unsigned long)(ms*1000 + 0.5);
+        p = q;
+        while (*p == ' ') { p++; }
+        sim_evento_t ev;
+        ev.us = t;
+        if (strncmp(p, "envia ", 6) == 0)
+          { ev.acao = 'e';
+            for (p += 6; *p != 0; p++)
+              { if ((*p == '\\') && (p[1] == 'n')) { ev.dados.push_back('\n'); p++; }
+                else if ((*p == '\\') && (p[1] == 'r')) { ev.dados.push_back('\r'); p++; }
+                else if ((*p == '\\') && (p[1] == '\\')) { ev.dados.push_back('\\'); p++; }
+                else if ((*p == '\\') && (p[1] == 'x') && (hexa(p[2]) >= 0) && (hexa(p[3]) >= 0))
+                  { ev.dados.push_back((uint8_t)(16*hexa(p[2]) + hexa(p[3]))); p += 3; }
+                else
+                  { ev.dados.push_back((uint8_t)*p); }
+              }
+          }
+        else if ((strncmp(p, "chave ", 6) == 0) && ((p[6] == '0') || (p[6] == '1')))
+          { ev.acao = 'c'; ev.dados.push_back(p[6] - '0'); }
+        else if (strcmp(p, "fim") == 0)
+          { ev.acao = 'f'; }
+        else
+          { fprintf(stderr, "muff_sim: %s:%d: acao invalida\n", nome, nl); exit(1); }
+        evs.push_back(ev);
+      }
+    fclose(arq);
+    return evs;
+  }
+
+static int simula(char *roteiro, unsigned long custo_volta_us, double max_s, char *arq_pulsos)
+  // Executa o firmware com o {roteiro} (veja acima), e devolve o numero
+  // de movimentos que falharam na conferencia.
+  {
+    std::vector<sim_evento_t> evs = le_roteiro(roteiro);
+    sim_define_observador_pino(observa_pino);
+    setup();
+    unsigned long max_us = (unsigned long)(max_s*1.0e6);
+    int prox = 0;
+    bool terminou = false;
+    while ((! terminou) && (micros() < max_us))
+      { while ((prox < (int)evs.size()) && (evs[prox].us <= micros()))
+          { sim_evento_t *ev = &(evs[prox]);
+            if (ev->acao == 'e')
+              { sim_recebe(ev->dados.data(), ev->dados.size()); }
+            else if (ev->acao == 'c')
+              { sim_define_entrada(chave_pino, (ev->dados[0] ? LOW : HIGH)); }
+            else
+              { terminou = true; }
+            prox++;
+          }
+        if (terminou) { break; }
+        loop();
+        sim_avanca_relogio(custo_volta_us);
+        bool girando = motor1.isRunning();
+        if (em_movimento && (! girando))
+          { movimentos.back().completo = (motor1.currentPosition() == movimentos.back().alvo);
+            em_movimento = false;
+          }
+        if ((prox >= (int)evs.size()) && (! girando) && (! sim_recepcao_pendente()))
+          { terminou = true; }
+      }
+    fflush(stdout);
+    fprintf(stderr, "# fim da simulacao em t = %.3f s\n", micros()/1.0e6);
+    int falhas = relata_movimentos();
+    if (arq_pulsos != NULL) { escreve_pulsos(arq_pulsos); }
+    return falhas;
+  }
+
+// -----------------------------------------------------------
+// MEDIDA DE {computeNewSpeed}
+
+class sim_motor_bancada : public muff_motor
+  // Motor que expoe {computeNewSpeed} para a medida.
+  { public:
+      void avanca(void) { _currentPos += (_direction ? 1 : -1); }
+      void calcula(void) { computeNewSpeed(); }
+  };
+
+static inline unsigned long long relogio_fino(void)
+  // Contador de ciclos do processador, ou nanossegundos.
+  {
+#if sim_usa_ciclos
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+  }
+
+static void mede_perfil(char *nome, float tranco)
+  // Mede {computeNewSpeed} num movimento de ida e volta com tranco {tranco}.
+  {
+    sim_motor_bancada motor;
+    motor.setMaxSpeed(3200);
+    motor.setAcceleration(4000);
+#if ACCELSTEPPER_SCURVE
+    motor.setJerk(tranco);
+#else
+    if (tranco != 0) { printf("%-12s (perfil em S desabilitado)\n", nome); return; }
+#endif
+    unsigned long long total = 0, menor = ~0ULL, maior = 0;
+    long n = 0;
+    for (int volta = 0; volta < 10; volta++)
+      { motor.moveTo(volta % 2 == 0 ? 200000 : 0);
+        while (motor.stepInterval() != 0)
+          { motor.avanca();
+            unsigned long long t0 = relogio_fino();
+            motor.calcula();
+            unsigned long long dt = relogio_fino() - t0;
+            total += dt; n++;
+            if (dt < menor) { menor = dt; }
+            if (dt > maior) { maior = dt; }
+          }
+      }
+    printf
+      ( "%-12s %8ld chamadas  media %7.1f  min %5llu  max %7llu %s\n",
+        nome, n, (double)total/n, menor, maior, (sim_usa_ciclos ? "ciclos" : "ns")
+      );
+  }
+
+static void mede_computeNewSpeed(void)
+  // Executa a opcao {-b}.
+  {
+    sim_define_eco(false);
+    mede_perfil("trapezio", 0);
+    mede_perfil("S", 40000);
+  }
+
+// -----------------------------------------------------------
+// PROGRAMA PRINCIPAL
+
+static void uso(void)
+  {
+    fprintf(stderr, "uso: muff_sim [-l {us}] [-T {s}] [-p {arquivo}] [-q] {roteiro}\n");
+    fprintf(stderr, "     muff_sim -b\n");
+    exit(1);
+  }
+
+int main(int argc, char **argv)
+  {
+    unsigned long custo_volta_us = 10;
+    double max_s = 600;
+    char *arq_pulsos = NULL;
+    char *roteiro = NULL;
+    for (int i = 1; i < argc; i++)
+      { if (strcmp(argv[i], "-b") == 0)
+          { mede_computeNewSpeed(); return 0; }
+        else if ((strcmp(argv[i], "-l") == 0) && (i + 1 < argc))
+          { custo_volta_us = atol(argv[++i]); }
+        else if ((strcmp(argv[i], "-T") == 0) && (i + 1 < argc))
+          { max_s = atof(argv[++i]); }
+        else if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc))
+          { arq_pulsos = argv[++i]; }
+        else if (strcmp(argv[i], "-q") == 0)
+          { sim_define_eco(false); }
+        else if ((argv[i][0] != '-') && (roteiro == NULL))
+          { roteiro = argv[i]; }
+        else
+          { uso(); }
+      }
+    if (roteiro == NULL) { uso(); }
+    int falhas = simula(roteiro, custo_volta_us, max_s, arq_pulsos);
+    return (falhas > 0 ? 1 : 0);
+  }
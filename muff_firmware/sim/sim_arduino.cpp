@@ -0,0 +1,235 @@
+/* See {Arduino.h} in this directory. */
+
+#include "Arduino.h"
+
+static unsigned long relogio_us = 0;
+  // Relogio virtual (microssegundos desde o inicio da simulacao).
+
+uint8_t SREG = 0;
+
+// -----------------------------------------------------------
+// PORTA SERIAL (estado)
+
+static unsigned long us_por_byte = 1042;
+  // Tempo de transmissao de um byte (10 bits) na velocidade corrente.
+
+static int tx_ocupados = 0;
+  // Bytes no buffer de transmissao que ainda nao sairam.
+
+static unsigned long tx_proximo = 0;
+  // Instante em que o primeiro byte de {tx_ocupados} acaba de sair.
+
+static bool eco = true;
+  // True se os bytes transmitidos devem ser copiados na saida padrao.
+
+#define max_recepcao (1 << 16)
+  // Numero maximo de bytes do roteiro por chegar ao mesmo tempo.
+
+static uint8_t chegando[max_recepcao];
+static unsigned long chegada[max_recepcao];
+static int ini_chegando = 0, fim_chegando = 0;
+  // Bytes do roteiro {chegando[ini_chegando..fim_chegando-1]}, cada um
+  // com o instante {chegada[k]} em que termina de chegar.
+
+static uint8_t rx[sim_tam_buffer_serial];
+static int ini_rx = 0, num_rx = 0;
+  // Buffer circular de recepcao: bytes chegados e ainda nao lidos.
+
+static void atualiza_serial(void)
+  // Tira do buffer de transmissao os bytes que jah sairam, e poe no
+  // de recepcao os que jah chegaram, ateh o instante {relogio_us}.
+  {
+    while ((tx_ocupados > 0) && (tx_proximo <= relogio_us))
+      { tx_ocupados--; tx_proximo += us_por_byte; }
+    while ((ini_chegando < fim_chegando) && (chegada[ini_chegando] <= relogio_us))
+      { // Como no Arduino, um byte que chega com o buffer cheio eh perdido:
+        if (num_rx < sim_tam_buffer_serial)
+          { rx[(ini_rx + num_rx) % sim_tam_buffer_serial] = chegando[ini_chegando]; num_rx++; }
+        ini_chegando++;
+      }
+  }
+
+// -----------------------------------------------------------
+// TEMPO
+
+unsigned long micros(void)
+  { return relogio_us; }
+
+unsigned long millis(void)
+  { return relogio_us/1000; }
+
+void sim_avanca_relogio(unsigned long us)
+  { relogio_us += us;
+    atualiza_serial();
+  }
+
+void delay(unsigned long ms)
+  { sim_avanca_relogio(ms*1000); }
+
+void delayMicroseconds(unsigned int us)
+  { sim_avanca_relogio(us); }
+
+// -----------------------------------------------------------
+// PINOS
+
+static uint8_t saidas[sim_num_pinos];
+  // Nivel corrente de cada pino de saida.
+
+static uint8_t entradas[sim_num_pinos];
+static bool entradas_iniciadas = false;
+  // Nivel lido por {digitalRead} em cada pino.
+
+static sim_observador_pino_t *observador = NULL;
+  // Funcao a chamar a cada mudanca de nivel de um pino de saida.
+
+static void inicia_entradas(void)
+  // Poe todas as entradas em {HIGH}, na primeira chamada.
+  {
+    if (entradas_iniciadas) { return; }
+    for (int p = 0; p < sim_num_pinos; p++) { entradas[p] = HIGH; }
+    entradas_iniciadas = true;
+  }
+
+void pinMode(uint8_t pino, uint8_t modo)
+  { (void)(pino); (void)(modo); }
+
+void digitalWrite(uint8_t pino, uint8_t valor)
+  {
+    if (pino >= sim_num_pinos) { return; }
+    valor = (valor ? HIGH : LOW);
+    if (saidas[pino] == valor) { return; }
+    saidas[pino] = valor;
+    if (observador != NULL) { observador(pino, valor, relogio_us); }
+  }
+
+int digitalRead(uint8_t pino)
+  {
+    inicia_entradas();
+    if (pino >= sim_num_pinos) { return LOW; }
+    return entradas[pino];
+  }
+
+void shiftOut(uint8_t pino_dados, uint8_t pino_relogio, uint8_t ordem, uint8_t valor)
+  { (void)(pino_dados); (void)(pino_relogio); (void)(ordem); (void)(valor); }
+
+void sim_define_observador_pino(sim_observador_pino_t *obs)
+  { observador = obs; }
+
+void sim_define_entrada(uint8_t pino, uint8_t valor)
+  {
+    inicia_entradas();
+    if (pino < sim_num_pinos) { entradas[pino] = (valor ? HIGH : LOW); }
+  }
+
+// -----------------------------------------------------------
+// PORTA SERIAL
+
+HardwareSerial Serial;
+
+size_t Print::write(const uint8_t *buf, size_t n)
+  { for (size_t i = 0; i < n; i++) { write(buf[i]); }
+    return n;
+  }
+
+size_t Print::print(const char *s)
+  { size_t n = 0;
+    while (*s) { n += write((uint8_t)*s); s++; }
+    return n;
+  }
+
+size_t Print::print(char c)
+  { return write((uint8_t)c); }
+
+size_t Print::print(int v, int base)
+  { return print((long)v, base); }
+
+size_t Print::print(unsigned int v, int base)
+  { return print((unsigned long)v, base); }
+
+size_t Print::print(long v, int base)
+  { char b[40];
+    if (base == HEX)
+      { sprintf(b, "%lX", (unsigned long)v); }
+    else
+      { sprintf(b, "%ld", v); }
+    return print(b);
+  }
+
+size_t Print::print(unsigned long v, int base)
+  { char b[40];
+    sprintf(b, (base == HEX ? "%lX" : "%lu"), v);
+    return print(b);
+  }
+
+size_t Print::print(double v, int digitos)
+  { char b[64];
+    sprintf(b, "%.*f", digitos, v);
+    return print(b);
+  }
+
+size_t Print::println(void)
+  { return print("\r\n"); }
+
+void HardwareSerial::begin(unsigned long bauds)
+  { us_por_byte = (10000000UL + bauds/2)/bauds; }
+
+int HardwareSerial::available(void)
+  { atualiza_serial();
+    return num_rx;
+  }
+
+int HardwareSerial::read(void)
+  { atualiza_serial();
+    if (num_rx == 0) { return -1; }
+    int c = rx[ini_rx];
+    ini_rx = (ini_rx + 1) % sim_tam_buffer_serial;
+    num_rx--;
+    return c;
+  }
+
+int HardwareSerial::peek(void)
+  { atualiza_serial();
+    return (num_rx == 0 ? -1 : rx[ini_rx]);
+  }
+
+int HardwareSerial::availableForWrite(void)
+  { atualiza_serial();
+    return sim_tam_buffer_serial - tx_ocupados;
+  }
+
+void HardwareSerial::flush(void)
+  { // Espera todos os bytes sairem:
+    if (tx_ocupados > 0) { sim_avanca_relogio(tx_proximo + (tx_ocupados - 1)*us_por_byte - relogio_us); }
+  }
+
+size_t HardwareSerial::write(uint8_t c)
+  {
+    atualiza_serial();
+    if (tx_ocupados >= sim_tam_buffer_serial)
+      { // Como no Arduino, espera haver lugar no buffer:
+        sim_avanca_relogio(tx_proximo - relogio_us);
+      }
+    if (tx_ocupados == 0) { tx_proximo = relogio_us + us_por_byte; }
+    tx_ocupados++;
+    if (eco) { putchar(c); }
+    return 1;
+  }
+
+void sim_recebe(const uint8_t *bytes, int n)
+  {
+    if (ini_chegando == fim_chegando) { ini_chegando = fim_chegando = 0; }
+    unsigned long t = relogio_us;
+    if ((ini_chegando < fim_chegando) && (chegada[fim_chegando - 1] > t)) { t = chegada[fim_chegando - 1]; }
+    for (int k = 0; (k < n) && (fim_chegando < max_recepcao); k++)
+      { t += us_por_byte;
+        chegando[fim_chegando] = bytes[k];
+        chegada[fim_chegando] = t;
+        fim_chegando++;
+      }
+  }
+
+bool sim_recepcao_pendente(void)
+  { return (ini_chegando < fim_chegando) || (num_rx > 0); }
+
+void sim_define_eco(bool e)
+  { eco = e; }
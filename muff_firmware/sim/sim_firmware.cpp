@@ -0,0 +1,4 @@
+/* The MUFF v2.0 firmware sketch, compiled as a C++ file for the host simulator. */
+
+#include "Arduino.h"
+#include "../muff_firmware.ino"